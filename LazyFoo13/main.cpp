@@ -15,8 +15,8 @@ public:
     // Desstructor
     ~LTexture();
 
-    // Loads image at specified path
-    bool loadFromFile(std::string path);
+    // Loads image at specified path, optionally premultiplying alpha
+    bool loadFromFile(std::string path, bool premultiply = false);
 
     // Deallocate texture
     void free();
@@ -38,12 +38,22 @@ public:
     int getHeight();
 
 private:
+    // Pushes the stored color/alpha modulation to the texture
+    void applyModulation();
+
     // The actual hardware texture
     SDL_Texture* mTexture;
 
     // Image dimensions
     int mWidth;
     int mHeight;
+
+    // Premultiplied pixel data and current modulation
+    bool mPremultiplied;
+    Uint8 mRed;
+    Uint8 mGreen;
+    Uint8 mBlue;
+    Uint8 mAlpha;
 };
 /*********************************************************************/
 
@@ -72,6 +82,13 @@ LTexture gBackgroundTexture;
 /**************************************************************************
 Function Declarations
 **************************************************************************/
+// Premultiplied alpha helpers
+SDL_BlendMode getPremultipliedBlendMode();
+
+Uint8 mulDiv255(Uint8 a, Uint8 b);
+
+SDL_Surface* premultiplySurface(SDL_Surface* surface);
+
 bool init();
 
 bool loadMedia();
@@ -89,6 +106,11 @@ LTexture::LTexture()
     mTexture = nullptr;
     mWidth = 0;
     mHeight = 0;
+    mPremultiplied = false;
+    mRed = 0xff;
+    mGreen = 0xff;
+    mBlue = 0xff;
+    mAlpha = 0xff;
 }
 
 LTexture::~LTexture()
@@ -97,10 +119,11 @@ LTexture::~LTexture()
     free();
 }
 
-bool LTexture::loadFromFile(std::string path)
+bool LTexture::loadFromFile(std::string path, bool premultiply)
 {
     //The final texture
     SDL_Texture* newTexture = nullptr;
+    mPremultiplied = false;
 
     // Load image at the specified path
     SDL_Surface* loadedSurface = IMG_Load(path.c_str() );
@@ -115,8 +138,35 @@ bool LTexture::loadFromFile(std::string path)
         SDL_SetColorKey(loadedSurface, SDL_TRUE,
                         SDL_MapRGB(loadedSurface->format, 0, 0xff, 0xff) );
 
+        // Bake color key and alpha into premultiplied ARGB
+        if( premultiply )
+        {
+            SDL_Surface* formattedSurface = premultiplySurface(loadedSurface);
+            if( formattedSurface == nullptr )
+            {
+                printf("Unable to premultiply %s! SDL_Error: %s\n",
+                       path.c_str(), SDL_GetError());
+            }
+            else
+            {
+                // Premultiplied pixels are only usable if the renderer takes the matching blend equation
+                newTexture = SDL_CreateTextureFromSurface(gRenderer, formattedSurface);
+                if( newTexture != nullptr && SDL_SetTextureBlendMode(newTexture, getPremultipliedBlendMode()) != 0 )
+                {
+                    printf("Premultiplied blending not supported, using straight alpha for %s\n", path.c_str());
+                    SDL_DestroyTexture(newTexture);
+                    newTexture = nullptr;
+                }
+                mPremultiplied = newTexture != nullptr;
+                SDL_FreeSurface( formattedSurface );
+            }
+        }
+
         // Create texture from surface pixels
-        newTexture = SDL_CreateTextureFromSurface(gRenderer, loadedSurface);
+        if( newTexture == nullptr )
+        {
+            newTexture = SDL_CreateTextureFromSurface(gRenderer, loadedSurface);
+        }
         if( newTexture == nullptr)
         {
             printf("Unable to create texture from %s! SDL_Error: %s",
@@ -144,25 +194,52 @@ void LTexture::free()
         mTexture = nullptr;
         mWidth = 0;
         mHeight = 0;
+        mPremultiplied = false;
     }
 }
 
 // Set color Modulation
 void LTexture::setColor(Uint8 red, Uint8 green, Uint8 blue)
 {
-    SDL_SetTextureColorMod(mTexture, red, green, blue);
+    mRed = red;
+    mGreen = green;
+    mBlue = blue;
+    applyModulation();
 }
 
 // Set alpha blending
 void LTexture::setBlendMode(SDL_BlendMode blending)
 {
-    SDL_SetTextureBlendMode(mTexture, blending);
+    // Premultiplied textures blend with ONE instead of SRC_ALPHA
+    if( mPremultiplied && blending == SDL_BLENDMODE_BLEND )
+    {
+        blending = getPremultipliedBlendMode();
+    }
+    if( SDL_SetTextureBlendMode(mTexture, blending) != 0 )
+    {
+        printf("Unable to set blend mode! SDL_Error: %s\n", SDL_GetError());
+    }
 }
 
 // Set Alpha
 void LTexture::setAlpha(Uint8 alpha)
 {
-    SDL_SetTextureAlphaMod(mTexture, alpha);
+    mAlpha = alpha;
+    applyModulation();
+}
+void LTexture::applyModulation()
+{
+    // Premultiplied color has to fade along with alpha
+    if( mPremultiplied )
+    {
+        SDL_SetTextureColorMod(mTexture, mulDiv255(mRed, mAlpha),
+                               mulDiv255(mGreen, mAlpha), mulDiv255(mBlue, mAlpha));
+    }
+    else
+    {
+        SDL_SetTextureColorMod(mTexture, mRed, mGreen, mBlue);
+    }
+    SDL_SetTextureAlphaMod(mTexture, mAlpha);
 }
 
 void LTexture::render( int x, int y, SDL_Rect* clip )
@@ -196,6 +273,54 @@ int LTexture::getHeight()
 Function Definitions
 ***************************************************************************/
 
+SDL_BlendMode getPremultipliedBlendMode()
+{
+    // dst = src + dst * (1 - srcA), for color and alpha alike
+    return SDL_ComposeCustomBlendMode(SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA,
+                                      SDL_BLENDOPERATION_ADD,
+                                      SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA,
+                                      SDL_BLENDOPERATION_ADD);
+}
+
+Uint8 mulDiv255(Uint8 a, Uint8 b)
+{
+    // Rounded a * b / 255
+    Uint32 t = (Uint32)a * b + 128;
+    return (Uint8)((t + (t >> 8)) >> 8);
+}
+
+SDL_Surface* premultiplySurface(SDL_Surface* surface)
+{
+    // Converting turns the color key into zero alpha
+    SDL_Surface* formattedSurface = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_ARGB8888, 0);
+    if( formattedSurface == nullptr )
+    {
+        return nullptr;
+    }
+
+    SDL_LockSurface(formattedSurface);
+    for( int y = 0; y < formattedSurface->h; ++y )
+    {
+        Uint32* row = (Uint32*)((Uint8*)formattedSurface->pixels + y * formattedSurface->pitch);
+        for( int x = 0; x < formattedSurface->w; ++x )
+        {
+            Uint32 pixel = row[x];
+            Uint8 a = pixel >> 24;
+            if( a == 0xff )
+            {
+                continue;
+            }
+            Uint8 r = mulDiv255((pixel >> 16) & 0xff, a);
+            Uint8 g = mulDiv255((pixel >> 8) & 0xff, a);
+            Uint8 b = mulDiv255(pixel & 0xff, a);
+            row[x] = ((Uint32)a << 24) | ((Uint32)r << 16) | ((Uint32)g << 8) | b;
+        }
+    }
+    SDL_UnlockSurface(formattedSurface);
+
+    return formattedSurface;
+}
+
 bool init()
 {
 	//Initialization flag
@@ -256,7 +381,7 @@ bool loadMedia()
     bool success = true;
 
     // Load Foo texture
-    if(!gModulatedTexture.loadFromFile("13_alpha_blending/fadeout.png"))
+    if(!gModulatedTexture.loadFromFile("13_alpha_blending/fadeout.png", true))
     {
         printf("Failed to load Foo texture image\n");
         success = false;
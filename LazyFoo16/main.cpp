@@ -56,11 +56,60 @@ private:
 
 /*********************************************************************/
 
+/*************************************************************************
+ Glyph atlas class
+*************************************************************************/
+class LGlyphAtlas
+{
+public:
+    // Constructor
+    LGlyphAtlas();
+
+    // Destructor
+    ~LGlyphAtlas();
+
+    // Rasterizes every printable glyph of the font into one texture
+    bool buildAtlas(TTF_Font* font);
+
+    // Deallocate atlas texture
+    void free();
+
+    // Shows the text using the cached glyphs
+    void renderText(int x, int y, std::string text, SDL_Color textColor);
+
+    // Gets the size the text would take up
+    int getTextWidth(std::string text);
+    int getTextHeight(std::string text);
+
+private:
+    // Maps characters the atlas doesn't have to '?'
+    int getGlyphIndex(char c);
+
+    // The shared glyph texture
+    SDL_Texture* mTexture;
+
+    // Where each character sits in the texture
+    SDL_Rect mClips[128];
+
+    // How far to move after each character
+    int mAdvances[128];
+
+    // Line spacing of the font
+    int mLineSkip;
+};
+
+/*********************************************************************/
+
 /**********************************************************************
 Constants
 **********************************************************************/
 const int SCREEN_WIDTH = 800;
 const int SCREEN_HEIGHT = 600;
+
+// Printable characters kept in the glyph atlas
+const int GLYPH_FIRST = 32;
+const int GLYPH_LAST = 126;
+const int GLYPH_ATLAS_WIDTH = 512;
 const int WALKING_ANIMATION_FRAMES = 4;
 /*********************************************************************/
 
@@ -76,8 +125,8 @@ SDL_Renderer* gRenderer = nullptr;
 // Globally used font
 TTF_Font* gFont = nullptr;
 
-// Rendered Texture
-LTexture gTextTexture;
+// Cached font glyphs
+LGlyphAtlas gGlyphAtlas;
 
 /*********************************************************************/
 
@@ -240,6 +289,220 @@ int LTexture::getHeight()
 }
 /**************************************************************************/
 
+/*********************************************************************
+LGlyphAtlas Method Declarations
+*********************************************************************/
+
+// Constructor
+LGlyphAtlas::LGlyphAtlas()
+{
+    // Initialize
+    mTexture = nullptr;
+    mLineSkip = 0;
+
+    for(auto i = 0; i < 128; ++i)
+    {
+        mClips[i].x = 0;
+        mClips[i].y = 0;
+        mClips[i].w = 0;
+        mClips[i].h = 0;
+        mAdvances[i] = 0;
+    }
+}
+
+LGlyphAtlas::~LGlyphAtlas()
+{
+    // Deallocate
+    free();
+}
+
+bool LGlyphAtlas::buildAtlas(TTF_Font* font)
+{
+    // Get rid of pre-existing atlas
+    free();
+
+    // Glyphs are white so they can be tinted with color modulation
+    SDL_Color white = {0xff, 0xff, 0xff, 0xff};
+
+    // The rasterized printable glyphs
+    SDL_Surface* glyphSurfaces[128] = {nullptr};
+
+    // Packing offsets
+    int rowHeight = TTF_FontHeight(font);
+    int penX = 0, penY = 0;
+
+    // Rasterize each glyph once and find its spot in the atlas
+    for(auto i = GLYPH_FIRST; i <= GLYPH_LAST; ++i)
+    {
+        glyphSurfaces[i] = TTF_RenderGlyph_Blended(font, (Uint16)i, white);
+        if(glyphSurfaces[i] == nullptr)
+        {
+            std::cout << "Unable to render glyph " << i << "! SDL_ttf Error: " << TTF_GetError() << std::endl;
+            continue;
+        }
+
+        // Wrap to the next row
+        if(penX + glyphSurfaces[i]->w > GLYPH_ATLAS_WIDTH)
+        {
+            penX = 0;
+            penY += rowHeight + 1;
+        }
+
+        mClips[i].x = penX;
+        mClips[i].y = penY;
+        mClips[i].w = glyphSurfaces[i]->w;
+        mClips[i].h = glyphSurfaces[i]->h;
+
+        // Get how far the pen moves past this glyph
+        int minX, maxX, minY, maxY;
+        TTF_GlyphMetrics(font, (Uint16)i, &minX, &maxX, &minY, &maxY, &mAdvances[i]);
+
+        // Move over with one pixel of padding
+        penX += glyphSurfaces[i]->w + 1;
+    }
+
+    // Blit every glyph into a single surface
+    SDL_Surface* atlasSurface = SDL_CreateRGBSurfaceWithFormat(0, GLYPH_ATLAS_WIDTH, penY + rowHeight, 32, SDL_PIXELFORMAT_RGBA8888);
+    if(atlasSurface == nullptr)
+    {
+        std::cout << "Unable to create glyph atlas surface! SDL Error: " << SDL_GetError() << std::endl;
+    }
+    else
+    {
+        for(auto i = GLYPH_FIRST; i <= GLYPH_LAST; ++i)
+        {
+            if(glyphSurfaces[i] != nullptr)
+            {
+                // Copy the glyph's alpha as is instead of blending it
+                SDL_SetSurfaceBlendMode(glyphSurfaces[i], SDL_BLENDMODE_NONE);
+                SDL_BlitSurface(glyphSurfaces[i], nullptr, atlasSurface, &mClips[i]);
+            }
+        }
+
+        // Upload the atlas once
+        mTexture = SDL_CreateTextureFromSurface(gRenderer, atlasSurface);
+        if(mTexture == nullptr)
+        {
+            std::cout << "Unable to create glyph atlas texture! SDL Error: " << SDL_GetError() << std::endl;
+        }
+        else
+        {
+            SDL_SetTextureBlendMode(mTexture, SDL_BLENDMODE_BLEND);
+            mLineSkip = TTF_FontLineSkip(font);
+        }
+
+        SDL_FreeSurface(atlasSurface);
+    }
+
+    // Get rid of the glyph surfaces
+    for(auto i = GLYPH_FIRST; i <= GLYPH_LAST; ++i)
+    {
+        SDL_FreeSurface(glyphSurfaces[i]);
+    }
+
+    return mTexture != nullptr;
+}
+
+void LGlyphAtlas::free()
+{
+    // Free texture if it exists
+    if(mTexture != nullptr)
+    {
+        SDL_DestroyTexture(mTexture);
+        mTexture = nullptr;
+        mLineSkip = 0;
+    }
+}
+
+void LGlyphAtlas::renderText(int x, int y, std::string text, SDL_Color textColor)
+{
+    // If the atlas has been built
+    if(mTexture != nullptr)
+    {
+        // Tint the white glyphs
+        SDL_SetTextureColorMod(mTexture, textColor.r, textColor.g, textColor.b);
+        SDL_SetTextureAlphaMod(mTexture, textColor.a);
+
+        // Temp offsets
+        int curX = x, curY = y;
+
+        // Go through the text
+        for(std::size_t i = 0; i < text.length(); ++i)
+        {
+            // If the current character is a new line
+            if(text[i] == '\n')
+            {
+                // Move down
+                curY += mLineSkip;
+
+                // Move back
+                curX = x;
+            }
+            else
+            {
+                int glyph = getGlyphIndex(text[i]);
+
+                // Show the character
+                SDL_Rect renderQuad = {curX, curY, mClips[glyph].w, mClips[glyph].h};
+                SDL_RenderCopy(gRenderer, mTexture, &mClips[glyph], &renderQuad);
+
+                // Move over the width of the character
+                curX += mAdvances[glyph];
+            }
+        }
+    }
+}
+
+int LGlyphAtlas::getTextWidth(std::string text)
+{
+    int width = 0, lineWidth = 0;
+
+    for(std::size_t i = 0; i < text.length(); ++i)
+    {
+        if(text[i] == '\n')
+        {
+            lineWidth = 0;
+        }
+        else
+        {
+            lineWidth += mAdvances[getGlyphIndex(text[i])];
+        }
+
+        if(lineWidth > width)
+        {
+            width = lineWidth;
+        }
+    }
+    return width;
+}
+
+int LGlyphAtlas::getTextHeight(std::string text)
+{
+    int lines = 1;
+
+    for(std::size_t i = 0; i < text.length(); ++i)
+    {
+        if(text[i] == '\n')
+        {
+            ++lines;
+        }
+    }
+    return lines * mLineSkip;
+}
+
+int LGlyphAtlas::getGlyphIndex(char c)
+{
+    int ascii = (unsigned char)c;
+
+    // Not in the atlas
+    if(ascii < GLYPH_FIRST || ascii > GLYPH_LAST)
+    {
+        ascii = '?';
+    }
+    return ascii;
+}
+/**************************************************************************/
+
 /***************************************************************************
 Function Definitions
 ***************************************************************************/
@@ -319,11 +582,10 @@ bool loadMedia()
     }
     else
     {
-        // Render text
-        SDL_Color textColor = {0,0,0};
-        if(!gTextTexture.loadFromRenderedText("The quick brown fox jumps over the lazy dog", textColor))
+        // Rasterize glyphs
+        if(!gGlyphAtlas.buildAtlas(gFont))
         {
-            std::cout << "Failed to render text texture!" << std::endl;
+            std::cout << "Failed to build glyph atlas!" << std::endl;
             success = false;
         }
     }
@@ -334,7 +596,7 @@ bool loadMedia()
 void close()
 {
     // Free loaded images
-    gTextTexture.free();
+    gGlyphAtlas.free();
 
     // Free global font
     TTF_CloseFont(gFont);
@@ -374,10 +636,9 @@ int main( int argc, char* args[] )
 			//Main loop flag
 			bool quit = false;
 
-			// Angle of rotation
-			double degrees = 0;
-
-			SDL_RendererFlip flipType = SDL_FLIP_NONE;
+            // Set the text
+            std::string text = "The quick brown fox jumps over the lazy dog";
+            SDL_Color textColor = {0, 0, 0, 255};
 
 			//Event handler
 			SDL_Event e;
@@ -403,12 +664,10 @@ int main( int argc, char* args[] )
 
 
 
-                gTextTexture.render((SCREEN_WIDTH - gTextTexture.getWidth())/2,
-                                     (SCREEN_HEIGHT - gTextTexture.getHeight())/2,
-                                     nullptr,
-                                     degrees,
-                                     nullptr,
-                                     flipType);
+                gGlyphAtlas.renderText((SCREEN_WIDTH - gGlyphAtlas.getTextWidth(text))/2,
+                                       (SCREEN_HEIGHT - gGlyphAtlas.getTextHeight(text))/2,
+                                       text,
+                                       textColor);
 
 
 
@@ -2,10 +2,92 @@
 #include <cstdlib>
 #include <string>
 #include <sstream>
+#include <fstream>
+#include <vector>
 #include <SDL.h>
 #include <SDL_image.h>
 #include <SDL_ttf.h>
 
+/*************************************************************************
+ Clock classes
+*************************************************************************/
+// Where timers read time from, so a run can use real or scripted time
+class LClock
+{
+public:
+    virtual ~LClock() {}
+
+    // Current time in counts
+    virtual Uint64 getCounts() = 0;
+
+    // Counts per second
+    virtual Uint64 getFrequency() = 0;
+
+    // Sleeps for about the given milliseconds
+    virtual void delay(Uint32 ms) = 0;
+
+    // Returns once the time has reached counts
+    virtual void waitUntil(Uint64 counts) = 0;
+
+    // Called by the main loop once per frame
+    virtual void endFrame() = 0;
+
+    // Current time in milliseconds
+    Uint64 getTicks();
+};
+
+// Wall clock time from the performance counter
+class LRealClock : public LClock
+{
+public:
+    // Constructor
+    LRealClock();
+
+    Uint64 getCounts();
+    Uint64 getFrequency();
+    void delay(Uint32 ms);
+    void waitUntil(Uint64 counts);
+    void endFrame();
+
+private:
+    Uint64 mFrequency;
+};
+
+// Time that only moves when told to, for runs that must repeat exactly
+class LVirtualClock : public LClock
+{
+public:
+    // Constructor
+    LVirtualClock();
+
+    // Counts are nanoseconds
+    Uint64 getCounts();
+    Uint64 getFrequency();
+
+    // Sleeping and waiting jump straight to the requested time
+    void delay(Uint32 ms);
+    void waitUntil(Uint64 counts);
+
+    // Moves on by the next scripted frame length, or the fixed step
+    void endFrame();
+
+    // Moves time forward
+    void advance(Uint64 nanoseconds);
+
+    // Sets the frame length used when there's no script
+    void setFrameStep(Uint64 nanoseconds);
+
+    // Loads frame lengths in milliseconds, one per line, played in order and repeated
+    bool loadScript(std::string path);
+
+private:
+    Uint64 mNow;
+    Uint64 mFrameStep;
+    std::vector<Uint64> mScript;
+    size_t mScriptPos;
+};
+/************************************************************************/
+
 /*************************************************************************
  Texture wrapper class
 *************************************************************************/
@@ -63,6 +145,8 @@ Constants
 const int SCREEN_WIDTH = 800;
 const int SCREEN_HEIGHT = 600;
 
+// Frame rate a virtual clock steps at when it has no script
+const int VIRTUAL_CLOCK_FPS = 60;
 /*********************************************************************/
 
 /**********************************************************************
@@ -74,6 +158,11 @@ SDL_Window* gWindow = nullptr;
 // The window renderer
 SDL_Renderer* gRenderer = nullptr;
 
+// Clocks timers can read from, real unless a run asks for virtual time
+LRealClock gRealClock;
+LVirtualClock gVirtualClock;
+LClock* gClock = &gRealClock;
+
 // Globally used font
 TTF_Font* gFont = nullptr;
 
@@ -89,6 +178,9 @@ Function Declarations
 **************************************************************************/
 bool init();
 
+// Picks the clock from a command line argument, false if it isn't a clock option
+bool selectClock(std::string arg);
+
 bool loadMedia();
 
 void close();
@@ -243,10 +335,152 @@ int LTexture::getHeight()
 }
 /**************************************************************************/
 
+/************************************************************************
+LClock Method Declarations
+*************************************************************************/
+Uint64 LClock::getTicks()
+{
+    // Split the conversion so counts * 1000 can't overflow
+    Uint64 counts = getCounts();
+    Uint64 frequency = getFrequency();
+    return counts / frequency * 1000 + counts % frequency * 1000 / frequency;
+}
+
+LRealClock::LRealClock()
+{
+    mFrequency = SDL_GetPerformanceFrequency();
+}
+
+Uint64 LRealClock::getCounts()
+{
+    return SDL_GetPerformanceCounter();
+}
+
+Uint64 LRealClock::getFrequency()
+{
+    return mFrequency;
+}
+
+void LRealClock::delay(Uint32 ms)
+{
+    SDL_Delay(ms);
+}
+
+void LRealClock::waitUntil(Uint64 counts)
+{
+    while(SDL_GetPerformanceCounter() < counts)
+    {
+    }
+}
+
+void LRealClock::endFrame()
+{
+}
+
+LVirtualClock::LVirtualClock()
+{
+    mNow = 0;
+    mFrameStep = 1000000000 / VIRTUAL_CLOCK_FPS;
+    mScriptPos = 0;
+}
+
+Uint64 LVirtualClock::getCounts()
+{
+    return mNow;
+}
+
+Uint64 LVirtualClock::getFrequency()
+{
+    return 1000000000;
+}
+
+void LVirtualClock::delay(Uint32 ms)
+{
+    mNow += (Uint64)ms * 1000000;
+}
+
+void LVirtualClock::waitUntil(Uint64 counts)
+{
+    if(counts > mNow)
+    {
+        mNow = counts;
+    }
+}
+
+void LVirtualClock::endFrame()
+{
+    if(mScript.empty())
+    {
+        mNow += mFrameStep;
+    }
+    else
+    {
+        mNow += mScript[mScriptPos];
+        mScriptPos = (mScriptPos + 1) % mScript.size();
+    }
+}
+
+void LVirtualClock::advance(Uint64 nanoseconds)
+{
+    mNow += nanoseconds;
+}
+
+void LVirtualClock::setFrameStep(Uint64 nanoseconds)
+{
+    mFrameStep = nanoseconds;
+}
+
+bool LVirtualClock::loadScript(std::string path)
+{
+    std::ifstream script(path.c_str());
+    if(!script)
+    {
+        return false;
+    }
+
+    std::vector<Uint64> steps;
+    double ms = 0;
+    while(script >> ms)
+    {
+        steps.push_back((Uint64)(ms * 1000000.0 + 0.5));
+    }
+    if(steps.empty())
+    {
+        return false;
+    }
+
+    mScript = steps;
+    mScriptPos = 0;
+    return true;
+}
+/**************************************************************************/
+
 /***************************************************************************
 Function Definitions
 ***************************************************************************/
 
+bool selectClock(std::string arg)
+{
+    if(arg == "--virtual")
+    {
+        gClock = &gVirtualClock;
+        return true;
+    }
+    if(arg.compare(0, 9, "--script=") == 0)
+    {
+        if(gVirtualClock.loadScript(arg.substr(9)))
+        {
+            gClock = &gVirtualClock;
+        }
+        else
+        {
+            printf( "Unable to load clock script %s!\n", arg.substr(9).c_str() );
+        }
+        return true;
+    }
+    return false;
+}
+
 bool init()
 {
 	//Initialization flag
@@ -359,6 +593,14 @@ Main
 **************************************************************************/
 int main( int argc, char* args[] )
 {
+    // Real time unless a run asks for a virtual clock
+    for(int i = 1; i < argc; ++i)
+    {
+        if(!selectClock(args[i]))
+        {
+            printf( "Unknown option %s\n", args[i] );
+        }
+    }
 
 	//Start up SDL and create window
 	if( !init() )
@@ -388,7 +630,7 @@ int main( int argc, char* args[] )
 			SDL_Color textColor = {0, 0, 0, 255};
 
 			// Current time start time
-			Uint32 startTime = 0;
+			Uint64 startTime = 0;
 
 			// In memory text stream
 			std::stringstream timeText;
@@ -408,13 +650,13 @@ int main( int argc, char* args[] )
 					}
 					else if( e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_RETURN)
                     {
-                        startTime = SDL_GetTicks();
+                        startTime = gClock->getTicks();
                     }
 				}
 
 				// Set text to be rendered
 				timeText.str("");
-				timeText << "Milliseconds since start time " << SDL_GetTicks() - startTime;
+				timeText << "Milliseconds since start time " << gClock->getTicks() - startTime;
 
                 // Render text
                 if( !gTimeTextTexture.loadFromRenderedText( timeText.str().c_str(), textColor))
@@ -437,6 +679,9 @@ int main( int argc, char* args[] )
 				//Update screen
 				SDL_RenderPresent( gRenderer );
 
+                // Let a virtual clock move on to the next frame
+                gClock->endFrame();
+
 
 			}
 		}
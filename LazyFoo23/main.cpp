@@ -2,37 +2,134 @@
 #include <cstdlib>
 #include <string>
 #include <sstream>
+#include <fstream>
+#include <vector>
+#include <list>
+#include <unordered_map>
 #include <SDL.h>
 #include <SDL_image.h>
 #include <SDL_ttf.h>
 
+/*************************************************************************
+ Clock classes
+*************************************************************************/
+// Where timers read time from, so a run can use real or scripted time
+class LClock
+{
+public:
+    virtual ~LClock() {}
+
+    // Current time in counts
+    virtual Uint64 getCounts() = 0;
+
+    // Counts per second
+    virtual Uint64 getFrequency() = 0;
+
+    // Sleeps for about the given milliseconds
+    virtual void delay(Uint32 ms) = 0;
+
+    // Returns once the time has reached counts
+    virtual void waitUntil(Uint64 counts) = 0;
+
+    // Called by the main loop once per frame
+    virtual void endFrame() = 0;
+
+    // Current time in milliseconds
+    Uint64 getTicks();
+};
+
+// Wall clock time from the performance counter
+class LRealClock : public LClock
+{
+public:
+    // Constructor
+    LRealClock();
+
+    Uint64 getCounts();
+    Uint64 getFrequency();
+    void delay(Uint32 ms);
+    void waitUntil(Uint64 counts);
+    void endFrame();
+
+private:
+    Uint64 mFrequency;
+};
+
+// Time that only moves when told to, for runs that must repeat exactly
+class LVirtualClock : public LClock
+{
+public:
+    // Constructor
+    LVirtualClock();
+
+    // Counts are nanoseconds
+    Uint64 getCounts();
+    Uint64 getFrequency();
+
+    // Sleeping and waiting jump straight to the requested time
+    void delay(Uint32 ms);
+    void waitUntil(Uint64 counts);
+
+    // Moves on by the next scripted frame length, or the fixed step
+    void endFrame();
+
+    // Moves time forward
+    void advance(Uint64 nanoseconds);
+
+    // Sets the frame length used when there's no script
+    void setFrameStep(Uint64 nanoseconds);
+
+    // Loads frame lengths in milliseconds, one per line, played in order and repeated
+    bool loadScript(std::string path);
+
+private:
+    Uint64 mNow;
+    Uint64 mFrameStep;
+    std::vector<Uint64> mScript;
+    size_t mScriptPos;
+};
+/************************************************************************/
+
 /*************************************************************************
  Timer Class
 *************************************************************************/
 class LTimer
 {
 public:
-    // Constructor
-    LTimer();
+    // Constructor, times with gClock unless given another clock
+    LTimer(LClock* clock = NULL);
 
     void start();
     void stop();
     void pause();
     void unpause();
 
-    //Gets the timer's time
-    Uint32 getTicks();
+    //Gets the timer's time in milliseconds
+    Uint64 getTicks();
+
+    // Gets the timer's time at clock resolution
+    Uint64 getNanoseconds();
+    double getSeconds();
 
     // Checks the status of the timer
     bool isStarted();
     bool isPaused();
 
 private:
-    // The clock time when the timer started
-    Uint32 mStartTicks;
+    // Clock counts elapsed so far
+    Uint64 getCounts();
+
+    // Where the time comes from
+    LClock* mClock;
+
+    // The clock counts when the timer started
+    Uint64 mStartCounts;
+
+    // The elapsed counts stored when the timer was paused
+    Uint64 mPausedCounts;
 
-    // The ticks stored  when the timer was paused
-    Uint32 mPausedTicks;
+    // Clock counts per second
+    Uint64 mFrequency;
 
     // The timer status
     bool mPaused;
@@ -55,8 +152,8 @@ public:
     // Loads image at specified path
     bool loadFromFile(std::string path);
 
-    // Creates image from string
-    bool loadFromRenderedText(std::string textureText, SDL_Color textColor);
+    // Creates image from string, using the global font if none is given
+    bool loadFromRenderedText(std::string textureText, SDL_Color textColor, TTF_Font* font = nullptr);
     // Deallocate texture
     void free();
 
@@ -91,12 +188,69 @@ private:
 
 /*********************************************************************/
 
+/*************************************************************************
+ Text texture cache class
+*************************************************************************/
+class LTextCache
+{
+public:
+    // Constructor
+    LTextCache(int maxBytes);
+
+    // Destructor
+    ~LTextCache();
+
+    // Gets the texture for the text, only rendering it if it isn't cached
+    LTexture* getText(TTF_Font* font, std::string text, SDL_Color textColor);
+
+    // Deallocate every cached texture
+    void free();
+
+    // Sets how much texture memory the cache can hold
+    void setMaxBytes(int maxBytes);
+
+    // Gets cache statistics
+    int getHits();
+    int getMisses();
+    int getBytes();
+    int getCount();
+
+private:
+    // A rendered string
+    struct Entry
+    {
+        std::string key;
+        LTexture* texture;
+        int bytes;
+    };
+
+    // Throws out least recently used textures until under the cap
+    void evict();
+
+    // Most recently used textures first
+    std::list<Entry> mEntries;
+    std::unordered_map<std::string, std::list<Entry>::iterator> mLookup;
+
+    // Memory used and allowed
+    int mBytes;
+    int mMaxBytes;
+
+    // Lookup statistics
+    int mHits;
+    int mMisses;
+};
+
+/*********************************************************************/
+
 /**********************************************************************
 Constants
 **********************************************************************/
 const int SCREEN_WIDTH = 800;
 const int SCREEN_HEIGHT = 600;
+const int TEXT_CACHE_MAX_BYTES = 4 * 1024 * 1024;
 const int WALKING_ANIMATION_FRAMES = 4;
+// Frame rate a virtual clock steps at when it has no script
+const int VIRTUAL_CLOCK_FPS = 60;
 /*********************************************************************/
 
 /**********************************************************************
@@ -108,12 +262,19 @@ SDL_Window* gWindow = nullptr;
 // The window renderer
 SDL_Renderer* gRenderer = nullptr;
 
+// Clocks timers can read from, real unless a run asks for virtual time
+LRealClock gRealClock;
+LVirtualClock gVirtualClock;
+LClock* gClock = &gRealClock;
+
 // Globally used font
 TTF_Font* gFont = nullptr;
 
 // Rendered Texture
 //LTexture gTextTexture;
-LTexture gTimeTextTexture;
+
+// Rendered strings that get reused
+LTextCache gTextCache(TEXT_CACHE_MAX_BYTES);
 LTexture gPausePromptTexture;
 LTexture gStartPromptTexture;
 
@@ -124,15 +285,138 @@ Function Declarations
 **************************************************************************/
 bool init();
 
+// Picks the clock from a command line argument, false if it isn't a clock option
+bool selectClock(std::string arg);
+
 bool loadMedia();
 
 void close();
 /************************************************************************/
 
+/************************************************************************
+LClock Method Declarations
+*************************************************************************/
+Uint64 LClock::getTicks()
+{
+    // Split the conversion so counts * 1000 can't overflow
+    Uint64 counts = getCounts();
+    Uint64 frequency = getFrequency();
+    return counts / frequency * 1000 + counts % frequency * 1000 / frequency;
+}
+
+LRealClock::LRealClock()
+{
+    mFrequency = SDL_GetPerformanceFrequency();
+}
+
+Uint64 LRealClock::getCounts()
+{
+    return SDL_GetPerformanceCounter();
+}
+
+Uint64 LRealClock::getFrequency()
+{
+    return mFrequency;
+}
+
+void LRealClock::delay(Uint32 ms)
+{
+    SDL_Delay(ms);
+}
+
+void LRealClock::waitUntil(Uint64 counts)
+{
+    while(SDL_GetPerformanceCounter() < counts)
+    {
+    }
+}
+
+void LRealClock::endFrame()
+{
+}
+
+LVirtualClock::LVirtualClock()
+{
+    mNow = 0;
+    mFrameStep = 1000000000 / VIRTUAL_CLOCK_FPS;
+    mScriptPos = 0;
+}
+
+Uint64 LVirtualClock::getCounts()
+{
+    return mNow;
+}
+
+Uint64 LVirtualClock::getFrequency()
+{
+    return 1000000000;
+}
+
+void LVirtualClock::delay(Uint32 ms)
+{
+    mNow += (Uint64)ms * 1000000;
+}
+
+void LVirtualClock::waitUntil(Uint64 counts)
+{
+    if(counts > mNow)
+    {
+        mNow = counts;
+    }
+}
+
+void LVirtualClock::endFrame()
+{
+    if(mScript.empty())
+    {
+        mNow += mFrameStep;
+    }
+    else
+    {
+        mNow += mScript[mScriptPos];
+        mScriptPos = (mScriptPos + 1) % mScript.size();
+    }
+}
+
+void LVirtualClock::advance(Uint64 nanoseconds)
+{
+    mNow += nanoseconds;
+}
+
+void LVirtualClock::setFrameStep(Uint64 nanoseconds)
+{
+    mFrameStep = nanoseconds;
+}
+
+bool LVirtualClock::loadScript(std::string path)
+{
+    std::ifstream script(path.c_str());
+    if(!script)
+    {
+        return false;
+    }
+
+    std::vector<Uint64> steps;
+    double ms = 0;
+    while(script >> ms)
+    {
+        steps.push_back((Uint64)(ms * 1000000.0 + 0.5));
+    }
+    if(steps.empty())
+    {
+        return false;
+    }
+
+    mScript = steps;
+    mScriptPos = 0;
+    return true;
+}
+/**************************************************************************/
+
 /************************************************************************
 LTimer Method Declarations
 *************************************************************************/
-LTimer::LTimer(): mStartTicks(0), mPausedTicks(0), mPaused(false), mStarted(false)
+LTimer::LTimer(LClock* clock): mClock(clock != NULL ? clock : gClock), mStartCounts(0), mPausedCounts(0), mFrequency(mClock->getFrequency()), mPaused(false), mStarted(false)
 {
 }
 
@@ -145,8 +429,8 @@ void LTimer::start()
     mPaused = false;
 
     // Get the current clock time
-    mStartTicks = SDL_GetTicks();
-    mPausedTicks = 0;
+    mStartCounts = mClock->getCounts();
+    mPausedCounts = 0;
 }
 
 void LTimer::stop()
@@ -158,8 +442,8 @@ void LTimer::stop()
     mPaused = false;
 
     // Clear tick variables
-    mStartTicks = 0;
-    mPausedTicks = 0;
+    mStartCounts = 0;
+    mPausedCounts = 0;
 }
 
 void LTimer::pause()
@@ -169,9 +453,9 @@ void LTimer::pause()
     {
         mPaused = true;
 
-        // Calculate the paused tickes
-        mPausedTicks = SDL_GetTicks() - mStartTicks;
-        mStartTicks = 0;
+        // Calculate the paused counts
+        mPausedCounts = mClock->getCounts() - mStartCounts;
+        mStartCounts = 0;
     }
 }
 
@@ -183,18 +467,18 @@ void LTimer::unpause()
         // Unpause the timer
         mPaused = false;
 
-        // Reset the starting ticks
-        mStartTicks = SDL_GetTicks() - mPausedTicks;
+        // Reset the starting counts
+        mStartCounts = mClock->getCounts() - mPausedCounts;
 
-        // Reset the paused ticks
-        mPausedTicks = 0;
+        // Reset the paused counts
+        mPausedCounts = 0;
     }
 }
 
-Uint32 LTimer::getTicks()
+Uint64 LTimer::getCounts()
 {
     // The actual timer time
-    Uint32 time = 0;
+    Uint64 counts = 0;
 
     // If the timer is running
     if(mStarted)
@@ -202,14 +486,31 @@ Uint32 LTimer::getTicks()
         // If the timer is paused
         if(mPaused)
         {
-            time = mPausedTicks;
+            counts = mPausedCounts;
         }
         else
         {
-            time = SDL_GetTicks() - mStartTicks;
+            counts = mClock->getCounts() - mStartCounts;
         }
     }
-    return time;
+    return counts;
+}
+
+Uint64 LTimer::getTicks()
+{
+    return getNanoseconds() / 1000000;
+}
+
+Uint64 LTimer::getNanoseconds()
+{
+    // Split the conversion so counts * 1e9 can't overflow
+    Uint64 counts = getCounts();
+    return counts / mFrequency * 1000000000 + counts % mFrequency * 1000000000 / mFrequency;
+}
+
+double LTimer::getSeconds()
+{
+    return (double)getCounts() / mFrequency;
 }
 
 bool LTimer::isStarted()
@@ -295,13 +596,19 @@ void LTexture::free()
 }
 
 // Create image from text
-bool LTexture::loadFromRenderedText( std::string textureText, SDL_Color textColor)
+bool LTexture::loadFromRenderedText( std::string textureText, SDL_Color textColor, TTF_Font* font)
 {
     // Get rid of preexisting texture
     free();
 
+    // Fall back on the global font
+    if(font == nullptr)
+    {
+        font = gFont;
+    }
+
     // Render text surface
-    SDL_Surface* textSurface = TTF_RenderText_Solid(gFont, textureText.c_str(), textColor );
+    SDL_Surface* textSurface = TTF_RenderText_Solid(font, textureText.c_str(), textColor );
     if(textSurface == nullptr)
     {
         std::cout << "Unable to render text surface! SDL_ttf Error: " << TTF_GetError() << std::endl;
@@ -374,10 +681,148 @@ int LTexture::getHeight()
 }
 /**************************************************************************/
 
+/*********************************************************************
+LTextCache Method Declarations
+*********************************************************************/
+
+// Constructor
+LTextCache::LTextCache(int maxBytes)
+{
+    // Initialize
+    mBytes = 0;
+    mMaxBytes = maxBytes;
+    mHits = 0;
+    mMisses = 0;
+}
+
+LTextCache::~LTextCache()
+{
+    // Deallocate
+    free();
+}
+
+LTexture* LTextCache::getText(TTF_Font* font, std::string text, SDL_Color textColor)
+{
+    // Build the lookup key from the font, its style, the color and the text, an open
+    // font's size never changes so the pointer covers it
+    std::stringstream key;
+    key << font << ':' << TTF_GetFontStyle(font) << ':'
+        << (int)textColor.r << ',' << (int)textColor.g << ',' << (int)textColor.b << ',' << (int)textColor.a << ':'
+        << text;
+
+    // Already rendered
+    auto found = mLookup.find(key.str());
+    if(found != mLookup.end())
+    {
+        ++mHits;
+
+        // Move to the front of the line
+        mEntries.splice(mEntries.begin(), mEntries, found->second);
+        return found->second->texture;
+    }
+
+    ++mMisses;
+
+    // Render the new text
+    LTexture* texture = new LTexture();
+    if(!texture->loadFromRenderedText(text, textColor, font))
+    {
+        delete texture;
+        return nullptr;
+    }
+
+    Entry entry;
+    entry.key = key.str();
+    entry.texture = texture;
+    entry.bytes = texture->getWidth() * texture->getHeight() * 4;
+
+    mEntries.push_front(entry);
+    mLookup[entry.key] = mEntries.begin();
+    mBytes += entry.bytes;
+
+    // Make room
+    evict();
+
+    return texture;
+}
+
+void LTextCache::free()
+{
+    for(auto it = mEntries.begin(); it != mEntries.end(); ++it)
+    {
+        delete it->texture;
+    }
+    mEntries.clear();
+    mLookup.clear();
+    mBytes = 0;
+}
+
+void LTextCache::setMaxBytes(int maxBytes)
+{
+    mMaxBytes = maxBytes;
+    evict();
+}
+
+int LTextCache::getHits()
+{
+    return mHits;
+}
+
+int LTextCache::getMisses()
+{
+    return mMisses;
+}
+
+int LTextCache::getBytes()
+{
+    return mBytes;
+}
+
+int LTextCache::getCount()
+{
+    return mEntries.size();
+}
+
+void LTextCache::evict()
+{
+    // Always keep the most recent texture since the caller is using it
+    while(mBytes > mMaxBytes && mEntries.size() > 1)
+    {
+        Entry& oldest = mEntries.back();
+        mBytes -= oldest.bytes;
+        mLookup.erase(oldest.key);
+        delete oldest.texture;
+        mEntries.pop_back();
+    }
+}
+/**************************************************************************/
+
 /***************************************************************************
 Function Definitions
 ***************************************************************************/
 
+bool selectClock(std::string arg)
+{
+    if(arg == "--virtual")
+    {
+        gClock = &gVirtualClock;
+        return true;
+    }
+    if(arg.compare(0, 9, "--script=") == 0)
+    {
+        if(gVirtualClock.loadScript(arg.substr(9)))
+        {
+            gClock = &gVirtualClock;
+        }
+        else
+        {
+            printf( "Unable to load clock script %s!\n", arg.substr(9).c_str() );
+        }
+        return true;
+    }
+    return false;
+}
+
 bool init()
 {
 	//Initialization flag
@@ -476,7 +921,11 @@ bool loadMedia()
 void close()
 {
     // Free loaded images
-    gTimeTextTexture.free();
+    std::cout << "Text cache hits: " << gTextCache.getHits()
+              << " misses: " << gTextCache.getMisses()
+              << " textures: " << gTextCache.getCount()
+              << " bytes: " << gTextCache.getBytes() << std::endl;
+    gTextCache.free();
     gStartPromptTexture.free();
     gPausePromptTexture.free();
 
@@ -500,6 +949,14 @@ Main
 **************************************************************************/
 int main( int argc, char* args[] )
 {
+    // Real time unless a run asks for a virtual clock
+    for(int i = 1; i < argc; ++i)
+    {
+        if(!selectClock(args[i]))
+        {
+            printf( "Unknown option %s\n", args[i] );
+        }
+    }
 
 	//Start up SDL and create window
 	if( !init() )
@@ -530,6 +987,11 @@ int main( int argc, char* args[] )
             // In memory text stream
             std::stringstream timeText;
 
+            // The time changes every frame so it's rendered on its own, and only when
+            // the shown tenth of a second changes, keeping the cache for stable text
+            LTexture timeValueTexture;
+            std::string shownTime;
+
 			//While application is running
 			while( !quit )
 			{
@@ -571,12 +1033,23 @@ int main( int argc, char* args[] )
 
                 // Set text to be rendered
                 timeText.str("");
-                timeText << "Seconds since start time " << (timer.getTicks()/ 1000.0f);
+                timeText << std::fixed;
+                timeText.precision(1);
+                timeText << timer.getSeconds();
+                if(timeText.str() != shownTime)
+                {
+                    shownTime = timeText.str();
+                    if(!timeValueTexture.loadFromRenderedText(shownTime, textColor))
+                    {
+                        std::cout << "Unable to render time texture!" << std::endl;
+                    }
+                }
 
-                // Render text
-                if(!gTimeTextTexture.loadFromRenderedText(timeText.str().c_str(), textColor))
+                // The label never changes so it comes from the cache
+                LTexture* timeTextTexture = gTextCache.getText(gFont, "Seconds since start time ", textColor);
+                if(timeTextTexture == nullptr)
                 {
-                    std::cout << "Unable to render time texture!" << std::endl;
+                    std::cout << "Unable to render time label texture!" << std::endl;
                 }
 
 				//Clear screen
@@ -587,7 +1060,15 @@ int main( int argc, char* args[] )
 
                 gStartPromptTexture.render((SCREEN_WIDTH - gStartPromptTexture.getWidth())/2, 0);
                 gPausePromptTexture.render((SCREEN_WIDTH - gPausePromptTexture.getWidth())/2, gStartPromptTexture.getHeight());
-                gTimeTextTexture.render((SCREEN_WIDTH - gTimeTextTexture.getWidth())/2, (SCREEN_HEIGHT - gTimeTextTexture.getHeight())/2);
+                if(timeTextTexture != nullptr)
+                {
+                    // Label and value centered together as one line
+                    int lineWidth = timeTextTexture->getWidth() + timeValueTexture.getWidth();
+                    int x = (SCREEN_WIDTH - lineWidth)/2;
+                    int y = (SCREEN_HEIGHT - timeTextTexture->getHeight())/2;
+                    timeTextTexture->render(x, y);
+                    timeValueTexture.render(x + timeTextTexture->getWidth(), y);
+                }
 
 
 
@@ -595,6 +1076,9 @@ int main( int argc, char* args[] )
 				//Update screen
 				SDL_RenderPresent( gRenderer );
 
+                // Let a virtual clock move on to the next frame
+                gClock->endFrame();
+
 
 			}
 		}
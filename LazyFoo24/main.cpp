@@ -2,37 +2,134 @@
 #include <cstdlib>
 #include <string>
 #include <sstream>
+#include <fstream>
+#include <vector>
+#include <cstring>
+#include <cmath>
 #include <SDL.h>
 #include <SDL_image.h>
 #include <SDL_ttf.h>
 
+/*************************************************************************
+ Clock classes
+*************************************************************************/
+// Where timers read time from, so a run can use real or scripted time
+class LClock
+{
+public:
+    virtual ~LClock() {}
+
+    // Current time in counts
+    virtual Uint64 getCounts() = 0;
+
+    // Counts per second
+    virtual Uint64 getFrequency() = 0;
+
+    // Sleeps for about the given milliseconds
+    virtual void delay(Uint32 ms) = 0;
+
+    // Returns once the time has reached counts
+    virtual void waitUntil(Uint64 counts) = 0;
+
+    // Called by the main loop once per frame
+    virtual void endFrame() = 0;
+
+    // Current time in milliseconds
+    Uint64 getTicks();
+};
+
+// Wall clock time from the performance counter
+class LRealClock : public LClock
+{
+public:
+    // Constructor
+    LRealClock();
+
+    Uint64 getCounts();
+    Uint64 getFrequency();
+    void delay(Uint32 ms);
+    void waitUntil(Uint64 counts);
+    void endFrame();
+
+private:
+    Uint64 mFrequency;
+};
+
+// Time that only moves when told to, for runs that must repeat exactly
+class LVirtualClock : public LClock
+{
+public:
+    // Constructor
+    LVirtualClock();
+
+    // Counts are nanoseconds
+    Uint64 getCounts();
+    Uint64 getFrequency();
+
+    // Sleeping and waiting jump straight to the requested time
+    void delay(Uint32 ms);
+    void waitUntil(Uint64 counts);
+
+    // Moves on by the next scripted frame length, or the fixed step
+    void endFrame();
+
+    // Moves time forward
+    void advance(Uint64 nanoseconds);
+
+    // Sets the frame length used when there's no script
+    void setFrameStep(Uint64 nanoseconds);
+
+    // Loads frame lengths in milliseconds, one per line, played in order and repeated
+    bool loadScript(std::string path);
+
+private:
+    Uint64 mNow;
+    Uint64 mFrameStep;
+    std::vector<Uint64> mScript;
+    size_t mScriptPos;
+};
+/************************************************************************/
+
 /*************************************************************************
  Timer Class
 *************************************************************************/
 class LTimer
 {
 public:
-    // Constructor
-    LTimer();
+    // Constructor, times with gClock unless given another clock
+    LTimer(LClock* clock = NULL);
 
     void start();
     void stop();
     void pause();
     void unpause();
 
-    //Gets the timer's time
-    Uint32 getTicks();
+    //Gets the timer's time in milliseconds
+    Uint64 getTicks();
+
+    // Gets the timer's time at clock resolution
+    Uint64 getNanoseconds();
+    double getSeconds();
 
     // Checks the status of the timer
     bool isStarted();
     bool isPaused();
 
 private:
-    // The clock time when the timer started
-    Uint32 mStartTicks;
+    // Clock counts elapsed so far
+    Uint64 getCounts();
+
+    // Where the time comes from
+    LClock* mClock;
+
+    // The clock counts when the timer started
+    Uint64 mStartCounts;
+
+    // The elapsed counts stored when the timer was paused
+    Uint64 mPausedCounts;
 
-    // The ticks stored  when the timer was paused
-    Uint32 mPausedTicks;
+    // Clock counts per second
+    Uint64 mFrequency;
 
     // The timer status
     bool mPaused;
@@ -91,12 +188,123 @@ private:
 
 /*********************************************************************/
 
+/*************************************************************************
+ Glyph atlas class
+*************************************************************************/
+class LGlyphAtlas
+{
+public:
+    // Constructor
+    LGlyphAtlas();
+
+    // Destructor
+    ~LGlyphAtlas();
+
+    // Rasterizes every printable glyph of the font into one texture
+    bool buildAtlas(TTF_Font* font);
+
+    // Deallocate atlas texture
+    void free();
+
+    // Shows the text using the cached glyphs
+    void renderText(int x, int y, std::string text, SDL_Color textColor);
+
+    // Gets the size the text would take up
+    int getTextWidth(std::string text);
+    int getTextHeight(std::string text);
+
+private:
+    // Maps characters the atlas doesn't have to '?'
+    int getGlyphIndex(char c);
+
+    // The shared glyph texture
+    SDL_Texture* mTexture;
+
+    // Where each character sits in the texture
+    SDL_Rect mClips[128];
+
+    // How far to move after each character
+    int mAdvances[128];
+
+    // Line spacing of the font
+    int mLineSkip;
+};
+
+/*********************************************************************/
+
 /**********************************************************************
 Constants
 **********************************************************************/
 const int SCREEN_WIDTH = 800;
 const int SCREEN_HEIGHT = 600;
+
+// Printable characters kept in the glyph atlas
+const int GLYPH_FIRST = 32;
+const int GLYPH_LAST = 126;
+const int GLYPH_ATLAS_WIDTH = 512;
 const int WALKING_ANIMATION_FRAMES = 4;
+
+// Frames in the rolling statistics window
+const int FRAME_STATS_WINDOW = 240;
+
+// Frame time histogram, 0.1ms buckets up to 100ms
+const int FRAME_STATS_BUCKET_MICROSECONDS = 100;
+const int FRAME_STATS_BUCKETS = 1000;
+
+// A frame this many times the median counts as a hitch
+const int FRAME_STATS_HITCH_FACTOR = 2;
+
+// Frames between statistics text refreshes
+const int FRAME_STATS_DISPLAY_FRAMES = 30;
+// Frame rate a virtual clock steps at when it has no script
+const int VIRTUAL_CLOCK_FPS = 60;
+/*********************************************************************/
+
+/*************************************************************************
+ Frame statistics class
+*************************************************************************/
+class LFrameStats
+{
+public:
+    // Constructor
+    LFrameStats();
+
+    // Adds one frame time
+    void addFrame(Uint32 microseconds);
+
+    // Forgets all frames
+    void reset();
+
+    // Rolling window statistics in milliseconds, no allocation or sorting
+    double getAverage();
+    double getFps();
+    double getPercentile(double percent);
+    double getMax();
+
+    // Frames over FRAME_STATS_HITCH_FACTOR times the median
+    int getHitches();
+    int getTotalHitches();
+
+private:
+    // Histogram bucket for a frame time
+    static int getBucket(Uint32 microseconds);
+
+    // Ring of the most recent frame times and whether each was a hitch
+    Uint32 mTimes[FRAME_STATS_WINDOW];
+    bool mHitch[FRAME_STATS_WINDOW];
+    int mNext;
+    int mCount;
+
+    // Histogram of the frames in the ring
+    int mBuckets[FRAME_STATS_BUCKETS];
+
+    // Sum of the frames in the ring
+    Uint64 mTotal;
+
+    int mHitches;
+    int mTotalHitches;
+};
+
 /*********************************************************************/
 
 /**********************************************************************
@@ -108,12 +316,19 @@ SDL_Window* gWindow = nullptr;
 // The window renderer
 SDL_Renderer* gRenderer = nullptr;
 
+// Clocks timers can read from, real unless a run asks for virtual time
+LRealClock gRealClock;
+LVirtualClock gVirtualClock;
+LClock* gClock = &gRealClock;
+
 // Globally used font
 TTF_Font* gFont = nullptr;
 
 // Rendered Texture
 //LTexture gTextTexture;
-LTexture gFPSTextTexture;
+
+// Cached font glyphs
+LGlyphAtlas gGlyphAtlas;
 
 /*********************************************************************/
 
@@ -122,15 +337,138 @@ Function Declarations
 **************************************************************************/
 bool init();
 
+// Picks the clock from a command line argument, false if it isn't a clock option
+bool selectClock(std::string arg);
+
 bool loadMedia();
 
 void close();
 /************************************************************************/
 
+/************************************************************************
+LClock Method Declarations
+*************************************************************************/
+Uint64 LClock::getTicks()
+{
+    // Split the conversion so counts * 1000 can't overflow
+    Uint64 counts = getCounts();
+    Uint64 frequency = getFrequency();
+    return counts / frequency * 1000 + counts % frequency * 1000 / frequency;
+}
+
+LRealClock::LRealClock()
+{
+    mFrequency = SDL_GetPerformanceFrequency();
+}
+
+Uint64 LRealClock::getCounts()
+{
+    return SDL_GetPerformanceCounter();
+}
+
+Uint64 LRealClock::getFrequency()
+{
+    return mFrequency;
+}
+
+void LRealClock::delay(Uint32 ms)
+{
+    SDL_Delay(ms);
+}
+
+void LRealClock::waitUntil(Uint64 counts)
+{
+    while(SDL_GetPerformanceCounter() < counts)
+    {
+    }
+}
+
+void LRealClock::endFrame()
+{
+}
+
+LVirtualClock::LVirtualClock()
+{
+    mNow = 0;
+    mFrameStep = 1000000000 / VIRTUAL_CLOCK_FPS;
+    mScriptPos = 0;
+}
+
+Uint64 LVirtualClock::getCounts()
+{
+    return mNow;
+}
+
+Uint64 LVirtualClock::getFrequency()
+{
+    return 1000000000;
+}
+
+void LVirtualClock::delay(Uint32 ms)
+{
+    mNow += (Uint64)ms * 1000000;
+}
+
+void LVirtualClock::waitUntil(Uint64 counts)
+{
+    if(counts > mNow)
+    {
+        mNow = counts;
+    }
+}
+
+void LVirtualClock::endFrame()
+{
+    if(mScript.empty())
+    {
+        mNow += mFrameStep;
+    }
+    else
+    {
+        mNow += mScript[mScriptPos];
+        mScriptPos = (mScriptPos + 1) % mScript.size();
+    }
+}
+
+void LVirtualClock::advance(Uint64 nanoseconds)
+{
+    mNow += nanoseconds;
+}
+
+void LVirtualClock::setFrameStep(Uint64 nanoseconds)
+{
+    mFrameStep = nanoseconds;
+}
+
+bool LVirtualClock::loadScript(std::string path)
+{
+    std::ifstream script(path.c_str());
+    if(!script)
+    {
+        return false;
+    }
+
+    std::vector<Uint64> steps;
+    double ms = 0;
+    while(script >> ms)
+    {
+        steps.push_back((Uint64)(ms * 1000000.0 + 0.5));
+    }
+    if(steps.empty())
+    {
+        return false;
+    }
+
+    mScript = steps;
+    mScriptPos = 0;
+    return true;
+}
+/**************************************************************************/
+
 /************************************************************************
 LTimer Method Declarations
 *************************************************************************/
-LTimer::LTimer(): mStartTicks(0), mPausedTicks(0), mPaused(false), mStarted(false)
+LTimer::LTimer(LClock* clock): mClock(clock != NULL ? clock : gClock), mStartCounts(0), mPausedCounts(0), mFrequency(mClock->getFrequency()), mPaused(false), mStarted(false)
 {
 }
 
@@ -143,8 +481,8 @@ void LTimer::start()
     mPaused = false;
 
     // Get the current clock time
-    mStartTicks = SDL_GetTicks();
-    mPausedTicks = 0;
+    mStartCounts = mClock->getCounts();
+    mPausedCounts = 0;
 }
 
 void LTimer::stop()
@@ -156,8 +494,8 @@ void LTimer::stop()
     mPaused = false;
 
     // Clear tick variables
-    mStartTicks = 0;
-    mPausedTicks = 0;
+    mStartCounts = 0;
+    mPausedCounts = 0;
 }
 
 void LTimer::pause()
@@ -167,9 +505,9 @@ void LTimer::pause()
     {
         mPaused = true;
 
-        // Calculate the paused tickes
-        mPausedTicks = SDL_GetTicks() - mStartTicks;
-        mStartTicks = 0;
+        // Calculate the paused counts
+        mPausedCounts = mClock->getCounts() - mStartCounts;
+        mStartCounts = 0;
     }
 }
 
@@ -181,18 +519,18 @@ void LTimer::unpause()
         // Unpause the timer
         mPaused = false;
 
-        // Reset the starting ticks
-        mStartTicks = SDL_GetTicks() - mPausedTicks;
+        // Reset the starting counts
+        mStartCounts = mClock->getCounts() - mPausedCounts;
 
-        // Reset the paused ticks
-        mPausedTicks = 0;
+        // Reset the paused counts
+        mPausedCounts = 0;
     }
 }
 
-Uint32 LTimer::getTicks()
+Uint64 LTimer::getCounts()
 {
     // The actual timer time
-    Uint32 time = 0;
+    Uint64 counts = 0;
 
     // If the timer is running
     if(mStarted)
@@ -200,14 +538,31 @@ Uint32 LTimer::getTicks()
         // If the timer is paused
         if(mPaused)
         {
-            time = mPausedTicks;
+            counts = mPausedCounts;
         }
         else
         {
-            time = SDL_GetTicks() - mStartTicks;
+            counts = mClock->getCounts() - mStartCounts;
         }
     }
-    return time;
+    return counts;
+}
+
+Uint64 LTimer::getTicks()
+{
+    return getNanoseconds() / 1000000;
+}
+
+Uint64 LTimer::getNanoseconds()
+{
+    // Split the conversion so counts * 1e9 can't overflow
+    Uint64 counts = getCounts();
+    return counts / mFrequency * 1000000000 + counts % mFrequency * 1000000000 / mFrequency;
+}
+
+double LTimer::getSeconds()
+{
+    return (double)getCounts() / mFrequency;
 }
 
 bool LTimer::isStarted()
@@ -372,10 +727,364 @@ int LTexture::getHeight()
 }
 /**************************************************************************/
 
+/*********************************************************************
+LGlyphAtlas Method Declarations
+*********************************************************************/
+
+// Constructor
+LGlyphAtlas::LGlyphAtlas()
+{
+    // Initialize
+    mTexture = nullptr;
+    mLineSkip = 0;
+
+    for(auto i = 0; i < 128; ++i)
+    {
+        mClips[i].x = 0;
+        mClips[i].y = 0;
+        mClips[i].w = 0;
+        mClips[i].h = 0;
+        mAdvances[i] = 0;
+    }
+}
+
+LGlyphAtlas::~LGlyphAtlas()
+{
+    // Deallocate
+    free();
+}
+
+bool LGlyphAtlas::buildAtlas(TTF_Font* font)
+{
+    // Get rid of pre-existing atlas
+    free();
+
+    // Glyphs are white so they can be tinted with color modulation
+    SDL_Color white = {0xff, 0xff, 0xff, 0xff};
+
+    // The rasterized printable glyphs
+    SDL_Surface* glyphSurfaces[128] = {nullptr};
+
+    // Packing offsets
+    int rowHeight = TTF_FontHeight(font);
+    int penX = 0, penY = 0;
+
+    // Rasterize each glyph once and find its spot in the atlas
+    for(auto i = GLYPH_FIRST; i <= GLYPH_LAST; ++i)
+    {
+        glyphSurfaces[i] = TTF_RenderGlyph_Blended(font, (Uint16)i, white);
+        if(glyphSurfaces[i] == nullptr)
+        {
+            std::cout << "Unable to render glyph " << i << "! SDL_ttf Error: " << TTF_GetError() << std::endl;
+            continue;
+        }
+
+        // Wrap to the next row
+        if(penX + glyphSurfaces[i]->w > GLYPH_ATLAS_WIDTH)
+        {
+            penX = 0;
+            penY += rowHeight + 1;
+        }
+
+        mClips[i].x = penX;
+        mClips[i].y = penY;
+        mClips[i].w = glyphSurfaces[i]->w;
+        mClips[i].h = glyphSurfaces[i]->h;
+
+        // Get how far the pen moves past this glyph
+        int minX, maxX, minY, maxY;
+        TTF_GlyphMetrics(font, (Uint16)i, &minX, &maxX, &minY, &maxY, &mAdvances[i]);
+
+        // Move over with one pixel of padding
+        penX += glyphSurfaces[i]->w + 1;
+    }
+
+    // Blit every glyph into a single surface
+    SDL_Surface* atlasSurface = SDL_CreateRGBSurfaceWithFormat(0, GLYPH_ATLAS_WIDTH, penY + rowHeight, 32, SDL_PIXELFORMAT_RGBA8888);
+    if(atlasSurface == nullptr)
+    {
+        std::cout << "Unable to create glyph atlas surface! SDL Error: " << SDL_GetError() << std::endl;
+    }
+    else
+    {
+        for(auto i = GLYPH_FIRST; i <= GLYPH_LAST; ++i)
+        {
+            if(glyphSurfaces[i] != nullptr)
+            {
+                // Copy the glyph's alpha as is instead of blending it
+                SDL_SetSurfaceBlendMode(glyphSurfaces[i], SDL_BLENDMODE_NONE);
+                SDL_BlitSurface(glyphSurfaces[i], nullptr, atlasSurface, &mClips[i]);
+            }
+        }
+
+        // Upload the atlas once
+        mTexture = SDL_CreateTextureFromSurface(gRenderer, atlasSurface);
+        if(mTexture == nullptr)
+        {
+            std::cout << "Unable to create glyph atlas texture! SDL Error: " << SDL_GetError() << std::endl;
+        }
+        else
+        {
+            SDL_SetTextureBlendMode(mTexture, SDL_BLENDMODE_BLEND);
+            mLineSkip = TTF_FontLineSkip(font);
+        }
+
+        SDL_FreeSurface(atlasSurface);
+    }
+
+    // Get rid of the glyph surfaces
+    for(auto i = GLYPH_FIRST; i <= GLYPH_LAST; ++i)
+    {
+        SDL_FreeSurface(glyphSurfaces[i]);
+    }
+
+    return mTexture != nullptr;
+}
+
+void LGlyphAtlas::free()
+{
+    // Free texture if it exists
+    if(mTexture != nullptr)
+    {
+        SDL_DestroyTexture(mTexture);
+        mTexture = nullptr;
+        mLineSkip = 0;
+    }
+}
+
+void LGlyphAtlas::renderText(int x, int y, std::string text, SDL_Color textColor)
+{
+    // If the atlas has been built
+    if(mTexture != nullptr)
+    {
+        // Tint the white glyphs
+        SDL_SetTextureColorMod(mTexture, textColor.r, textColor.g, textColor.b);
+        SDL_SetTextureAlphaMod(mTexture, textColor.a);
+
+        // Temp offsets
+        int curX = x, curY = y;
+
+        // Go through the text
+        for(std::size_t i = 0; i < text.length(); ++i)
+        {
+            // If the current character is a new line
+            if(text[i] == '\n')
+            {
+                // Move down
+                curY += mLineSkip;
+
+                // Move back
+                curX = x;
+            }
+            else
+            {
+                int glyph = getGlyphIndex(text[i]);
+
+                // Show the character
+                SDL_Rect renderQuad = {curX, curY, mClips[glyph].w, mClips[glyph].h};
+                SDL_RenderCopy(gRenderer, mTexture, &mClips[glyph], &renderQuad);
+
+                // Move over the width of the character
+                curX += mAdvances[glyph];
+            }
+        }
+    }
+}
+
+int LGlyphAtlas::getTextWidth(std::string text)
+{
+    int width = 0, lineWidth = 0;
+
+    for(std::size_t i = 0; i < text.length(); ++i)
+    {
+        if(text[i] == '\n')
+        {
+            lineWidth = 0;
+        }
+        else
+        {
+            lineWidth += mAdvances[getGlyphIndex(text[i])];
+        }
+
+        if(lineWidth > width)
+        {
+            width = lineWidth;
+        }
+    }
+    return width;
+}
+
+int LGlyphAtlas::getTextHeight(std::string text)
+{
+    int lines = 1;
+
+    for(std::size_t i = 0; i < text.length(); ++i)
+    {
+        if(text[i] == '\n')
+        {
+            ++lines;
+        }
+    }
+    return lines * mLineSkip;
+}
+
+int LGlyphAtlas::getGlyphIndex(char c)
+{
+    int ascii = (unsigned char)c;
+
+    // Not in the atlas
+    if(ascii < GLYPH_FIRST || ascii > GLYPH_LAST)
+    {
+        ascii = '?';
+    }
+    return ascii;
+}
+/**************************************************************************/
+
+/*********************************************************************
+LFrameStats Method Declarations
+*********************************************************************/
+LFrameStats::LFrameStats()
+{
+    reset();
+}
+
+void LFrameStats::addFrame(Uint32 microseconds)
+{
+    // Judge the new frame against the frames before it
+    bool hitch = mCount > 0 && microseconds > getPercentile(50.0) * 1000.0 * FRAME_STATS_HITCH_FACTOR;
+
+    // Drop the oldest frame once the window is full
+    if(mCount == FRAME_STATS_WINDOW)
+    {
+        Uint32 oldest = mTimes[mNext];
+        --mBuckets[getBucket(oldest)];
+        mTotal -= oldest;
+        if(mHitch[mNext])
+        {
+            --mHitches;
+        }
+    }
+    else
+    {
+        ++mCount;
+    }
+
+    mTimes[mNext] = microseconds;
+    mHitch[mNext] = hitch;
+    mNext = (mNext + 1) % FRAME_STATS_WINDOW;
+
+    ++mBuckets[getBucket(microseconds)];
+    mTotal += microseconds;
+    if(hitch)
+    {
+        ++mHitches;
+        ++mTotalHitches;
+    }
+}
+
+void LFrameStats::reset()
+{
+    mNext = 0;
+    mCount = 0;
+    mTotal = 0;
+    mHitches = 0;
+    mTotalHitches = 0;
+    memset(mBuckets, 0, sizeof(mBuckets));
+}
+
+double LFrameStats::getAverage()
+{
+    return mCount > 0 ? mTotal / 1000.0 / mCount : 0.0;
+}
+
+double LFrameStats::getFps()
+{
+    return mTotal > 0 ? mCount * 1000000.0 / mTotal : 0.0;
+}
+
+double LFrameStats::getPercentile(double percent)
+{
+    if(mCount == 0)
+    {
+        return 0.0;
+    }
+
+    // Walk the histogram until enough frames are covered
+    int target = (int)ceil(mCount * percent / 100.0);
+    if(target < 1)
+    {
+        target = 1;
+    }
+    int covered = 0;
+    for(int bucket = 0; bucket < FRAME_STATS_BUCKETS - 1; ++bucket)
+    {
+        covered += mBuckets[bucket];
+        if(covered >= target)
+        {
+            // Upper edge of the bucket
+            return (bucket + 1) * FRAME_STATS_BUCKET_MICROSECONDS / 1000.0;
+        }
+    }
+
+    // Lands in the overflow bucket
+    return getMax();
+}
+
+double LFrameStats::getMax()
+{
+    Uint32 longest = 0;
+    for(int i = 0; i < mCount; ++i)
+    {
+        longest = mTimes[i] > longest ? mTimes[i] : longest;
+    }
+    return longest / 1000.0;
+}
+
+int LFrameStats::getHitches()
+{
+    return mHitches;
+}
+
+int LFrameStats::getTotalHitches()
+{
+    return mTotalHitches;
+}
+
+int LFrameStats::getBucket(Uint32 microseconds)
+{
+    // Anything past the last bucket lands in it
+    Uint32 bucket = microseconds / FRAME_STATS_BUCKET_MICROSECONDS;
+    return bucket < (Uint32)FRAME_STATS_BUCKETS ? (int)bucket : FRAME_STATS_BUCKETS - 1;
+}
+/**************************************************************************/
+
 /***************************************************************************
 Function Definitions
 ***************************************************************************/
 
+bool selectClock(std::string arg)
+{
+    if(arg == "--virtual")
+    {
+        gClock = &gVirtualClock;
+        return true;
+    }
+    if(arg.compare(0, 9, "--script=") == 0)
+    {
+        if(gVirtualClock.loadScript(arg.substr(9)))
+        {
+            gClock = &gVirtualClock;
+        }
+        else
+        {
+            printf( "Unable to load clock script %s!\n", arg.substr(9).c_str() );
+        }
+        return true;
+    }
+    return false;
+}
+
 bool init()
 {
 	//Initialization flag
@@ -449,6 +1158,12 @@ bool loadMedia()
         std::cout << "Failed to load lazy font! SDL_ttf Error: " << SDL_GetError() ;
         success = false;
     }
+    // Rasterize glyphs
+    else if(!gGlyphAtlas.buildAtlas(gFont))
+    {
+        std::cout << "Failed to build glyph atlas!" << std::endl;
+        success = false;
+    }
 
     return success;
 }
@@ -456,7 +1171,7 @@ bool loadMedia()
 void close()
 {
     // Free loaded images
-    gFPSTextTexture.free();
+    gGlyphAtlas.free();
 
     // Free global font
     TTF_CloseFont(gFont);
@@ -478,6 +1193,14 @@ Main
 **************************************************************************/
 int main( int argc, char* args[] )
 {
+    // Real time unless a run asks for a virtual clock
+    for(int i = 1; i < argc; ++i)
+    {
+        if(!selectClock(args[i]))
+        {
+            printf( "Unknown option %s\n", args[i] );
+        }
+    }
 
 	//Start up SDL and create window
 	if( !init() )
@@ -502,15 +1225,19 @@ int main( int argc, char* args[] )
             // Set the text color
             SDL_Color textColor = { 0, 0, 0, 255 };
 
-            // The application timer
-            LTimer fpsTimer;
+            // Times each whole frame
+            LTimer frameTimer;
 
-            // In memory text stream
+            // Rolling frame time statistics
+            LFrameStats frameStats;
+
+            // In memory text streams
             std::stringstream timeText;
+            std::stringstream statsText;
 
             // Start counting frames per second
             int countedFrames = 0;
-            fpsTimer.start();
+            frameTimer.start();
 
 			//While application is running
 			while( !quit )
@@ -525,20 +1252,19 @@ int main( int argc, char* args[] )
 					}
 				}
 
-				// Calculate and correct fps
-				float avgFPS = countedFrames / (fpsTimer.getTicks()/1000.f);
-				if(avgFPS > 20000000)
-                {
-                    avgFPS = 0;
-                }
-                // Set text to be rendered
-                timeText.str("");
-                timeText << "Average Frames Per Second " << avgFPS;
-
-                // Render text
-                if(!gFPSTextTexture.loadFromRenderedText(timeText.str().c_str(), textColor))
+                // Refresh the text every few frames so it stays readable
+                if(countedFrames % FRAME_STATS_DISPLAY_FRAMES == 0)
                 {
-                    std::cout << "Unable to render time texture!" << std::endl;
+                    timeText.str("");
+                    timeText << "Average Frames Per Second " << frameStats.getFps();
+
+                    statsText.str("");
+                    statsText.precision(3);
+                    statsText << "p50 " << frameStats.getPercentile(50.0)
+                              << "ms p95 " << frameStats.getPercentile(95.0)
+                              << "ms p99 " << frameStats.getPercentile(99.0)
+                              << "ms max " << frameStats.getMax()
+                              << "ms hitches " << frameStats.getHitches();
                 }
 
 				//Clear screen
@@ -547,7 +1273,16 @@ int main( int argc, char* args[] )
 
                 // Render textures
 
-                gFPSTextTexture.render((SCREEN_WIDTH -gFPSTextTexture.getWidth())/2, (SCREEN_HEIGHT - gFPSTextTexture.getHeight())/2);
+                gGlyphAtlas.renderText((SCREEN_WIDTH - gGlyphAtlas.getTextWidth(timeText.str()))/2,
+                                       (SCREEN_HEIGHT - gGlyphAtlas.getTextHeight(timeText.str()))/2,
+                                       timeText.str(),
+                                       textColor);
+
+                // Tail latency under the average
+                gGlyphAtlas.renderText((SCREEN_WIDTH - gGlyphAtlas.getTextWidth(statsText.str()))/2,
+                                       (SCREEN_HEIGHT + gGlyphAtlas.getTextHeight(timeText.str()))/2,
+                                       statsText.str(),
+                                       textColor);
 
 
 
@@ -555,6 +1290,13 @@ int main( int argc, char* args[] )
 				SDL_RenderPresent( gRenderer );
 				++countedFrames;
 
+                // Let a virtual clock move on to the next frame
+                gClock->endFrame();
+
+                // Record the whole frame
+                frameStats.addFrame((Uint32)(frameTimer.getNanoseconds() / 1000));
+                frameTimer.start();
+
 
 			}
 		}
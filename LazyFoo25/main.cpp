@@ -2,37 +2,136 @@
 #include <cstdlib>
 #include <string>
 #include <sstream>
+#include <fstream>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <cmath>
+#include <cstring>
 #include <SDL.h>
 #include <SDL_image.h>
 #include <SDL_ttf.h>
 
+/*************************************************************************
+ Clock classes
+*************************************************************************/
+// Where timers read time from, so a run can use real or scripted time
+class LClock
+{
+public:
+    virtual ~LClock() {}
+
+    // Current time in counts
+    virtual Uint64 getCounts() = 0;
+
+    // Counts per second
+    virtual Uint64 getFrequency() = 0;
+
+    // Sleeps for about the given milliseconds
+    virtual void delay(Uint32 ms) = 0;
+
+    // Returns once the time has reached counts
+    virtual void waitUntil(Uint64 counts) = 0;
+
+    // Called by the main loop once per frame
+    virtual void endFrame() = 0;
+
+    // Current time in milliseconds
+    Uint64 getTicks();
+};
+
+// Wall clock time from the performance counter
+class LRealClock : public LClock
+{
+public:
+    // Constructor
+    LRealClock();
+
+    Uint64 getCounts();
+    Uint64 getFrequency();
+    void delay(Uint32 ms);
+    void waitUntil(Uint64 counts);
+    void endFrame();
+
+private:
+    Uint64 mFrequency;
+};
+
+// Time that only moves when told to, for runs that must repeat exactly
+class LVirtualClock : public LClock
+{
+public:
+    // Constructor
+    LVirtualClock();
+
+    // Counts are nanoseconds
+    Uint64 getCounts();
+    Uint64 getFrequency();
+
+    // Sleeping and waiting jump straight to the requested time
+    void delay(Uint32 ms);
+    void waitUntil(Uint64 counts);
+
+    // Moves on by the next scripted frame length, or the fixed step
+    void endFrame();
+
+    // Moves time forward
+    void advance(Uint64 nanoseconds);
+
+    // Sets the frame length used when there's no script
+    void setFrameStep(Uint64 nanoseconds);
+
+    // Loads frame lengths in milliseconds, one per line, played in order and repeated
+    bool loadScript(std::string path);
+
+private:
+    Uint64 mNow;
+    Uint64 mFrameStep;
+    std::vector<Uint64> mScript;
+    size_t mScriptPos;
+};
+/************************************************************************/
+
 /*************************************************************************
  Timer Class
 *************************************************************************/
 class LTimer
 {
 public:
-    // Constructor
-    LTimer();
+    // Constructor, times with gClock unless given another clock
+    LTimer(LClock* clock = NULL);
 
     void start();
     void stop();
     void pause();
     void unpause();
 
-    //Gets the timer's time
-    Uint32 getTicks();
+    //Gets the timer's time in milliseconds
+    Uint64 getTicks();
+
+    // Gets the timer's time at clock resolution
+    Uint64 getNanoseconds();
+    double getSeconds();
 
     // Checks the status of the timer
     bool isStarted();
     bool isPaused();
 
 private:
-    // The clock time when the timer started
-    Uint32 mStartTicks;
+    // Clock counts elapsed so far
+    Uint64 getCounts();
 
-    // The ticks stored  when the timer was paused
-    Uint32 mPausedTicks;
+    // Where the time comes from
+    LClock* mClock;
+
+    // The clock counts when the timer started
+    Uint64 mStartCounts;
+
+    // The elapsed counts stored when the timer was paused
+    Uint64 mPausedCounts;
+
+    // Clock counts per second
+    Uint64 mFrequency;
 
     // The timer status
     bool mPaused;
@@ -55,8 +154,8 @@ public:
     // Loads image at specified path
     bool loadFromFile(std::string path);
 
-    // Creates image from string
-    bool loadFromRenderedText(std::string textureText, SDL_Color textColor);
+    // Creates image from string, using the global font if none is given
+    bool loadFromRenderedText(std::string textureText, SDL_Color textColor, TTF_Font* font = nullptr);
     // Deallocate texture
     void free();
 
@@ -91,13 +190,193 @@ private:
 
 /*********************************************************************/
 
+/*************************************************************************
+ Text texture cache class
+*************************************************************************/
+class LTextCache
+{
+public:
+    // Constructor
+    LTextCache(int maxBytes);
+
+    // Destructor
+    ~LTextCache();
+
+    // Gets the texture for the text, only rendering it if it isn't cached
+    LTexture* getText(TTF_Font* font, std::string text, SDL_Color textColor);
+
+    // Deallocate every cached texture
+    void free();
+
+    // Sets how much texture memory the cache can hold
+    void setMaxBytes(int maxBytes);
+
+    // Gets cache statistics
+    int getHits();
+    int getMisses();
+    int getBytes();
+    int getCount();
+
+private:
+    // A rendered string
+    struct Entry
+    {
+        std::string key;
+        LTexture* texture;
+        int bytes;
+    };
+
+    // Throws out least recently used textures until under the cap
+    void evict();
+
+    // Most recently used textures first
+    std::list<Entry> mEntries;
+    std::unordered_map<std::string, std::list<Entry>::iterator> mLookup;
+
+    // Memory used and allowed
+    int mBytes;
+    int mMaxBytes;
+
+    // Lookup statistics
+    int mHits;
+    int mMisses;
+};
+
+/*********************************************************************/
+
+/*************************************************************************
+ Frame pacer class
+*************************************************************************/
+class LFramePacer
+{
+public:
+    // Constructor
+    LFramePacer();
+
+    // Starts a fresh schedule at the given rate
+    void start(int fps);
+
+    // Blocks until the next frame deadline
+    void wait();
+
+    // Pacing statistics since start, in microseconds
+    double getMeanInterval();
+    double getJitter();
+    double getMaxError();
+    int getLateFrames();
+    int getResyncs();
+
+    // Clears statistics without touching the schedule
+    void resetStats();
+
+private:
+    // Deadline of a frame on the absolute schedule
+    Uint64 getDeadline(Uint64 frame);
+
+    // Records the interval between two wait returns
+    void recordInterval(Uint64 now);
+
+    Uint64 mFrequency;
+    int mFps;
+
+    // Absolute schedule
+    Uint64 mStart;
+    Uint64 mFrame;
+
+    // How long before a deadline to stop sleeping, learned from oversleeps
+    Uint64 mSpinCounts;
+    Uint64 mMinSpinCounts;
+
+    // Interval statistics
+    Uint64 mLastReturn;
+    int mIntervals;
+    double mMean;
+    double mSquares;
+    double mMaxError;
+    int mLateFrames;
+    int mResyncs;
+};
+
+/*********************************************************************/
+
 /**********************************************************************
 Constants
 **********************************************************************/
 const int SCREEN_WIDTH = 800;
 const int SCREEN_HEIGHT = 600;
+const int TEXT_CACHE_MAX_BYTES = 4 * 1024 * 1024;
 const int SCREEN_FPS = 60;
-const int SCREEN_TICKS_PER_FRAME = 1000 / SCREEN_FPS;
+
+// Time before a frame deadline spent spinning instead of sleeping
+const int PACER_SPIN_MICROSECONDS = 2000;
+
+// Frames behind schedule before the pacer stops catching up and resyncs
+const int PACER_MAX_LAG_FRAMES = 3;
+
+// Frames between pacing reports
+const int PACER_REPORT_FRAMES = 300;
+
+// Frames in the rolling statistics window
+const int FRAME_STATS_WINDOW = 240;
+
+// Frame time histogram, 0.1ms buckets up to 100ms
+const int FRAME_STATS_BUCKET_MICROSECONDS = 100;
+const int FRAME_STATS_BUCKETS = 1000;
+
+// A frame this many times the median counts as a hitch
+const int FRAME_STATS_HITCH_FACTOR = 2;
+
+// Frames between statistics text refreshes
+const int FRAME_STATS_DISPLAY_FRAMES = 30;
+// Frame rate a virtual clock steps at when it has no script
+const int VIRTUAL_CLOCK_FPS = 60;
+/*********************************************************************/
+
+/*************************************************************************
+ Frame statistics class
+*************************************************************************/
+class LFrameStats
+{
+public:
+    // Constructor
+    LFrameStats();
+
+    // Adds one frame time
+    void addFrame(Uint32 microseconds);
+
+    // Forgets all frames
+    void reset();
+
+    // Rolling window statistics in milliseconds, no allocation or sorting
+    double getAverage();
+    double getFps();
+    double getPercentile(double percent);
+    double getMax();
+
+    // Frames over FRAME_STATS_HITCH_FACTOR times the median
+    int getHitches();
+    int getTotalHitches();
+
+private:
+    // Histogram bucket for a frame time
+    static int getBucket(Uint32 microseconds);
+
+    // Ring of the most recent frame times and whether each was a hitch
+    Uint32 mTimes[FRAME_STATS_WINDOW];
+    bool mHitch[FRAME_STATS_WINDOW];
+    int mNext;
+    int mCount;
+
+    // Histogram of the frames in the ring
+    int mBuckets[FRAME_STATS_BUCKETS];
+
+    // Sum of the frames in the ring
+    Uint64 mTotal;
+
+    int mHitches;
+    int mTotalHitches;
+};
+
 /*********************************************************************/
 
 /**********************************************************************
@@ -109,12 +388,19 @@ SDL_Window* gWindow = nullptr;
 // The window renderer
 SDL_Renderer* gRenderer = nullptr;
 
+// Clocks timers can read from, real unless a run asks for virtual time
+LRealClock gRealClock;
+LVirtualClock gVirtualClock;
+LClock* gClock = &gRealClock;
+
 // Globally used font
 TTF_Font* gFont = nullptr;
 
 // Rendered Texture
 //LTexture gTextTexture;
-LTexture gFPSTextTexture;
+
+// Rendered strings that get reused
+LTextCache gTextCache(TEXT_CACHE_MAX_BYTES);
 
 /*********************************************************************/
 
@@ -123,15 +409,138 @@ Function Declarations
 **************************************************************************/
 bool init();
 
+// Picks the clock from a command line argument, false if it isn't a clock option
+bool selectClock(std::string arg);
+
 bool loadMedia();
 
 void close();
 /************************************************************************/
 
+/************************************************************************
+LClock Method Declarations
+*************************************************************************/
+Uint64 LClock::getTicks()
+{
+    // Split the conversion so counts * 1000 can't overflow
+    Uint64 counts = getCounts();
+    Uint64 frequency = getFrequency();
+    return counts / frequency * 1000 + counts % frequency * 1000 / frequency;
+}
+
+LRealClock::LRealClock()
+{
+    mFrequency = SDL_GetPerformanceFrequency();
+}
+
+Uint64 LRealClock::getCounts()
+{
+    return SDL_GetPerformanceCounter();
+}
+
+Uint64 LRealClock::getFrequency()
+{
+    return mFrequency;
+}
+
+void LRealClock::delay(Uint32 ms)
+{
+    SDL_Delay(ms);
+}
+
+void LRealClock::waitUntil(Uint64 counts)
+{
+    while(SDL_GetPerformanceCounter() < counts)
+    {
+    }
+}
+
+void LRealClock::endFrame()
+{
+}
+
+LVirtualClock::LVirtualClock()
+{
+    mNow = 0;
+    mFrameStep = 1000000000 / VIRTUAL_CLOCK_FPS;
+    mScriptPos = 0;
+}
+
+Uint64 LVirtualClock::getCounts()
+{
+    return mNow;
+}
+
+Uint64 LVirtualClock::getFrequency()
+{
+    return 1000000000;
+}
+
+void LVirtualClock::delay(Uint32 ms)
+{
+    mNow += (Uint64)ms * 1000000;
+}
+
+void LVirtualClock::waitUntil(Uint64 counts)
+{
+    if(counts > mNow)
+    {
+        mNow = counts;
+    }
+}
+
+void LVirtualClock::endFrame()
+{
+    if(mScript.empty())
+    {
+        mNow += mFrameStep;
+    }
+    else
+    {
+        mNow += mScript[mScriptPos];
+        mScriptPos = (mScriptPos + 1) % mScript.size();
+    }
+}
+
+void LVirtualClock::advance(Uint64 nanoseconds)
+{
+    mNow += nanoseconds;
+}
+
+void LVirtualClock::setFrameStep(Uint64 nanoseconds)
+{
+    mFrameStep = nanoseconds;
+}
+
+bool LVirtualClock::loadScript(std::string path)
+{
+    std::ifstream script(path.c_str());
+    if(!script)
+    {
+        return false;
+    }
+
+    std::vector<Uint64> steps;
+    double ms = 0;
+    while(script >> ms)
+    {
+        steps.push_back((Uint64)(ms * 1000000.0 + 0.5));
+    }
+    if(steps.empty())
+    {
+        return false;
+    }
+
+    mScript = steps;
+    mScriptPos = 0;
+    return true;
+}
+/**************************************************************************/
+
 /************************************************************************
 LTimer Method Declarations
 *************************************************************************/
-LTimer::LTimer(): mStartTicks(0), mPausedTicks(0), mPaused(false), mStarted(false)
+LTimer::LTimer(LClock* clock): mClock(clock != NULL ? clock : gClock), mStartCounts(0), mPausedCounts(0), mFrequency(mClock->getFrequency()), mPaused(false), mStarted(false)
 {
 }
 
@@ -144,8 +553,8 @@ void LTimer::start()
     mPaused = false;
 
     // Get the current clock time
-    mStartTicks = SDL_GetTicks();
-    mPausedTicks = 0;
+    mStartCounts = mClock->getCounts();
+    mPausedCounts = 0;
 }
 
 void LTimer::stop()
@@ -157,8 +566,8 @@ void LTimer::stop()
     mPaused = false;
 
     // Clear tick variables
-    mStartTicks = 0;
-    mPausedTicks = 0;
+    mStartCounts = 0;
+    mPausedCounts = 0;
 }
 
 void LTimer::pause()
@@ -168,9 +577,9 @@ void LTimer::pause()
     {
         mPaused = true;
 
-        // Calculate the paused tickes
-        mPausedTicks = SDL_GetTicks() - mStartTicks;
-        mStartTicks = 0;
+        // Calculate the paused counts
+        mPausedCounts = mClock->getCounts() - mStartCounts;
+        mStartCounts = 0;
     }
 }
 
@@ -182,18 +591,18 @@ void LTimer::unpause()
         // Unpause the timer
         mPaused = false;
 
-        // Reset the starting ticks
-        mStartTicks = SDL_GetTicks() - mPausedTicks;
+        // Reset the starting counts
+        mStartCounts = mClock->getCounts() - mPausedCounts;
 
-        // Reset the paused ticks
-        mPausedTicks = 0;
+        // Reset the paused counts
+        mPausedCounts = 0;
     }
 }
 
-Uint32 LTimer::getTicks()
+Uint64 LTimer::getCounts()
 {
     // The actual timer time
-    Uint32 time = 0;
+    Uint64 counts = 0;
 
     // If the timer is running
     if(mStarted)
@@ -201,14 +610,31 @@ Uint32 LTimer::getTicks()
         // If the timer is paused
         if(mPaused)
         {
-            time = mPausedTicks;
+            counts = mPausedCounts;
         }
         else
         {
-            time = SDL_GetTicks() - mStartTicks;
+            counts = mClock->getCounts() - mStartCounts;
         }
     }
-    return time;
+    return counts;
+}
+
+Uint64 LTimer::getTicks()
+{
+    return getNanoseconds() / 1000000;
+}
+
+Uint64 LTimer::getNanoseconds()
+{
+    // Split the conversion so counts * 1e9 can't overflow
+    Uint64 counts = getCounts();
+    return counts / mFrequency * 1000000000 + counts % mFrequency * 1000000000 / mFrequency;
+}
+
+double LTimer::getSeconds()
+{
+    return (double)getCounts() / mFrequency;
 }
 
 bool LTimer::isStarted()
@@ -294,13 +720,19 @@ void LTexture::free()
 }
 
 // Create image from text
-bool LTexture::loadFromRenderedText( std::string textureText, SDL_Color textColor)
+bool LTexture::loadFromRenderedText( std::string textureText, SDL_Color textColor, TTF_Font* font)
 {
     // Get rid of preexisting texture
     free();
 
+    // Fall back on the global font
+    if(font == nullptr)
+    {
+        font = gFont;
+    }
+
     // Render text surface
-    SDL_Surface* textSurface = TTF_RenderText_Solid(gFont, textureText.c_str(), textColor );
+    SDL_Surface* textSurface = TTF_RenderText_Solid(font, textureText.c_str(), textColor );
     if(textSurface == nullptr)
     {
         std::cout << "Unable to render text surface! SDL_ttf Error: " << TTF_GetError() << std::endl;
@@ -373,10 +805,400 @@ int LTexture::getHeight()
 }
 /**************************************************************************/
 
+/*********************************************************************
+LTextCache Method Declarations
+*********************************************************************/
+
+// Constructor
+LTextCache::LTextCache(int maxBytes)
+{
+    // Initialize
+    mBytes = 0;
+    mMaxBytes = maxBytes;
+    mHits = 0;
+    mMisses = 0;
+}
+
+LTextCache::~LTextCache()
+{
+    // Deallocate
+    free();
+}
+
+LTexture* LTextCache::getText(TTF_Font* font, std::string text, SDL_Color textColor)
+{
+    // Build the lookup key from the font, its style, the color and the text, an open
+    // font's size never changes so the pointer covers it
+    std::stringstream key;
+    key << font << ':' << TTF_GetFontStyle(font) << ':'
+        << (int)textColor.r << ',' << (int)textColor.g << ',' << (int)textColor.b << ',' << (int)textColor.a << ':'
+        << text;
+
+    // Already rendered
+    auto found = mLookup.find(key.str());
+    if(found != mLookup.end())
+    {
+        ++mHits;
+
+        // Move to the front of the line
+        mEntries.splice(mEntries.begin(), mEntries, found->second);
+        return found->second->texture;
+    }
+
+    ++mMisses;
+
+    // Render the new text
+    LTexture* texture = new LTexture();
+    if(!texture->loadFromRenderedText(text, textColor, font))
+    {
+        delete texture;
+        return nullptr;
+    }
+
+    Entry entry;
+    entry.key = key.str();
+    entry.texture = texture;
+    entry.bytes = texture->getWidth() * texture->getHeight() * 4;
+
+    mEntries.push_front(entry);
+    mLookup[entry.key] = mEntries.begin();
+    mBytes += entry.bytes;
+
+    // Make room
+    evict();
+
+    return texture;
+}
+
+void LTextCache::free()
+{
+    for(auto it = mEntries.begin(); it != mEntries.end(); ++it)
+    {
+        delete it->texture;
+    }
+    mEntries.clear();
+    mLookup.clear();
+    mBytes = 0;
+}
+
+void LTextCache::setMaxBytes(int maxBytes)
+{
+    mMaxBytes = maxBytes;
+    evict();
+}
+
+int LTextCache::getHits()
+{
+    return mHits;
+}
+
+int LTextCache::getMisses()
+{
+    return mMisses;
+}
+
+int LTextCache::getBytes()
+{
+    return mBytes;
+}
+
+int LTextCache::getCount()
+{
+    return mEntries.size();
+}
+
+void LTextCache::evict()
+{
+    // Always keep the most recent texture since the caller is using it
+    while(mBytes > mMaxBytes && mEntries.size() > 1)
+    {
+        Entry& oldest = mEntries.back();
+        mBytes -= oldest.bytes;
+        mLookup.erase(oldest.key);
+        delete oldest.texture;
+        mEntries.pop_back();
+    }
+}
+/**************************************************************************/
+
+/*********************************************************************
+LFramePacer Method Declarations
+*********************************************************************/
+LFramePacer::LFramePacer()
+{
+    mFrequency = gClock->getFrequency();
+    mFps = 60;
+    mStart = 0;
+    mFrame = 0;
+    mMinSpinCounts = mFrequency * PACER_SPIN_MICROSECONDS / 1000000;
+    mSpinCounts = mMinSpinCounts;
+    mLastReturn = 0;
+    mResyncs = 0;
+    resetStats();
+}
+
+void LFramePacer::start(int fps)
+{
+    mFps = fps > 0 ? fps : 1;
+    mStart = gClock->getCounts();
+    mFrame = 0;
+    mLastReturn = mStart;
+    mResyncs = 0;
+    resetStats();
+}
+
+void LFramePacer::wait()
+{
+    // Deadlines come from the start time so rounding never builds up
+    ++mFrame;
+    Uint64 deadline = getDeadline(mFrame);
+    Uint64 now = gClock->getCounts();
+
+    if(now < deadline)
+    {
+        // Sleep through the bulk of the wait, the scheduler may oversleep
+        if(deadline - now > mSpinCounts)
+        {
+            Uint64 sleepCounts = deadline - now - mSpinCounts;
+            Uint32 sleepMs = (Uint32)(sleepCounts * 1000 / mFrequency);
+            if(sleepMs > 0)
+            {
+                gClock->delay(sleepMs);
+
+                // Keep the spin margin above the worst recent oversleep
+                Uint64 slept = gClock->getCounts() - now;
+                Uint64 asked = sleepMs * mFrequency / 1000;
+                Uint64 overshoot = slept > asked ? slept - asked : 0;
+                mSpinCounts -= (mSpinCounts - mMinSpinCounts) / 64;
+                if(overshoot + mMinSpinCounts / 2 > mSpinCounts)
+                {
+                    mSpinCounts = overshoot + mMinSpinCounts / 2;
+                }
+            }
+        }
+
+        // Spin out the rest, a virtual clock just jumps ahead
+        gClock->waitUntil(deadline);
+        now = gClock->getCounts();
+    }
+    else
+    {
+        ++mLateFrames;
+
+        // Too far behind to catch up smoothly, start a new schedule from here
+        if(now - deadline > getDeadline(PACER_MAX_LAG_FRAMES) - mStart)
+        {
+            mStart = now;
+            mFrame = 0;
+            ++mResyncs;
+        }
+    }
+
+    recordInterval(now);
+}
+
+double LFramePacer::getMeanInterval()
+{
+    return mMean;
+}
+
+double LFramePacer::getJitter()
+{
+    return mIntervals > 1 ? sqrt(mSquares / (mIntervals - 1)) : 0.0;
+}
+
+double LFramePacer::getMaxError()
+{
+    return mMaxError;
+}
+
+int LFramePacer::getLateFrames()
+{
+    return mLateFrames;
+}
+
+int LFramePacer::getResyncs()
+{
+    return mResyncs;
+}
+
+void LFramePacer::resetStats()
+{
+    mIntervals = 0;
+    mMean = 0.0;
+    mSquares = 0.0;
+    mMaxError = 0.0;
+    mLateFrames = 0;
+}
+
+Uint64 LFramePacer::getDeadline(Uint64 frame)
+{
+    return mStart + frame * mFrequency / mFps;
+}
+
+void LFramePacer::recordInterval(Uint64 now)
+{
+    double interval = (now - mLastReturn) * 1000000.0 / mFrequency;
+    mLastReturn = now;
+
+    // Running mean and variance
+    ++mIntervals;
+    double delta = interval - mMean;
+    mMean += delta / mIntervals;
+    mSquares += delta * (interval - mMean);
+
+    double error = fabs(interval - 1000000.0 / mFps);
+    if(error > mMaxError)
+    {
+        mMaxError = error;
+    }
+}
+/**************************************************************************/
+
+/*********************************************************************
+LFrameStats Method Declarations
+*********************************************************************/
+LFrameStats::LFrameStats()
+{
+    reset();
+}
+
+void LFrameStats::addFrame(Uint32 microseconds)
+{
+    // Judge the new frame against the frames before it
+    bool hitch = mCount > 0 && microseconds > getPercentile(50.0) * 1000.0 * FRAME_STATS_HITCH_FACTOR;
+
+    // Drop the oldest frame once the window is full
+    if(mCount == FRAME_STATS_WINDOW)
+    {
+        Uint32 oldest = mTimes[mNext];
+        --mBuckets[getBucket(oldest)];
+        mTotal -= oldest;
+        if(mHitch[mNext])
+        {
+            --mHitches;
+        }
+    }
+    else
+    {
+        ++mCount;
+    }
+
+    mTimes[mNext] = microseconds;
+    mHitch[mNext] = hitch;
+    mNext = (mNext + 1) % FRAME_STATS_WINDOW;
+
+    ++mBuckets[getBucket(microseconds)];
+    mTotal += microseconds;
+    if(hitch)
+    {
+        ++mHitches;
+        ++mTotalHitches;
+    }
+}
+
+void LFrameStats::reset()
+{
+    mNext = 0;
+    mCount = 0;
+    mTotal = 0;
+    mHitches = 0;
+    mTotalHitches = 0;
+    memset(mBuckets, 0, sizeof(mBuckets));
+}
+
+double LFrameStats::getAverage()
+{
+    return mCount > 0 ? mTotal / 1000.0 / mCount : 0.0;
+}
+
+double LFrameStats::getFps()
+{
+    return mTotal > 0 ? mCount * 1000000.0 / mTotal : 0.0;
+}
+
+double LFrameStats::getPercentile(double percent)
+{
+    if(mCount == 0)
+    {
+        return 0.0;
+    }
+
+    // Walk the histogram until enough frames are covered
+    int target = (int)ceil(mCount * percent / 100.0);
+    if(target < 1)
+    {
+        target = 1;
+    }
+    int covered = 0;
+    for(int bucket = 0; bucket < FRAME_STATS_BUCKETS - 1; ++bucket)
+    {
+        covered += mBuckets[bucket];
+        if(covered >= target)
+        {
+            // Upper edge of the bucket
+            return (bucket + 1) * FRAME_STATS_BUCKET_MICROSECONDS / 1000.0;
+        }
+    }
+
+    // Lands in the overflow bucket
+    return getMax();
+}
+
+double LFrameStats::getMax()
+{
+    Uint32 longest = 0;
+    for(int i = 0; i < mCount; ++i)
+    {
+        longest = mTimes[i] > longest ? mTimes[i] : longest;
+    }
+    return longest / 1000.0;
+}
+
+int LFrameStats::getHitches()
+{
+    return mHitches;
+}
+
+int LFrameStats::getTotalHitches()
+{
+    return mTotalHitches;
+}
+
+int LFrameStats::getBucket(Uint32 microseconds)
+{
+    // Anything past the last bucket lands in it
+    Uint32 bucket = microseconds / FRAME_STATS_BUCKET_MICROSECONDS;
+    return bucket < (Uint32)FRAME_STATS_BUCKETS ? (int)bucket : FRAME_STATS_BUCKETS - 1;
+}
+/**************************************************************************/
+
 /***************************************************************************
 Function Definitions
 ***************************************************************************/
 
+bool selectClock(std::string arg)
+{
+    if(arg == "--virtual")
+    {
+        gClock = &gVirtualClock;
+        return true;
+    }
+    if(arg.compare(0, 9, "--script=") == 0)
+    {
+        if(gVirtualClock.loadScript(arg.substr(9)))
+        {
+            gClock = &gVirtualClock;
+        }
+        else
+        {
+            printf( "Unable to load clock script %s!\n", arg.substr(9).c_str() );
+        }
+        return true;
+    }
+    return false;
+}
+
 bool init()
 {
 	//Initialization flag
@@ -457,7 +1279,11 @@ bool loadMedia()
 void close()
 {
     // Free loaded images
-    gFPSTextTexture.free();
+    std::cout << "Text cache hits: " << gTextCache.getHits()
+              << " misses: " << gTextCache.getMisses()
+              << " textures: " << gTextCache.getCount()
+              << " bytes: " << gTextCache.getBytes() << std::endl;
+    gTextCache.free();
 
     // Free global font
     TTF_CloseFont(gFont);
@@ -479,6 +1305,14 @@ Main
 **************************************************************************/
 int main( int argc, char* args[] )
 {
+    // Real time unless a run asks for a virtual clock
+    for(int i = 1; i < argc; ++i)
+    {
+        if(!selectClock(args[i]))
+        {
+            printf( "Unknown option %s\n", args[i] );
+        }
+    }
 
 	//Start up SDL and create window
 	if( !init() )
@@ -503,25 +1337,32 @@ int main( int argc, char* args[] )
             // Set the text color
             SDL_Color textColor = { 0, 0, 0, 255 };
 
-            // The application timer
-            LTimer fpsTimer;
+            // Times each whole frame
+            LTimer frameTimer;
 
-            // The frames per second cap timer
-            LTimer capTimer;
+            // Rolling frame time statistics
+            LFrameStats frameStats;
 
-            // In memory text stream
+            // Holds the frame rate to SCREEN_FPS
+            LFramePacer framePacer;
+
+            // In memory text streams
             std::stringstream timeText;
+            std::stringstream statsText;
+
+            // The numbers change on every refresh so they're rendered into their own textures
+            // instead of the cache, which only keeps the label
+            LTexture fpsValueTexture;
+            LTexture statsTexture;
 
             // Start counting frames per second
             int countedFrames = 0;
-            fpsTimer.start();
+            frameTimer.start();
+            framePacer.start(SCREEN_FPS);
 
 			//While application is running
 			while( !quit )
 			{
-			    // Start cap timer
-			    capTimer.start();
-
 				//Handle events on queue
 				while( SDL_PollEvent( &e ) != 0 )
 				{
@@ -532,20 +1373,34 @@ int main( int argc, char* args[] )
 					}
 				}
 
-				// Calculate and correct fps
-				float avgFPS = countedFrames / (fpsTimer.getTicks()/1000.f);
-				if(avgFPS > 20000000)
+                // Refresh the text every few frames so it stays readable
+                if(countedFrames % FRAME_STATS_DISPLAY_FRAMES == 0)
                 {
-                    avgFPS = 0;
+                    timeText.str("");
+                    timeText << frameStats.getFps();
+                    if(!fpsValueTexture.loadFromRenderedText(timeText.str(), textColor))
+                    {
+                        std::cout << "Unable to render time texture!" << std::endl;
+                    }
+
+                    statsText.str("");
+                    statsText.precision(3);
+                    statsText << "p50 " << frameStats.getPercentile(50.0)
+                              << "ms p95 " << frameStats.getPercentile(95.0)
+                              << "ms p99 " << frameStats.getPercentile(99.0)
+                              << "ms max " << frameStats.getMax()
+                              << "ms hitches " << frameStats.getHitches();
+                    if(!statsTexture.loadFromRenderedText(statsText.str(), textColor))
+                    {
+                        std::cout << "Unable to render stats texture!" << std::endl;
+                    }
                 }
-                // Set text to be rendered
-                timeText.str("");
-                timeText << "Average Frames Per Second " << avgFPS;
 
-                // Render text
-                if(!gFPSTextTexture.loadFromRenderedText(timeText.str().c_str(), textColor))
+                // The label never changes so it comes from the cache
+                LTexture* fpsTextTexture = gTextCache.getText(gFont, "Average Frames Per Second ", textColor);
+                if(fpsTextTexture == nullptr)
                 {
-                    std::cout << "Unable to render time texture!" << std::endl;
+                    std::cout << "Unable to render time label texture!" << std::endl;
                 }
 
 				//Clear screen
@@ -554,7 +1409,18 @@ int main( int argc, char* args[] )
 
                 // Render textures
 
-                gFPSTextTexture.render((SCREEN_WIDTH -gFPSTextTexture.getWidth())/2, (SCREEN_HEIGHT - gFPSTextTexture.getHeight())/2);
+                if(fpsTextTexture != nullptr)
+                {
+                    // Label and value centered together as one line
+                    int lineWidth = fpsTextTexture->getWidth() + fpsValueTexture.getWidth();
+                    int x = (SCREEN_WIDTH - lineWidth)/2;
+                    int y = (SCREEN_HEIGHT - fpsTextTexture->getHeight())/2;
+                    fpsTextTexture->render(x, y);
+                    fpsValueTexture.render(x + fpsTextTexture->getWidth(), y);
+
+                    // Tail latency under the average
+                    statsTexture.render((SCREEN_WIDTH - statsTexture.getWidth())/2, (SCREEN_HEIGHT + fpsTextTexture->getHeight())/2);
+                }
 
 
 
@@ -562,12 +1428,25 @@ int main( int argc, char* args[] )
 				SDL_RenderPresent( gRenderer );
 				++countedFrames;
 
-                // If frame finished early
-                int frameTicks = capTimer.getTicks();
-                if(frameTicks < SCREEN_TICKS_PER_FRAME )
+                // Let a virtual clock move on to the next frame
+                gClock->endFrame();
+
+                // Wait out the rest of the frame
+                framePacer.wait();
+
+                // Record the whole frame, pacing included
+                frameStats.addFrame((Uint32)(frameTimer.getNanoseconds() / 1000));
+                frameTimer.start();
+
+                // Report how steady the pacing was
+                if(countedFrames % PACER_REPORT_FRAMES == 0)
                 {
-                    // Wait remaining time
-                    SDL_Delay(SCREEN_TICKS_PER_FRAME - frameTicks);
+                    std::cout << "Frame interval " << framePacer.getMeanInterval() << "us"
+                              << " jitter " << framePacer.getJitter() << "us"
+                              << " max error " << framePacer.getMaxError() << "us"
+                              << " late " << framePacer.getLateFrames()
+                              << " resyncs " << framePacer.getResyncs() << std::endl;
+                    framePacer.resetStats();
                 }
 
 			}
@@ -73,19 +73,29 @@ public:
     void pause();
     void unpause();
 
-    //Gets the timer's time
-    Uint32 getTicks();
+    //Gets the timer's time in milliseconds
+    Uint64 getTicks();
+
+    // Gets the timer's time at performance counter resolution
+    Uint64 getNanoseconds();
+    double getSeconds();
 
     // Checks the status of the timer
     bool isStarted();
     bool isPaused();
 
 private:
-    // The clock time when the timer started
-    Uint32 mStartTicks;
+    // Performance counter ticks elapsed so far
+    Uint64 getCounts();
+
+    // The performance counter when the timer started
+    Uint64 mStartCounts;
+
+    // The elapsed counts stored when the timer was paused
+    Uint64 mPausedCounts;
 
-    // The ticks stored  when the timer was paused
-    Uint32 mPausedTicks;
+    // Performance counter ticks per second
+    Uint64 mFrequency;
 
     // The timer status
     bool mPaused;
@@ -189,7 +199,7 @@ bool checkCollision(std::vector<SDL_Rect>& a, std::vector<SDL_Rect>& b);
 /************************************************************************
  LTimer Method Declarations
  *************************************************************************/
-LTimer::LTimer(): mStartTicks(0), mPausedTicks(0), mPaused(false), mStarted(false)
+LTimer::LTimer(): mStartCounts(0), mPausedCounts(0), mFrequency(SDL_GetPerformanceFrequency()), mPaused(false), mStarted(false)
 {
 }
 
@@ -202,8 +212,8 @@ void LTimer::start()
     mPaused = false;
 
     // Get the current clock time
-    mStartTicks = SDL_GetTicks();
-    mPausedTicks = 0;
+    mStartCounts = SDL_GetPerformanceCounter();
+    mPausedCounts = 0;
 }
 
 void LTimer::stop()
@@ -215,8 +225,8 @@ void LTimer::stop()
     mPaused = false;
 
     // Clear tick variables
-    mStartTicks = 0;
-    mPausedTicks = 0;
+    mStartCounts = 0;
+    mPausedCounts = 0;
 }
 
 void LTimer::pause()
@@ -226,9 +236,9 @@ void LTimer::pause()
     {
         mPaused = true;
 
-        // Calculate the paused tickes
-        mPausedTicks = SDL_GetTicks() - mStartTicks;
-        mStartTicks = 0;
+        // Calculate the paused counts
+        mPausedCounts = SDL_GetPerformanceCounter() - mStartCounts;
+        mStartCounts = 0;
     }
 }
 
@@ -240,18 +250,18 @@ void LTimer::unpause()
         // Unpause the timer
         mPaused = false;
 
-        // Reset the starting ticks
-        mStartTicks = SDL_GetTicks() - mPausedTicks;
+        // Reset the starting counts
+        mStartCounts = SDL_GetPerformanceCounter() - mPausedCounts;
 
-        // Reset the paused ticks
-        mPausedTicks = 0;
+        // Reset the paused counts
+        mPausedCounts = 0;
     }
 }
 
-Uint32 LTimer::getTicks()
+Uint64 LTimer::getCounts()
 {
     // The actual timer time
-    Uint32 time = 0;
+    Uint64 counts = 0;
 
     // If the timer is running
     if(mStarted)
@@ -259,14 +269,31 @@ Uint32 LTimer::getTicks()
         // If the timer is paused
         if(mPaused)
         {
-            time = mPausedTicks;
+            counts = mPausedCounts;
         }
         else
         {
-            time = SDL_GetTicks() - mStartTicks;
+            counts = SDL_GetPerformanceCounter() - mStartCounts;
         }
     }
-    return time;
+    return counts;
+}
+
+Uint64 LTimer::getTicks()
+{
+    return getNanoseconds() / 1000000;
+}
+
+Uint64 LTimer::getNanoseconds()
+{
+    // Split the conversion so counts * 1e9 can't overflow
+    Uint64 counts = getCounts();
+    return counts / mFrequency * 1000000000 + counts % mFrequency * 1000000000 / mFrequency;
+}
+
+double LTimer::getSeconds()
+{
+    return (double)getCounts() / mFrequency;
 }
 
 bool LTimer::isStarted()
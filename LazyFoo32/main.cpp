@@ -2,6 +2,8 @@
 #include <cstdlib>
 #include <string>
 #include <sstream>
+#include <vector>
+#include <unordered_map>
 #include <SDL.h>
 #include <SDL_image.h>
 #include <SDL_ttf.h>
@@ -20,19 +22,29 @@ public:
     void pause();
     void unpause();
 
-    //Gets the timer's time
-    Uint32 getTicks();
+    //Gets the timer's time in milliseconds
+    Uint64 getTicks();
+
+    // Gets the timer's time at performance counter resolution
+    Uint64 getNanoseconds();
+    double getSeconds();
 
     // Checks the status of the timer
     bool isStarted();
     bool isPaused();
 
 private:
-    // The clock time when the timer started
-    Uint32 mStartTicks;
+    // Performance counter ticks elapsed so far
+    Uint64 getCounts();
+
+    // The performance counter when the timer started
+    Uint64 mStartCounts;
+
+    // The elapsed counts stored when the timer was paused
+    Uint64 mPausedCounts;
 
-    // The ticks stored  when the timer was paused
-    Uint32 mPausedTicks;
+    // Performance counter ticks per second
+    Uint64 mFrequency;
 
     // The timer status
     bool mPaused;
@@ -91,12 +103,157 @@ private:
 
 /*********************************************************************/
 
+/*************************************************************************
+ Glyph atlas class
+*************************************************************************/
+class LGlyphAtlas
+{
+public:
+    // A glyph's spot in the atlas
+    struct Glyph
+    {
+        SDL_Rect clip;
+        int advance;
+    };
+
+    // Constructor
+    LGlyphAtlas();
+
+    // Destructor
+    ~LGlyphAtlas();
+
+    // Creates the atlas texture and rasterizes the printable ASCII glyphs
+    bool buildAtlas(TTF_Font* font);
+
+    // Deallocate atlas texture
+    void free();
+
+    // Gets a glyph, rasterizing it into the atlas the first time it's used
+    const Glyph& getGlyph(Uint16 codepoint);
+
+    // Set color modulation for the following glyphs
+    void setColor(SDL_Color textColor);
+
+    // Shows a glyph
+    void renderGlyph(int x, int y, const Glyph& glyph);
+
+    // Gets line spacing of the font
+    int getLineSkip();
+
+private:
+    // Rasterizes a glyph and copies it into the next free spot
+    bool addGlyph(Uint16 codepoint);
+
+    // The font glyphs come from
+    TTF_Font* mFont;
+
+    // The shared glyph texture
+    SDL_Texture* mTexture;
+
+    // Every glyph rasterized so far
+    std::unordered_map<Uint16, Glyph> mGlyphs;
+
+    // Where the next glyph gets packed
+    int mPenX, mPenY;
+    int mRowHeight;
+};
+
+/*********************************************************************/
+
+/*************************************************************************
+ Text input class
+*************************************************************************/
+class LTextInput
+{
+public:
+    // Constructor
+    LTextInput();
+
+    // Sets the atlas glyphs are drawn from
+    void setAtlas(LGlyphAtlas* atlas);
+
+    // Replaces all the text
+    void setText(std::string text);
+
+    // Adds UTF-8 text to the end, only laying out the new characters
+    void appendText(std::string text);
+
+    // Removes the last character
+    void removeLast();
+
+    // Removes all the text
+    void clear();
+
+    // Replaces the text with a paste that gets laid out over several frames
+    void beginPaste(const char* text);
+
+    // Lays out the next chunk of a paste, returns false once it's done
+    bool updatePaste(int maxBytes);
+
+    // Checks the status of a paste
+    bool isPasting();
+    float getPasteProgress();
+
+    // Gets the UTF-8 text, including any paste not laid out yet
+    std::string getText();
+
+    // Gets the number of characters
+    int getLength();
+
+    // Gets width of the whole text
+    int getTextWidth();
+
+    // Shows as much of the end of the text as fits in the width
+    void render(int x, int y, int width, SDL_Color textColor);
+
+private:
+    // A laid out character
+    struct Cell
+    {
+        Uint16 codepoint;
+        int x;
+        int bytes;
+    };
+
+    // Lays out new characters at the end of the text
+    void layoutText(const std::string& text);
+
+    // Decodes the character at pos, returning how many bytes it takes up
+    static int decodeUTF8(const std::string& text, std::size_t pos, Uint16* codepoint);
+
+    // The atlas glyphs come from
+    LGlyphAtlas* mAtlas;
+
+    // The text and its laid out characters
+    std::string mText;
+    std::vector<Cell> mCells;
+
+    // Width of the whole text
+    int mWidth;
+
+    // Text still waiting to be laid out and how far we've gotten
+    std::string mPending;
+    std::size_t mPendingPos;
+};
+
+/*********************************************************************/
+
 /**********************************************************************
 Constants
 **********************************************************************/
 const int SCREEN_WIDTH = 800;
 const int SCREEN_HEIGHT = 600;
 
+// Printable characters kept in the glyph atlas
+const int GLYPH_FIRST = 32;
+const int GLYPH_LAST = 126;
+const int GLYPH_ATLAS_WIDTH = 512;
+const int GLYPH_ATLAS_HEIGHT = 512;
+
+// Paste limits
+const std::size_t PASTE_MAX_BYTES = 4 * 1024 * 1024;
+const int PASTE_BYTES_PER_FRAME = 64 * 1024;
+
 /*********************************************************************/
 
 /**********************************************************************
@@ -112,9 +269,14 @@ SDL_Renderer* gRenderer = nullptr;
 TTF_Font* gFont = nullptr;
 
 // Rendered Texture
-LTexture gInputTextTexture;
 LTexture gPromptTextTexture;
 
+// Cached font glyphs for the input text
+LGlyphAtlas gGlyphAtlas;
+
+// The text being edited
+LTextInput gInputText;
+
 
 /*********************************************************************/
 
@@ -131,7 +293,7 @@ void close();
 /************************************************************************
 LTimer Method Declarations
 *************************************************************************/
-LTimer::LTimer(): mStartTicks(0), mPausedTicks(0), mPaused(false), mStarted(false)
+LTimer::LTimer(): mStartCounts(0), mPausedCounts(0), mFrequency(SDL_GetPerformanceFrequency()), mPaused(false), mStarted(false)
 {
 }
 
@@ -144,8 +306,8 @@ void LTimer::start()
     mPaused = false;
 
     // Get the current clock time
-    mStartTicks = SDL_GetTicks();
-    mPausedTicks = 0;
+    mStartCounts = SDL_GetPerformanceCounter();
+    mPausedCounts = 0;
 }
 
 void LTimer::stop()
@@ -157,8 +319,8 @@ void LTimer::stop()
     mPaused = false;
 
     // Clear tick variables
-    mStartTicks = 0;
-    mPausedTicks = 0;
+    mStartCounts = 0;
+    mPausedCounts = 0;
 }
 
 void LTimer::pause()
@@ -168,9 +330,9 @@ void LTimer::pause()
     {
         mPaused = true;
 
-        // Calculate the paused tickes
-        mPausedTicks = SDL_GetTicks() - mStartTicks;
-        mStartTicks = 0;
+        // Calculate the paused counts
+        mPausedCounts = SDL_GetPerformanceCounter() - mStartCounts;
+        mStartCounts = 0;
     }
 }
 
@@ -182,18 +344,18 @@ void LTimer::unpause()
         // Unpause the timer
         mPaused = false;
 
-        // Reset the starting ticks
-        mStartTicks = SDL_GetTicks() - mPausedTicks;
+        // Reset the starting counts
+        mStartCounts = SDL_GetPerformanceCounter() - mPausedCounts;
 
-        // Reset the paused ticks
-        mPausedTicks = 0;
+        // Reset the paused counts
+        mPausedCounts = 0;
     }
 }
 
-Uint32 LTimer::getTicks()
+Uint64 LTimer::getCounts()
 {
     // The actual timer time
-    Uint32 time = 0;
+    Uint64 counts = 0;
 
     // If the timer is running
     if(mStarted)
@@ -201,14 +363,31 @@ Uint32 LTimer::getTicks()
         // If the timer is paused
         if(mPaused)
         {
-            time = mPausedTicks;
+            counts = mPausedCounts;
         }
         else
         {
-            time = SDL_GetTicks() - mStartTicks;
+            counts = SDL_GetPerformanceCounter() - mStartCounts;
         }
     }
-    return time;
+    return counts;
+}
+
+Uint64 LTimer::getTicks()
+{
+    return getNanoseconds() / 1000000;
+}
+
+Uint64 LTimer::getNanoseconds()
+{
+    // Split the conversion so counts * 1e9 can't overflow
+    Uint64 counts = getCounts();
+    return counts / mFrequency * 1000000000 + counts % mFrequency * 1000000000 / mFrequency;
+}
+
+double LTimer::getSeconds()
+{
+    return (double)getCounts() / mFrequency;
 }
 
 bool LTimer::isStarted()
@@ -373,6 +552,480 @@ int LTexture::getHeight()
 }
 /**************************************************************************/
 
+/*********************************************************************
+LGlyphAtlas Method Declarations
+*********************************************************************/
+
+// Constructor
+LGlyphAtlas::LGlyphAtlas()
+{
+    // Initialize
+    mFont = nullptr;
+    mTexture = nullptr;
+    mPenX = 0;
+    mPenY = 0;
+    mRowHeight = 0;
+}
+
+LGlyphAtlas::~LGlyphAtlas()
+{
+    // Deallocate
+    free();
+}
+
+bool LGlyphAtlas::buildAtlas(TTF_Font* font)
+{
+    // Get rid of pre-existing atlas
+    free();
+
+    // Create the atlas, glyphs are uploaded into it as they're needed
+    mTexture = SDL_CreateTexture(gRenderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STATIC,
+                                 GLYPH_ATLAS_WIDTH, GLYPH_ATLAS_HEIGHT);
+    if(mTexture == nullptr)
+    {
+        std::cout << "Unable to create glyph atlas texture! SDL Error: " << SDL_GetError() << std::endl;
+    }
+    else
+    {
+        SDL_SetTextureBlendMode(mTexture, SDL_BLENDMODE_BLEND);
+
+        mFont = font;
+        mRowHeight = TTF_FontHeight(font);
+
+        // Rasterize the printable glyphs up front
+        for(auto i = GLYPH_FIRST; i <= GLYPH_LAST; ++i)
+        {
+            addGlyph((Uint16)i);
+        }
+    }
+    return mTexture != nullptr;
+}
+
+void LGlyphAtlas::free()
+{
+    // Free texture if it exists
+    if(mTexture != nullptr)
+    {
+        SDL_DestroyTexture(mTexture);
+        mTexture = nullptr;
+    }
+    mFont = nullptr;
+    mGlyphs.clear();
+    mPenX = 0;
+    mPenY = 0;
+    mRowHeight = 0;
+}
+
+const LGlyphAtlas::Glyph& LGlyphAtlas::getGlyph(Uint16 codepoint)
+{
+    // Already rasterized
+    auto found = mGlyphs.find(codepoint);
+    if(found != mGlyphs.end())
+    {
+        return found->second;
+    }
+
+    // Font doesn't have it or the atlas is full, use the '?' glyph from now on
+    if(!addGlyph(codepoint))
+    {
+        mGlyphs[codepoint] = mGlyphs['?'];
+    }
+    return mGlyphs[codepoint];
+}
+
+void LGlyphAtlas::setColor(SDL_Color textColor)
+{
+    SDL_SetTextureColorMod(mTexture, textColor.r, textColor.g, textColor.b);
+    SDL_SetTextureAlphaMod(mTexture, textColor.a);
+}
+
+void LGlyphAtlas::renderGlyph(int x, int y, const Glyph& glyph)
+{
+    SDL_Rect renderQuad = {x, y, glyph.clip.w, glyph.clip.h};
+    SDL_RenderCopy(gRenderer, mTexture, &glyph.clip, &renderQuad);
+}
+
+int LGlyphAtlas::getLineSkip()
+{
+    return mFont != nullptr ? TTF_FontLineSkip(mFont) : 0;
+}
+
+bool LGlyphAtlas::addGlyph(Uint16 codepoint)
+{
+    bool success = true;
+
+    // Glyphs are white so they can be tinted with color modulation
+    SDL_Color white = {0xff, 0xff, 0xff, 0xff};
+
+    if(mFont == nullptr || !TTF_GlyphIsProvided(mFont, codepoint))
+    {
+        return false;
+    }
+
+    // Rasterize the glyph
+    SDL_Surface* glyphSurface = TTF_RenderGlyph_Blended(mFont, codepoint, white);
+    if(glyphSurface == nullptr)
+    {
+        std::cout << "Unable to render glyph " << codepoint << "! SDL_ttf Error: " << TTF_GetError() << std::endl;
+        return false;
+    }
+
+    // Convert to the atlas format
+    SDL_Surface* formattedSurface = SDL_ConvertSurfaceFormat(glyphSurface, SDL_PIXELFORMAT_RGBA8888, 0);
+    if(formattedSurface == nullptr)
+    {
+        std::cout << "Unable to convert glyph surface! SDL Error: " << SDL_GetError() << std::endl;
+        success = false;
+    }
+    else
+    {
+        // Wrap to the next row
+        if(mPenX + formattedSurface->w > GLYPH_ATLAS_WIDTH)
+        {
+            mPenX = 0;
+            mPenY += mRowHeight + 1;
+        }
+
+        // Atlas is full
+        if(mPenY + formattedSurface->h > GLYPH_ATLAS_HEIGHT)
+        {
+            std::cout << "Glyph atlas is full!" << std::endl;
+            success = false;
+        }
+        else
+        {
+            Glyph glyph;
+            glyph.clip.x = mPenX;
+            glyph.clip.y = mPenY;
+            glyph.clip.w = formattedSurface->w;
+            glyph.clip.h = formattedSurface->h;
+
+            // Get how far the pen moves past this glyph
+            int minX, maxX, minY, maxY;
+            TTF_GlyphMetrics(mFont, codepoint, &minX, &maxX, &minY, &maxY, &glyph.advance);
+
+            // Upload just this glyph's spot
+            SDL_UpdateTexture(mTexture, &glyph.clip, formattedSurface->pixels, formattedSurface->pitch);
+            mGlyphs[codepoint] = glyph;
+
+            // Move over with one pixel of padding
+            mPenX += formattedSurface->w + 1;
+        }
+        SDL_FreeSurface(formattedSurface);
+    }
+    SDL_FreeSurface(glyphSurface);
+
+    return success;
+}
+/**************************************************************************/
+
+/*********************************************************************
+LTextInput Method Declarations
+*********************************************************************/
+
+// Constructor
+LTextInput::LTextInput()
+{
+    // Initialize
+    mAtlas = nullptr;
+    mWidth = 0;
+    mPendingPos = 0;
+}
+
+void LTextInput::setAtlas(LGlyphAtlas* atlas)
+{
+    mAtlas = atlas;
+
+    // Advances come from the atlas so lay everything out again
+    setText(mText);
+}
+
+void LTextInput::setText(std::string text)
+{
+    clear();
+    appendText(text);
+}
+
+void LTextInput::appendText(std::string text)
+{
+    // Typing during a paste goes after it
+    if(isPasting())
+    {
+        mPending += text;
+    }
+    else
+    {
+        layoutText(text);
+    }
+}
+
+void LTextInput::layoutText(const std::string& text)
+{
+    std::size_t pos = 0;
+
+    // Go through the new characters
+    while(pos < text.length())
+    {
+        Cell cell;
+        cell.bytes = decodeUTF8(text, pos, &cell.codepoint);
+        cell.x = mWidth;
+        mCells.push_back(cell);
+
+        // Move over the width of the character
+        if(mAtlas != nullptr)
+        {
+            mWidth += mAtlas->getGlyph(cell.codepoint).advance;
+        }
+
+        pos += cell.bytes;
+    }
+    mText += text;
+}
+
+void LTextInput::removeLast()
+{
+    // Take the character off the end of the paste instead
+    if(isPasting())
+    {
+        std::size_t end = mPending.length() - 1;
+        while(end > mPendingPos && ((unsigned char)mPending[end] & 0xc0) == 0x80)
+        {
+            --end;
+        }
+        mPending.erase(end);
+
+        // Nothing left to paste
+        if(!isPasting())
+        {
+            mPending.clear();
+            mPendingPos = 0;
+        }
+    }
+    else if(!mCells.empty())
+    {
+        // Lop off every byte of the last character
+        mText.erase(mText.length() - mCells.back().bytes);
+        mWidth = mCells.back().x;
+        mCells.pop_back();
+    }
+}
+
+void LTextInput::clear()
+{
+    mText.clear();
+    mCells.clear();
+    mWidth = 0;
+    mPending.clear();
+    mPendingPos = 0;
+}
+
+void LTextInput::beginPaste(const char* text)
+{
+    clear();
+    if(text == NULL)
+    {
+        return;
+    }
+
+    // Guard against huge pastes, only looking as far as the limit so nothing past it is read or copied
+    std::size_t end = 0;
+    while(end <= PASTE_MAX_BYTES && text[end] != '\0')
+    {
+        ++end;
+    }
+    if(end > PASTE_MAX_BYTES)
+    {
+        std::cout << "Paste truncated to " << PASTE_MAX_BYTES << " bytes!" << std::endl;
+
+        // Don't cut a character in half
+        end = PASTE_MAX_BYTES;
+        while(end > 0 && ((unsigned char)text[end] & 0xc0) == 0x80)
+        {
+            --end;
+        }
+    }
+    mPending.assign(text, end);
+
+    // This is a single line field so control characters become spaces
+    for(std::size_t i = 0; i < mPending.length(); ++i)
+    {
+        if((unsigned char)mPending[i] < 0x20 || mPending[i] == 0x7f)
+        {
+            mPending[i] = ' ';
+        }
+    }
+
+    mPendingPos = 0;
+}
+
+bool LTextInput::updatePaste(int maxBytes)
+{
+    if(!isPasting())
+    {
+        return false;
+    }
+
+    // Take a chunk without cutting a character in half
+    std::size_t end = mPendingPos + maxBytes;
+    if(end >= mPending.length())
+    {
+        end = mPending.length();
+    }
+    else
+    {
+        while(end > mPendingPos && ((unsigned char)mPending[end] & 0xc0) == 0x80)
+        {
+            --end;
+        }
+    }
+
+    layoutText(mPending.substr(mPendingPos, end - mPendingPos));
+    mPendingPos = end;
+
+    // Paste is done
+    if(!isPasting())
+    {
+        mPending.clear();
+        mPendingPos = 0;
+    }
+    return isPasting();
+}
+
+bool LTextInput::isPasting()
+{
+    return mPendingPos < mPending.length();
+}
+
+float LTextInput::getPasteProgress()
+{
+    if(!isPasting())
+    {
+        return 1.f;
+    }
+    return (float)mPendingPos / mPending.length();
+}
+
+std::string LTextInput::getText()
+{
+    if(isPasting())
+    {
+        return mText + mPending.substr(mPendingPos);
+    }
+    return mText;
+}
+
+int LTextInput::getLength()
+{
+    return mCells.size();
+}
+
+int LTextInput::getTextWidth()
+{
+    return mWidth;
+}
+
+void LTextInput::render(int x, int y, int width, SDL_Color textColor)
+{
+    if(mAtlas == nullptr || mCells.empty())
+    {
+        return;
+    }
+
+    // Scroll so the end of the text is showing
+    int scroll = mWidth > width ? mWidth - width : 0;
+
+    // Find the first character that's visible
+    std::size_t first = 0, last = mCells.size();
+    while(first < last)
+    {
+        std::size_t middle = (first + last) / 2;
+        if(mCells[middle].x < scroll)
+        {
+            first = middle + 1;
+        }
+        else
+        {
+            last = middle;
+        }
+    }
+
+    // Only show the visible characters
+    mAtlas->setColor(textColor);
+    for(auto i = first; i < mCells.size(); ++i)
+    {
+        mAtlas->renderGlyph(x + mCells[i].x - scroll, y, mAtlas->getGlyph(mCells[i].codepoint));
+    }
+}
+
+int LTextInput::decodeUTF8(const std::string& text, std::size_t pos, Uint16* codepoint)
+{
+    unsigned char lead = text[pos];
+
+    // Work out the sequence length from the lead byte
+    int bytes = 1;
+    Uint32 value = lead;
+
+    // Allowed range of the first continuation byte, narrower after some leads
+    // to rule out overlong forms, surrogates and values past U+10FFFF
+    unsigned char low = 0x80, high = 0xbf;
+    if(lead >= 0xf0 && lead <= 0xf4)
+    {
+        bytes = 4;
+        value = lead & 0x07;
+        if(lead == 0xf0)
+        {
+            low = 0x90;
+        }
+        else if(lead == 0xf4)
+        {
+            high = 0x8f;
+        }
+    }
+    else if(lead >= 0xe0 && lead <= 0xef)
+    {
+        bytes = 3;
+        value = lead & 0x0f;
+        if(lead == 0xe0)
+        {
+            low = 0xa0;
+        }
+        else if(lead == 0xed)
+        {
+            high = 0x9f;
+        }
+    }
+    else if(lead >= 0xc2 && lead <= 0xdf)
+    {
+        bytes = 2;
+        value = lead & 0x1f;
+    }
+    else if(lead >= 0x80)
+    {
+        // Stray continuation or invalid lead byte, including 0xf5 and up
+        *codepoint = '?';
+        return 1;
+    }
+
+    // Pull in the continuation bytes
+    for(int i = 1; i < bytes; ++i)
+    {
+        unsigned char next = pos + i < text.length() ? (unsigned char)text[pos + i] : 0;
+        bool valid = i == 1 ? next >= low && next <= high : (next & 0xc0) == 0x80;
+        if(!valid)
+        {
+            // Truncated or malformed sequence, only skip the lead byte
+            *codepoint = '?';
+            return 1;
+        }
+        value = (value << 6) | (next & 0x3f);
+    }
+
+    // Fonts only take 16 bit glyphs
+    *codepoint = value > 0xffff ? '?' : (Uint16)value;
+    return bytes;
+}
+/**************************************************************************/
+
 /***************************************************************************
 Function Definitions
 ***************************************************************************/
@@ -451,6 +1104,15 @@ bool loadMedia()
         std::cout << "Failed to load lazy font! SDL_ttf Error: " << SDL_GetError() ;
         success = false;
     }
+    else if(!gGlyphAtlas.buildAtlas(gFont))
+    {
+        std::cout << "Failed to build glyph atlas!" << std::endl;
+        success = false;
+    }
+    else
+    {
+        gInputText.setAtlas(&gGlyphAtlas);
+    }
     if(!gPromptTextTexture.loadFromRenderedText("Enter some text", textColor))
     {
         std::cout << "Unable to render text!" << std::endl;
@@ -465,7 +1127,7 @@ void close()
 {
     // Free loaded images
     gPromptTextTexture.free();
-    gInputTextTexture.free();
+    gGlyphAtlas.free();
 
     // Free global font
     TTF_CloseFont(gFont);
@@ -510,8 +1172,7 @@ int main( int argc, char* args[] )
             SDL_Color textColor = { 0, 0, 0, 255 };
 
             // The current input text
-            std::string inputText = "Some text";
-            gInputTextTexture.loadFromRenderedText(inputText.c_str(), textColor);
+            gInputText.setText("Some text");
 
             SDL_StartTextInput();
 
@@ -521,8 +1182,6 @@ int main( int argc, char* args[] )
 			//While application is running
 			while( !quit )
 			{
-			    bool renderText = false;
-
 				//Handle events on queue
 				while( SDL_PollEvent( &e ) != 0 )
 				{
@@ -533,21 +1192,23 @@ int main( int argc, char* args[] )
 					}
 					else if( e.type == SDL_KEYDOWN)
                     {
-                        // Handle backspace
-                        if(e.key.keysym.sym == SDLK_BACKSPACE && inputText.length() > 0)
+                        // Handle backspace, removeLast also trims a paste still being laid out
+                        // and does nothing when the field is empty
+                        if(e.key.keysym.sym == SDLK_BACKSPACE)
                         {
                             // lop off character
-                            inputText.pop_back();
-                            renderText = true;
+                            gInputText.removeLast();
                         }
                         else if(e.key.keysym.sym == SDLK_c && SDL_GetModState() & KMOD_CTRL)
                         {
-                            SDL_SetClipboardText(inputText.c_str());
+                            SDL_SetClipboardText(gInputText.getText().c_str());
                         }
                         else if(e.key.keysym.sym == SDLK_v && SDL_GetModState() & KMOD_CTRL)
                         {
-                            inputText = SDL_GetClipboardText();
-                            renderText = true;
+                            // Lay the paste out over the next few frames
+                            char* clipboardText = SDL_GetClipboardText();
+                            gInputText.beginPaste(clipboardText);
+                            SDL_free(clipboardText);
                         }
                     }
                     else if(e.type == SDL_TEXTINPUT)
@@ -556,27 +1217,13 @@ int main( int argc, char* args[] )
                         if(!((e.text.text[0] == 'c' || e.text.text[0] == 'C') && (e.text.text[0] == 'v' || e.text.text[0] == 'V') && SDL_GetModState() & KMOD_CTRL))
                         {
                             // Append character
-                            inputText += e.text.text;
-                            renderText = true;
+                            gInputText.appendText(e.text.text);
                         }
                     }
 				}
 
-                // Render text if needed
-                if(renderText)
-                {
-                    // Text is not empty
-                    if(inputText != "")
-                    {
-                        gInputTextTexture.loadFromRenderedText(inputText.c_str(), textColor);
-                    }
-                    // Text is empty
-                    else
-                    {
-                        // Render space texture
-                        gInputTextTexture.loadFromRenderedText(" ", textColor);
-                    }
-                }
+                // Keep laying out any paste in progress
+                gInputText.updatePaste(PASTE_BYTES_PER_FRAME);
 
 				//Clear screen
 				SDL_SetRenderDrawColor( gRenderer, 0xff, 0xff, 0xff, 0xff );
@@ -584,7 +1231,16 @@ int main( int argc, char* args[] )
 
                 // Render textures
                 gPromptTextTexture.render((SCREEN_WIDTH - gPromptTextTexture.getWidth()) / 2, 0);
-                gInputTextTexture.render((SCREEN_WIDTH - gInputTextTexture.getWidth()) / 2, gPromptTextTexture.getHeight());
+                int inputWidth = gInputText.getTextWidth() < SCREEN_WIDTH ? gInputText.getTextWidth() : SCREEN_WIDTH;
+                gInputText.render((SCREEN_WIDTH - inputWidth) / 2, gPromptTextTexture.getHeight(), SCREEN_WIDTH, textColor);
+
+                // Show paste progress
+                if(gInputText.isPasting())
+                {
+                    SDL_Rect progressBar = {0, SCREEN_HEIGHT - 8, (int)(SCREEN_WIDTH * gInputText.getPasteProgress()), 8};
+                    SDL_SetRenderDrawColor(gRenderer, 0x00, 0x00, 0x00, 0xff);
+                    SDL_RenderFillRect(gRenderer, &progressBar);
+                }
 
 				//Update screen
 				SDL_RenderPresent( gRenderer );
@@ -11,6 +11,8 @@
 #include <string>
 #include <sstream>
 #include <vector>
+#include <fstream>
+#include <cstring>
 #include <SDL.h>
 #include <SDL_image.h>
 
@@ -23,6 +25,13 @@ const int SCREEN_WIDTH = 640;
 const int SCREEN_HEIGHT = 480;
 const int TOTAL_PARTICLES = 20;
 
+// Zones kept per frame and frames kept for the profiler overlay and trace
+const int PROFILER_MAX_ZONES = 64;
+const int PROFILER_HISTORY = 120;
+
+// Frames between profiler overlay text refreshes
+const int PROFILER_OVERLAY_REFRESH = 30;
+
 /*********************************************************************/
 
 /*************************************************************************
@@ -39,19 +48,29 @@ public:
     void pause();
     void unpause();
 
-    //Gets the timer's time
-    Uint32 getTicks();
+    //Gets the timer's time in milliseconds
+    Uint64 getTicks();
+
+    // Gets the timer's time at performance counter resolution
+    Uint64 getNanoseconds();
+    double getSeconds();
 
     // Checks the status of the timer
     bool isStarted();
     bool isPaused();
 
 private:
-    // The clock time when the timer started
-    Uint32 mStartTicks;
+    // Performance counter ticks elapsed so far
+    Uint64 getCounts();
+
+    // The performance counter when the timer started
+    Uint64 mStartCounts;
+
+    // The elapsed counts stored when the timer was paused
+    Uint64 mPausedCounts;
 
-    // The ticks stored  when the timer was paused
-    Uint32 mPausedTicks;
+    // Performance counter ticks per second
+    Uint64 mFrequency;
 
     // The timer status
     bool mPaused;
@@ -71,8 +90,8 @@ public:
     // Desstructor
     ~LTexture();
 
-    // Loads image at specified path
-    bool loadFromFile(std::string path);
+    // Loads image at specified path, optionally premultiplying alpha
+    bool loadFromFile(std::string path, bool premultiply = false);
 
     // Creates image from string
     bool loadFromRenderedText(std::string textureText, SDL_Color textColor);
@@ -100,12 +119,134 @@ public:
     int getHeight();
 
 private:
+    // Pushes the stored color/alpha modulation to the texture
+    void applyModulation();
+
     // The actual hardware texture
     SDL_Texture* mTexture;
 
     // Image dimensions
     int mWidth;
     int mHeight;
+
+    // Premultiplied pixel data and current modulation
+    bool mPremultiplied;
+    Uint8 mRed;
+    Uint8 mGreen;
+    Uint8 mBlue;
+    Uint8 mAlpha;
+};
+
+/*********************************************************************/
+
+/*************************************************************************
+ Bitmap font class
+ *************************************************************************/
+class LBitmapFont
+{
+public:
+
+    LBitmapFont();
+
+    // Loads the font sheet and finds the character clips
+    bool buildFont(std::string path);
+
+    // Deallocates the font texture
+    void free();
+
+    // Shows the text
+    void renderText(int x, int y, std::string text);
+
+private:
+    // Reads a pixel from a 32 bit surface
+    static Uint32 getPixel32(SDL_Surface* surface, int x, int y);
+
+    // The font texture
+    LTexture mBitmap;
+
+    // the individual characters in the surface
+    SDL_Rect mChars[256];
+
+    // Spacing variables
+    int mNewLine, mSpace;
+};
+
+/*********************************************************************/
+
+/*************************************************************************
+ Frame profiler class
+ *************************************************************************/
+class LProfiler
+{
+public:
+    // Constructor
+    LProfiler();
+
+    // Brackets one frame, zones recorded in between belong to it
+    void beginFrame();
+    void endFrame();
+
+    // Opens a zone nested in the open one, returns its slot or -1 when the frame is full
+    int beginZone(const char* name);
+    void endZone(int zone);
+
+    // Writes the recorded frames as Chrome trace JSON
+    bool exportTrace(std::string path);
+
+    // Shows per zone averages over the recorded frames
+    void renderOverlay(LBitmapFont& font, int x, int y);
+    void toggleOverlay();
+
+private:
+    struct Zone
+    {
+        const char* name;
+        Uint64 start;
+        Uint64 end;
+        int depth;
+    };
+
+    struct Frame
+    {
+        Uint64 start;
+        Uint64 end;
+        Zone zones[PROFILER_MAX_ZONES];
+        int zoneCount;
+    };
+
+    // Refreshes the cached overlay text
+    void buildOverlayText();
+
+    // Ring of the most recent frames
+    Frame mFrames[PROFILER_HISTORY];
+    int mFrameCount;
+
+    // Zones currently open
+    int mDepth;
+
+    Uint64 mFrequency;
+
+    bool mOverlay;
+    std::string mOverlayText;
+};
+
+/*********************************************************************/
+
+/*************************************************************************
+ Profile zone class
+ *************************************************************************/
+class LProfileScope
+{
+public:
+    // Opens the zone
+    LProfileScope(LProfiler& profiler, const char* name);
+
+    // Closes the zone when it goes out of scope
+    ~LProfileScope();
+
+private:
+    LProfiler& mProfiler;
+    int mZone;
 };
 
 /*********************************************************************/
@@ -206,11 +347,24 @@ LTexture gGreenTexture;
 LTexture gBlueTexture;
 LTexture gShimmerTexture;
 
+// Frame stage timings
+LProfiler gProfiler;
+
+// Font for the profiler overlay
+LBitmapFont gOverlayFont;
+
 /*********************************************************************/
 
 /**************************************************************************
  Function Declarations
  **************************************************************************/
+// Premultiplied alpha helpers
+SDL_BlendMode getPremultipliedBlendMode();
+
+Uint8 mulDiv255(Uint8 a, Uint8 b);
+
+SDL_Surface* premultiplySurface(SDL_Surface* surface);
+
 bool init();
 
 bool loadMedia();
@@ -282,7 +436,7 @@ Dot::~Dot()
 /************************************************************************
  LTimer Method Declarations
  *************************************************************************/
-LTimer::LTimer(): mStartTicks(0), mPausedTicks(0), mPaused(false), mStarted(false)
+LTimer::LTimer(): mStartCounts(0), mPausedCounts(0), mFrequency(SDL_GetPerformanceFrequency()), mPaused(false), mStarted(false)
 {
 }
 
@@ -295,8 +449,8 @@ void LTimer::start()
     mPaused = false;
 
     // Get the current clock time
-    mStartTicks = SDL_GetTicks();
-    mPausedTicks = 0;
+    mStartCounts = SDL_GetPerformanceCounter();
+    mPausedCounts = 0;
 }
 
 void LTimer::stop()
@@ -308,8 +462,8 @@ void LTimer::stop()
     mPaused = false;
 
     // Clear tick variables
-    mStartTicks = 0;
-    mPausedTicks = 0;
+    mStartCounts = 0;
+    mPausedCounts = 0;
 }
 
 void LTimer::pause()
@@ -319,9 +473,9 @@ void LTimer::pause()
     {
         mPaused = true;
 
-        // Calculate the paused tickes
-        mPausedTicks = SDL_GetTicks() - mStartTicks;
-        mStartTicks = 0;
+        // Calculate the paused counts
+        mPausedCounts = SDL_GetPerformanceCounter() - mStartCounts;
+        mStartCounts = 0;
     }
 }
 
@@ -333,18 +487,18 @@ void LTimer::unpause()
         // Unpause the timer
         mPaused = false;
 
-        // Reset the starting ticks
-        mStartTicks = SDL_GetTicks() - mPausedTicks;
+        // Reset the starting counts
+        mStartCounts = SDL_GetPerformanceCounter() - mPausedCounts;
 
-        // Reset the paused ticks
-        mPausedTicks = 0;
+        // Reset the paused counts
+        mPausedCounts = 0;
     }
 }
 
-Uint32 LTimer::getTicks()
+Uint64 LTimer::getCounts()
 {
     // The actual timer time
-    Uint32 time = 0;
+    Uint64 counts = 0;
 
     // If the timer is running
     if(mStarted)
@@ -352,14 +506,31 @@ Uint32 LTimer::getTicks()
         // If the timer is paused
         if(mPaused)
         {
-            time = mPausedTicks;
+            counts = mPausedCounts;
         }
         else
         {
-            time = SDL_GetTicks() - mStartTicks;
+            counts = SDL_GetPerformanceCounter() - mStartCounts;
         }
     }
-    return time;
+    return counts;
+}
+
+Uint64 LTimer::getTicks()
+{
+    return getNanoseconds() / 1000000;
+}
+
+Uint64 LTimer::getNanoseconds()
+{
+    // Split the conversion so counts * 1e9 can't overflow
+    Uint64 counts = getCounts();
+    return counts / mFrequency * 1000000000 + counts % mFrequency * 1000000000 / mFrequency;
+}
+
+double LTimer::getSeconds()
+{
+    return (double)getCounts() / mFrequency;
 }
 
 bool LTimer::isStarted()
@@ -386,6 +557,11 @@ LTexture::LTexture()
     mTexture = nullptr;
     mWidth = 0;
     mHeight = 0;
+    mPremultiplied = false;
+    mRed = 0xff;
+    mGreen = 0xff;
+    mBlue = 0xff;
+    mAlpha = 0xff;
 }
 
 LTexture::~LTexture()
@@ -394,10 +570,11 @@ LTexture::~LTexture()
     free();
 }
 
-bool LTexture::loadFromFile(std::string path)
+bool LTexture::loadFromFile(std::string path, bool premultiply)
 {
     //The final texture
     SDL_Texture* newTexture = nullptr;
+    mPremultiplied = false;
 
     // Load image at the specified path
     SDL_Surface* loadedSurface = IMG_Load(path.c_str() );
@@ -412,8 +589,35 @@ bool LTexture::loadFromFile(std::string path)
         SDL_SetColorKey(loadedSurface, SDL_TRUE,
                         SDL_MapRGB(loadedSurface->format, 0, 0xff, 0xff) );
 
+        // Bake color key and alpha into premultiplied ARGB
+        if( premultiply )
+        {
+            SDL_Surface* formattedSurface = premultiplySurface(loadedSurface);
+            if( formattedSurface == nullptr )
+            {
+                printf("Unable to premultiply %s! SDL_Error: %s\n",
+                       path.c_str(), SDL_GetError());
+            }
+            else
+            {
+                // Premultiplied pixels are only usable if the renderer takes the matching blend equation
+                newTexture = SDL_CreateTextureFromSurface(gRenderer, formattedSurface);
+                if( newTexture != nullptr && SDL_SetTextureBlendMode(newTexture, getPremultipliedBlendMode()) != 0 )
+                {
+                    printf("Premultiplied blending not supported, using straight alpha for %s\n", path.c_str());
+                    SDL_DestroyTexture(newTexture);
+                    newTexture = nullptr;
+                }
+                mPremultiplied = newTexture != nullptr;
+                SDL_FreeSurface( formattedSurface );
+            }
+        }
+
         // Create texture from surface pixels
-        newTexture = SDL_CreateTextureFromSurface(gRenderer, loadedSurface);
+        if( newTexture == nullptr )
+        {
+            newTexture = SDL_CreateTextureFromSurface(gRenderer, loadedSurface);
+        }
         if( newTexture == nullptr)
         {
             printf("Unable to create texture from %s! SDL_Error: %s",
@@ -441,6 +645,7 @@ void LTexture::free()
         mTexture = nullptr;
         mWidth = 0;
         mHeight = 0;
+        mPremultiplied = false;
     }
 }
 #ifdef _SDL_TTF_H
@@ -479,19 +684,45 @@ bool LTexture::loadFromRenderedText( std::string textureText, SDL_Color textColo
 // Set color Modulation
 void LTexture::setColor(Uint8 red, Uint8 green, Uint8 blue)
 {
-    SDL_SetTextureColorMod(mTexture, red, green, blue);
+    mRed = red;
+    mGreen = green;
+    mBlue = blue;
+    applyModulation();
 }
 
 // Set alpha blending
 void LTexture::setBlendMode(SDL_BlendMode blending)
 {
-    SDL_SetTextureBlendMode(mTexture, blending);
+    // Premultiplied textures blend with ONE instead of SRC_ALPHA
+    if( mPremultiplied && blending == SDL_BLENDMODE_BLEND )
+    {
+        blending = getPremultipliedBlendMode();
+    }
+    if( SDL_SetTextureBlendMode(mTexture, blending) != 0 )
+    {
+        printf("Unable to set blend mode! SDL_Error: %s\n", SDL_GetError());
+    }
 }
 
 // Set Alpha
 void LTexture::setAlpha(Uint8 alpha)
 {
-    SDL_SetTextureAlphaMod(mTexture, alpha);
+    mAlpha = alpha;
+    applyModulation();
+}
+void LTexture::applyModulation()
+{
+    // Premultiplied color has to fade along with alpha
+    if( mPremultiplied )
+    {
+        SDL_SetTextureColorMod(mTexture, mulDiv255(mRed, mAlpha),
+                               mulDiv255(mGreen, mAlpha), mulDiv255(mBlue, mAlpha));
+    }
+    else
+    {
+        SDL_SetTextureColorMod(mTexture, mRed, mGreen, mBlue);
+    }
+    SDL_SetTextureAlphaMod(mTexture, mAlpha);
 }
 
 void LTexture::render(int x, int y,
@@ -587,6 +818,7 @@ void Dot::render()
     gDotTexture.render(mPosX, mPosY);
 
     // Show the particles on top of dot
+    LProfileScope zone(gProfiler, "particles");
     renderParticles();
 }
 
@@ -610,10 +842,466 @@ void Dot::renderParticles()
     }
 }
 
+/***************************************************************************
+ LBitmapFont Method Definitions
+ ***************************************************************************/
+LBitmapFont::LBitmapFont()
+{
+    // Init variables
+    mNewLine = 0;
+    mSpace = 0;
+}
+
+bool LBitmapFont::buildFont(std::string path)
+{
+    bool success = true;
+
+    // Scan a 32 bit copy of the sheet
+    SDL_Surface* loadedSurface = IMG_Load(path.c_str());
+    SDL_Surface* formattedSurface = nullptr;
+    if(loadedSurface != nullptr)
+    {
+        formattedSurface = SDL_ConvertSurfaceFormat(loadedSurface, SDL_PIXELFORMAT_RGBA8888, 0);
+        SDL_FreeSurface(loadedSurface);
+    }
+    if(formattedSurface == nullptr)
+    {
+        std::cout << "Unable to load bitmap font " << path << "! SDL Error: " << SDL_GetError() << std::endl;
+        return false;
+    }
+    SDL_LockSurface(formattedSurface);
+
+    // Set the background color
+    Uint32 bgColor = getPixel32(formattedSurface, 0, 0);
+
+    // Set the cell dimensions
+    int cellW = formattedSurface->w / 16;
+    int cellH = formattedSurface->h / 16;
+
+    // New line variables
+    int top = cellH;
+    int baseA = cellH;
+
+    // The current character we're setting
+    int currentChar = 0;
+
+    // Go through the cell rows
+    for(auto rows = 0; rows < 16; ++rows)
+    {
+        // Go through the cell columns
+        for(auto cols = 0; cols < 16; ++cols)
+        {
+            // Set the character offset
+            mChars[currentChar].x = cellW * cols;
+            mChars[currentChar].y = cellH * rows;
+
+            // Set the dimensions of the character
+            mChars[currentChar].w = cellW;
+            mChars[currentChar].h = cellH;
+
+            // Find left side
+            for(auto pCol = 0; pCol < cellW; ++pCol)
+            {
+                for(auto pRow = 0; pRow < cellH; ++pRow)
+                {
+                    int pX = (cellW * cols) + pCol;
+                    int pY = (cellH * rows) + pRow;
+
+                    // If a non colorkey pixel is found
+                    if(getPixel32(formattedSurface, pX, pY) != bgColor)
+                    {
+                        mChars[currentChar].x = pX;
+
+                        // Break the loops
+                        pCol = cellW;
+                        pRow = cellH;
+                    }
+                }
+            }
+
+            // Find the right side
+            for(auto pColW = cellW - 1; pColW >= 0; --pColW)
+            {
+                for(auto pRowW = 0; pRowW < cellH; ++pRowW)
+                {
+                    int pX = (cellW * cols) + pColW;
+                    int pY = (cellH * rows) + pRowW;
+
+                    if(getPixel32(formattedSurface, pX, pY) != bgColor)
+                    {
+                        mChars[currentChar].w = (pX - mChars[currentChar].x) + 1;
+
+                        // Break the loops
+                        pColW = -1;
+                        pRowW = cellH;
+                    }
+                }
+            }
+
+            // Find the top
+            for(auto pRow = 0; pRow < cellH; ++pRow)
+            {
+                for(auto pCol = 0; pCol < cellW; ++pCol)
+                {
+                    int pX = (cellW * cols) + pCol;
+                    int pY = (cellH * rows) + pRow;
+
+                    if(getPixel32(formattedSurface, pX, pY) != bgColor)
+                    {
+                        if(pRow < top)
+                        {
+                            top = pRow;
+                        }
+
+                        // Break the loops
+                        pCol = cellW;
+                        pRow = cellH;
+                    }
+                }
+            }
+
+            // Find Bottom of A
+            if(currentChar == 'A')
+            {
+                for(auto pRow = cellH - 1; pRow >= 0; --pRow)
+                {
+                    for(auto pCol = 0; pCol < cellW; ++pCol)
+                    {
+                        int pX = (cellW * cols) + pCol;
+                        int pY = (cellH * rows) + pRow;
+
+                        if(getPixel32(formattedSurface, pX, pY) != bgColor)
+                        {
+                            baseA = pRow;
+
+                            // Break the loops
+                            pCol = cellW;
+                            pRow = -1;
+                        }
+                    }
+                }
+            }
+            // Go to the next character
+            ++currentChar;
+        }
+    }
+    // Calculate space
+    mSpace = cellW / 2;
+
+    // Calculate new line
+    mNewLine = baseA - top;
+
+    // Lop off excess top pixels
+    for(auto i = 0; i < 256; ++i)
+    {
+        mChars[i].y += top;
+        mChars[i].h -= top;
+    }
+
+    SDL_UnlockSurface(formattedSurface);
+    SDL_FreeSurface(formattedSurface);
+
+    // Color keyed texture to draw from
+    if(!mBitmap.loadFromFile(path))
+    {
+        success = false;
+    }
+    return success;
+}
+
+void LBitmapFont::free()
+{
+    mBitmap.free();
+}
+
+void LBitmapFont::renderText(int x, int y, std::string text)
+{
+    // Temp offsets
+    int curX = x, curY = y;
+
+    // go through the text
+    for(size_t i = 0; i < text.length(); ++i)
+    {
+        // If the current character is a space
+        if(text[i] == ' ')
+        {
+            curX += mSpace;
+        }
+        // If the current character is a new line
+        else if(text[i] == '\n')
+        {
+            curY += mNewLine;
+            curX = x;
+        }
+        else
+        {
+            // Show the charater
+            int ascii = (unsigned char)text[i];
+            mBitmap.render(curX, curY, &mChars[ascii]);
+
+            // Move over the width of the character with one pixel of padding
+            curX += mChars[ascii].w + 1;
+        }
+    }
+}
+
+Uint32 LBitmapFont::getPixel32(SDL_Surface* surface, int x, int y)
+{
+    Uint32* pixels = (Uint32*)surface->pixels;
+    return pixels[y * (surface->pitch / 4) + x];
+}
+/**************************************************************************/
+
+/***************************************************************************
+ LProfiler Method Definitions
+ ***************************************************************************/
+LProfiler::LProfiler()
+{
+    mFrameCount = 0;
+    mDepth = 0;
+    mFrequency = SDL_GetPerformanceFrequency();
+    mOverlay = false;
+    mFrames[0].zoneCount = 0;
+}
+
+void LProfiler::beginFrame()
+{
+    // Reuse the oldest slot in the ring
+    Frame& frame = mFrames[mFrameCount % PROFILER_HISTORY];
+    frame.zoneCount = 0;
+    frame.start = SDL_GetPerformanceCounter();
+    frame.end = frame.start;
+    mDepth = 0;
+}
+
+void LProfiler::endFrame()
+{
+    mFrames[mFrameCount % PROFILER_HISTORY].end = SDL_GetPerformanceCounter();
+    ++mFrameCount;
+
+    // Text only changes every few frames so the overlay stays cheap
+    if(mOverlay && mFrameCount % PROFILER_OVERLAY_REFRESH == 0)
+    {
+        buildOverlayText();
+    }
+}
+
+int LProfiler::beginZone(const char* name)
+{
+    Frame& frame = mFrames[mFrameCount % PROFILER_HISTORY];
+    if(frame.zoneCount >= PROFILER_MAX_ZONES)
+    {
+        return -1;
+    }
+
+    int slot = frame.zoneCount++;
+    Zone& zone = frame.zones[slot];
+    zone.name = name;
+    zone.depth = mDepth++;
+    zone.start = SDL_GetPerformanceCounter();
+    zone.end = zone.start;
+    return slot;
+}
+
+void LProfiler::endZone(int zone)
+{
+    // A zone that didn't fit never took a depth level
+    if(zone >= 0)
+    {
+        --mDepth;
+        mFrames[mFrameCount % PROFILER_HISTORY].zones[zone].end = SDL_GetPerformanceCounter();
+    }
+}
+
+bool LProfiler::exportTrace(std::string path)
+{
+    std::ofstream file(path.c_str());
+    if(!file)
+    {
+        std::cout << "Unable to write trace " << path << "!" << std::endl;
+        return false;
+    }
+
+    // Completed frames, oldest first
+    int count = mFrameCount < PROFILER_HISTORY ? mFrameCount : PROFILER_HISTORY;
+    int first = mFrameCount - count;
+    Uint64 origin = count > 0 ? mFrames[first % PROFILER_HISTORY].start : 0;
+
+    file << "{\"traceEvents\":[";
+    bool firstEvent = true;
+    char line[256];
+    for(int i = first; i < mFrameCount; ++i)
+    {
+        const Frame& frame = mFrames[i % PROFILER_HISTORY];
+
+        // The frame itself is the outermost complete event
+        for(int z = -1; z < frame.zoneCount; ++z)
+        {
+            const char* name = z < 0 ? "frame" : frame.zones[z].name;
+            Uint64 start = z < 0 ? frame.start : frame.zones[z].start;
+            Uint64 end = z < 0 ? frame.end : frame.zones[z].end;
+
+            snprintf(line, sizeof(line), "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}",
+                     firstEvent ? "" : ",", name,
+                     (start - origin) * 1000000.0 / mFrequency, (end - start) * 1000000.0 / mFrequency);
+            file << line;
+            firstEvent = false;
+        }
+    }
+    file << "\n]}\n";
+
+    std::cout << "Wrote " << count << " frames to " << path << std::endl;
+    return true;
+}
+
+void LProfiler::renderOverlay(LBitmapFont& font, int x, int y)
+{
+    if(mOverlay)
+    {
+        font.renderText(x, y, mOverlayText);
+    }
+}
+
+void LProfiler::toggleOverlay()
+{
+    mOverlay = !mOverlay;
+    if(mOverlay)
+    {
+        buildOverlayText();
+    }
+}
+
+void LProfiler::buildOverlayText()
+{
+    // Zone rows in the order they show up in the latest frame
+    const char* names[PROFILER_MAX_ZONES];
+    int depths[PROFILER_MAX_ZONES];
+    Uint64 totals[PROFILER_MAX_ZONES];
+    Uint64 peaks[PROFILER_MAX_ZONES];
+    int rows = 0;
+
+    Uint64 frameTotal = 0;
+    Uint64 framePeak = 0;
+
+    int count = mFrameCount < PROFILER_HISTORY ? mFrameCount : PROFILER_HISTORY;
+    for(int i = mFrameCount - 1; i >= mFrameCount - count; --i)
+    {
+        const Frame& frame = mFrames[i % PROFILER_HISTORY];
+        Uint64 frameTime = frame.end - frame.start;
+        frameTotal += frameTime;
+        framePeak = frameTime > framePeak ? frameTime : framePeak;
+
+        for(int z = 0; z < frame.zoneCount; ++z)
+        {
+            const Zone& zone = frame.zones[z];
+
+            // Find the row for this zone
+            int row = 0;
+            while(row < rows && (depths[row] != zone.depth || strcmp(names[row], zone.name) != 0))
+            {
+                ++row;
+            }
+            if(row == rows)
+            {
+                if(rows == PROFILER_MAX_ZONES)
+                {
+                    continue;
+                }
+                names[row] = zone.name;
+                depths[row] = zone.depth;
+                totals[row] = 0;
+                peaks[row] = 0;
+                ++rows;
+            }
+
+            Uint64 zoneTime = zone.end - zone.start;
+            totals[row] += zoneTime;
+            peaks[row] = zoneTime > peaks[row] ? zoneTime : peaks[row];
+        }
+    }
+
+    // Average and worst case in milliseconds
+    double toMs = 1000.0 / mFrequency;
+    int frames = count > 0 ? count : 1;
+    char line[128];
+    snprintf(line, sizeof(line), "frame %.2fms max %.2f\n", frameTotal * toMs / frames, framePeak * toMs);
+    mOverlayText = line;
+    for(int row = 0; row < rows; ++row)
+    {
+        snprintf(line, sizeof(line), "%*s%s %.2fms max %.2f\n", (depths[row] + 1) * 2, "",
+                 names[row], totals[row] * toMs / frames, peaks[row] * toMs);
+        mOverlayText += line;
+    }
+}
+/**************************************************************************/
+
+/***************************************************************************
+ LProfileScope Method Definitions
+ ***************************************************************************/
+LProfileScope::LProfileScope(LProfiler& profiler, const char* name): mProfiler(profiler), mZone(profiler.beginZone(name))
+{
+}
+
+LProfileScope::~LProfileScope()
+{
+    mProfiler.endZone(mZone);
+}
+/**************************************************************************/
+
+
+
 /***************************************************************************
  Function Definitions
  ***************************************************************************/
 
+SDL_BlendMode getPremultipliedBlendMode()
+{
+    // dst = src + dst * (1 - srcA), for color and alpha alike
+    return SDL_ComposeCustomBlendMode(SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA,
+                                      SDL_BLENDOPERATION_ADD,
+                                      SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA,
+                                      SDL_BLENDOPERATION_ADD);
+}
+
+Uint8 mulDiv255(Uint8 a, Uint8 b)
+{
+    // Rounded a * b / 255
+    Uint32 t = (Uint32)a * b + 128;
+    return (Uint8)((t + (t >> 8)) >> 8);
+}
+
+SDL_Surface* premultiplySurface(SDL_Surface* surface)
+{
+    // Converting turns the color key into zero alpha
+    SDL_Surface* formattedSurface = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_ARGB8888, 0);
+    if( formattedSurface == nullptr )
+    {
+        return nullptr;
+    }
+
+    SDL_LockSurface(formattedSurface);
+    for( int y = 0; y < formattedSurface->h; ++y )
+    {
+        Uint32* row = (Uint32*)((Uint8*)formattedSurface->pixels + y * formattedSurface->pitch);
+        for( int x = 0; x < formattedSurface->w; ++x )
+        {
+            Uint32 pixel = row[x];
+            Uint8 a = pixel >> 24;
+            if( a == 0xff )
+            {
+                continue;
+            }
+            Uint8 r = mulDiv255((pixel >> 16) & 0xff, a);
+            Uint8 g = mulDiv255((pixel >> 8) & 0xff, a);
+            Uint8 b = mulDiv255(pixel & 0xff, a);
+            row[x] = ((Uint32)a << 24) | ((Uint32)r << 16) | ((Uint32)g << 8) | b;
+        }
+    }
+    SDL_UnlockSurface(formattedSurface);
+
+    return formattedSurface;
+}
+
 bool init()
 {
     //Initialization flag
@@ -696,25 +1384,25 @@ bool loadMedia()
         success = false;
     }
 
-    if(!gRedTexture.loadFromFile("38_particle_engines/red.bmp"))
+    if(!gRedTexture.loadFromFile("38_particle_engines/red.bmp", true))
     {
         std::cout << "Failed to load dot texture." << std::endl;
         success = false;
     }
 
-    if(!gGreenTexture.loadFromFile("38_particle_engines/green.bmp"))
+    if(!gGreenTexture.loadFromFile("38_particle_engines/green.bmp", true))
     {
         std::cout << "Failed to load dot texture." << std::endl;
         success = false;
     }
 
-    if(!gBlueTexture.loadFromFile("38_particle_engines/blue.bmp"))
+    if(!gBlueTexture.loadFromFile("38_particle_engines/blue.bmp", true))
     {
         std::cout << "Failed to load dot texture." << std::endl;
         success = false;
     }
 
-    if(!gShimmerTexture.loadFromFile("38_particle_engines/shimmer.bmp"))
+    if(!gShimmerTexture.loadFromFile("38_particle_engines/shimmer.bmp", true))
     {
         std::cout << "Failed to load dot texture." << std::endl;
         success = false;
@@ -726,6 +1414,12 @@ bool loadMedia()
     gBlueTexture.setAlpha(192);
     gShimmerTexture.setAlpha(192);
 
+    if(!gOverlayFont.buildFont("38_particle_engines/lazyfont.png"))
+    {
+        std::cout << "Failed to load overlay font." << std::endl;
+        success = false;
+    }
+
     return success;
 }
 
@@ -733,6 +1427,7 @@ void close()
 {
     // Free loaded images
     gDotTexture.free();
+    gOverlayFont.free();
 #ifdef _SDL_TTF_H
     // Free global font
     TTF_CloseFont(gFont);
@@ -781,36 +1476,64 @@ int main( int argc, char* args[] )
             //While application is running
             while( !quit )
             {
+                gProfiler.beginFrame();
 
-                //Handle events on queue
-                while( SDL_PollEvent( &e ) != 0 )
                 {
-                    //User requests quit
-                    if( e.type == SDL_QUIT )
+                    LProfileScope zone(gProfiler, "events");
+
+                    //Handle events on queue
+                    while( SDL_PollEvent( &e ) != 0 )
                     {
-                        quit = true;
+                        //User requests quit
+                        if( e.type == SDL_QUIT )
+                        {
+                            quit = true;
+                        }
+                        // Profiler overlay and trace export
+                        else if( e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_p )
+                        {
+                            gProfiler.toggleOverlay();
+                        }
+                        else if( e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_t )
+                        {
+                            gProfiler.exportTrace("frame_trace.json");
+                        }
+                        // Handle input for the dot
+                        dot.handleEvent(e);
                     }
-                    // Handle input for the dot
-                    dot.handleEvent(e);
                 }
 
-                // Move the dot anc check Collision
-                dot.move();
+                {
+                    LProfileScope zone(gProfiler, "update");
 
-                //Clear screen
-                SDL_SetRenderDrawColor( gRenderer, 0xff, 0xff, 0xff, 0xff );
-                SDL_RenderClear( gRenderer );
+                    // Move the dot anc check Collision
+                    dot.move();
+                }
 
+                {
+                    LProfileScope zone(gProfiler, "render");
 
+                    //Clear screen
+                    SDL_SetRenderDrawColor( gRenderer, 0xff, 0xff, 0xff, 0xff );
+                    SDL_RenderClear( gRenderer );
 
-               // Render objects
-                dot.render();
+                    // Render objects
+                    dot.render();
 
+                    {
+                        LProfileScope overlayZone(gProfiler, "overlay");
+                        gProfiler.renderOverlay(gOverlayFont, 10, 10);
+                    }
+                }
 
-                //Update screen
-                SDL_RenderPresent( gRenderer );
+                {
+                    LProfileScope zone(gProfiler, "present");
 
+                    //Update screen
+                    SDL_RenderPresent( gRenderer );
+                }
 
+                gProfiler.endFrame();
             }
         }
     }
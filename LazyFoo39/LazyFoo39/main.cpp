@@ -10,6 +10,7 @@
 #include <cstdlib>
 #include <string>
 #include <fstream>
+#include <cstring>
 #include <SDL2/SDL.h>
 #include <SDL2_image/SDL_image.h>
 
@@ -45,6 +46,26 @@ const int TILE_TOPLEFT = 11;
 
 // Number of enemies
 const int TOTAL_ENEMIES = 500;
+
+// Zones kept per frame and frames kept for the profiler overlay and trace
+const int PROFILER_MAX_ZONES = 64;
+const int PROFILER_HISTORY = 120;
+
+// Frames between profiler overlay text refreshes
+const int PROFILER_OVERLAY_REFRESH = 30;
+
+// Refresh rate assumed when the display doesn't report one
+const int PRESENT_DEFAULT_REFRESH = 60;
+
+// Time before a frame deadline spent spinning instead of sleeping
+const int PACER_SPIN_MICROSECONDS = 2000;
+
+// Frames behind schedule before the pacer stops catching up and resyncs
+const int PACER_MAX_LAG_FRAMES = 3;
+
+// Adaptive mode restores vsync after this many frames well under a refresh
+const int PRESENT_RECOVER_FRAMES = 120;
+const double PRESENT_RECOVER_RATIO = 0.75;
 /*********************************************************************/
 
 /*************************************************************************
@@ -94,6 +115,9 @@ public:
 private:
     SDL_Rect bar;
     SDL_Color color;
+    
+    // Color scaled by its alpha for the premultiplied blend
+    SDL_Color premultipliedColor;
     int max = 100;
     int offsetX = 0;
     int offsetY = 0;
@@ -196,8 +220,8 @@ public:
     // Desstructor
     ~LTexture();
     
-    // Loads image at specified path
-    bool loadFromFile(std::string path);
+    // Loads image at specified path, optionally premultiplying alpha
+    bool loadFromFile(std::string path, bool premultiply = false);
     
     // Creates image from string
     bool loadFromRenderedText(std::string textureText, SDL_Color textColor);
@@ -225,12 +249,260 @@ public:
     int getHeight();
     
 private:
+    // Pushes the stored color/alpha modulation to the texture
+    void applyModulation();
+
     // The actual hardware texture
     SDL_Texture* mTexture;
     
     // Image dimensions
     int mWidth;
     int mHeight;
+
+    // Premultiplied pixel data and current modulation
+    bool mPremultiplied;
+    Uint8 mRed;
+    Uint8 mGreen;
+    Uint8 mBlue;
+    Uint8 mAlpha;
+};
+
+/*********************************************************************/
+
+/*************************************************************************
+ Bitmap font class
+ *************************************************************************/
+class LBitmapFont
+{
+public:
+    
+    LBitmapFont();
+    
+    // Loads the font sheet and finds the character clips
+    bool buildFont(std::string path);
+    
+    // Deallocates the font texture
+    void free();
+    
+    // Shows the text
+    void renderText(int x, int y, std::string text);
+
+private:
+    // Reads a pixel from a 32 bit surface
+    static Uint32 getPixel32(SDL_Surface* surface, int x, int y);
+    
+    // The font texture
+    LTexture mBitmap;
+    
+    // the individual characters in the surface
+    SDL_Rect mChars[256];
+    
+    // Spacing variables
+    int mNewLine, mSpace;
+};
+
+/*********************************************************************/
+
+/*************************************************************************
+ Frame profiler class
+ *************************************************************************/
+class LProfiler
+{
+public:
+    // Constructor
+    LProfiler();
+    
+    // Brackets one frame, zones recorded in between belong to it
+    void beginFrame();
+    void endFrame();
+    
+    // Opens a zone nested in the open one, returns its slot or -1 when the frame is full
+    int beginZone(const char* name);
+    void endZone(int zone);
+    
+    // Writes the recorded frames as Chrome trace JSON
+    bool exportTrace(std::string path);
+    
+    // Shows per zone averages over the recorded frames
+    void renderOverlay(LBitmapFont& font, int x, int y);
+    void toggleOverlay();
+
+private:
+    struct Zone
+    {
+        const char* name;
+        Uint64 start;
+        Uint64 end;
+        int depth;
+    };
+    
+    struct Frame
+    {
+        Uint64 start;
+        Uint64 end;
+        Zone zones[PROFILER_MAX_ZONES];
+        int zoneCount;
+    };
+    
+    // Refreshes the cached overlay text
+    void buildOverlayText();
+    
+    // Ring of the most recent frames
+    Frame mFrames[PROFILER_HISTORY];
+    int mFrameCount;
+    
+    // Zones currently open
+    int mDepth;
+    
+    Uint64 mFrequency;
+    
+    bool mOverlay;
+    std::string mOverlayText;
+};
+
+/*********************************************************************/
+
+/*************************************************************************
+ Profile zone class
+ *************************************************************************/
+class LProfileScope
+{
+public:
+    // Opens the zone
+    LProfileScope(LProfiler& profiler, const char* name);
+    
+    // Closes the zone when it goes out of scope
+    ~LProfileScope();
+
+private:
+    LProfiler& mProfiler;
+    int mZone;
+};
+
+/*********************************************************************/
+
+/*************************************************************************
+ Frame pacer class
+ *************************************************************************/
+// Holds frames to a fixed rate, sleeping for most of the wait and spinning the rest
+class LFramePacer
+{
+public:
+    // Constructor
+    LFramePacer();
+    
+    // Starts a fresh schedule at the given rate
+    void start(int fps);
+    
+    // Blocks until the next frame deadline
+    void wait();
+    
+    // Frames that were already past their deadline and schedules restarted after falling behind
+    int getLateFrames();
+    int getResyncs();
+
+private:
+    // Deadline of a frame on the absolute schedule
+    Uint64 getDeadline(Uint64 frame);
+    
+    Uint64 mFrequency;
+    int mFps;
+    
+    // Absolute schedule
+    Uint64 mStart;
+    Uint64 mFrame;
+    
+    // How long before a deadline to stop sleeping, learned from oversleeps
+    Uint64 mSpinCounts;
+    Uint64 mMinSpinCounts;
+    
+    int mLateFrames;
+    int mResyncs;
+};
+
+/*********************************************************************/
+
+/*************************************************************************
+ Present policy class
+ *************************************************************************/
+// How frames are handed to the display
+enum PresentMode
+{
+    PRESENT_VSYNC,
+    PRESENT_UNCAPPED,
+    PRESENT_CAPPED,
+    PRESENT_ADAPTIVE,
+    PRESENT_MODE_TOTAL
+};
+
+class LPresentPolicy
+{
+public:
+    // Constructor
+    LPresentPolicy();
+    
+    // Selects a mode by name, false if the name is unknown
+    bool setModeByName(std::string name);
+    
+    // Switches mode, changing vsync on the attached renderer
+    void setMode(PresentMode mode);
+    
+    PresentMode getMode();
+    
+    const char* getModeName(PresentMode mode);
+    
+    // Flags to create the renderer with for the current mode
+    Uint32 getRendererFlags();
+    
+    // Reads the display refresh rate and takes over presenting
+    void attach(SDL_Window* window, SDL_Renderer* renderer);
+    
+    // Sets the frame rate the capped mode paces to
+    void setCappedFps(int fps);
+    
+    // Remembers when the first input of the frame was generated
+    void handleEvent(SDL_Event& e);
+    
+    // Paces and presents the frame, then records input latency
+    void present();
+    
+    // Prints the latency measured in each mode
+    void printReport();
+
+private:
+    // Turns vsync on or off, keeping the old state if the driver refuses
+    void setVSync(bool enabled);
+    
+    SDL_Renderer* mRenderer;
+    PresentMode mMode;
+    bool mVSync;
+    
+    // Display and capped frame rates, and a refresh in performance counter units
+    int mRefreshRate;
+    int mCappedFps;
+    Uint64 mFrequency;
+    Uint64 mRefreshCounts;
+    
+    // Paces capped frames, and adaptive frames while vsync is off
+    LFramePacer mPacer;
+    
+    // When the last present returned
+    Uint64 mFrameStart;
+    
+    // Adaptive mode frames under budget since vsync was dropped
+    int mGoodFrames;
+    
+    // Earliest input event since the last present, in performance counter units
+    bool mInputPending;
+    Uint64 mInputCounts;
+    
+    // Input to present latency in microseconds per mode
+    Uint64 mLatencyTotal[PRESENT_MODE_TOTAL];
+    Uint64 mLatencyMax[PRESENT_MODE_TOTAL];
+    int mLatencySamples[PRESENT_MODE_TOTAL];
+    
+    // Times adaptive mode gave up vsync
+    int mVSyncDrops;
 };
 
 /*********************************************************************/
@@ -254,11 +526,27 @@ LTexture gEnemyTexture;
 LTexture gTileTexture;
 SDL_Rect gTileClips[TOTAL_TILE_SPRITES];
 
+// Frame stage timings
+LProfiler gProfiler;
+
+// Font for the profiler overlay
+LBitmapFont gOverlayFont;
+
+// Chooses how frames reach the display
+LPresentPolicy gPresentPolicy;
+
 /*********************************************************************/
 
 /**************************************************************************
  Function Declarations
  **************************************************************************/
+// Premultiplied alpha helpers
+SDL_BlendMode getPremultipliedBlendMode();
+
+Uint8 mulDiv255(Uint8 a, Uint8 b);
+
+SDL_Surface* premultiplySurface(SDL_Surface* surface);
+
 bool init();
 
 bool loadMedia(Tile* tiles[]);
@@ -321,6 +609,11 @@ LTexture::LTexture()
     mTexture = nullptr;
     mWidth = 0;
     mHeight = 0;
+    mPremultiplied = false;
+    mRed = 0xff;
+    mGreen = 0xff;
+    mBlue = 0xff;
+    mAlpha = 0xff;
 }
 
 LTexture::~LTexture()
@@ -329,10 +622,11 @@ LTexture::~LTexture()
     free();
 }
 
-bool LTexture::loadFromFile(std::string path)
+bool LTexture::loadFromFile(std::string path, bool premultiply)
 {
     //The final texture
     SDL_Texture* newTexture = nullptr;
+    mPremultiplied = false;
     
     // Load image at the specified path
     SDL_Surface* loadedSurface = IMG_Load(path.c_str() );
@@ -346,9 +640,36 @@ bool LTexture::loadFromFile(std::string path)
         // Color key image
         SDL_SetColorKey(loadedSurface, SDL_TRUE,
                         SDL_MapRGB(loadedSurface->format, 0, 0xff, 0xff) );
+
+        // Bake color key and alpha into premultiplied ARGB
+        if( premultiply )
+        {
+            SDL_Surface* formattedSurface = premultiplySurface(loadedSurface);
+            if( formattedSurface == nullptr )
+            {
+                printf("Unable to premultiply %s! SDL_Error: %s\n",
+                       path.c_str(), SDL_GetError());
+            }
+            else
+            {
+                // Premultiplied pixels are only usable if the renderer takes the matching blend equation
+                newTexture = SDL_CreateTextureFromSurface(gRenderer, formattedSurface);
+                if( newTexture != nullptr && SDL_SetTextureBlendMode(newTexture, getPremultipliedBlendMode()) != 0 )
+                {
+                    printf("Premultiplied blending not supported, using straight alpha for %s\n", path.c_str());
+                    SDL_DestroyTexture(newTexture);
+                    newTexture = nullptr;
+                }
+                mPremultiplied = newTexture != nullptr;
+                SDL_FreeSurface( formattedSurface );
+            }
+        }
         
         // Create texture from surface pixels
-        newTexture = SDL_CreateTextureFromSurface(gRenderer, loadedSurface);
+        if( newTexture == nullptr )
+        {
+            newTexture = SDL_CreateTextureFromSurface(gRenderer, loadedSurface);
+        }
         if( newTexture == nullptr)
         {
             printf("Unable to create texture from %s! SDL_Error: %s",
@@ -376,6 +697,7 @@ void LTexture::free()
         mTexture = nullptr;
         mWidth = 0;
         mHeight = 0;
+        mPremultiplied = false;
     }
 }
 #ifdef _SDL_TTF_H
@@ -414,19 +736,45 @@ bool LTexture::loadFromRenderedText( std::string textureText, SDL_Color textColo
 // Set color Modulation
 void LTexture::setColor(Uint8 red, Uint8 green, Uint8 blue)
 {
-    SDL_SetTextureColorMod(mTexture, red, green, blue);
+    mRed = red;
+    mGreen = green;
+    mBlue = blue;
+    applyModulation();
 }
 
 // Set alpha blending
 void LTexture::setBlendMode(SDL_BlendMode blending)
 {
-    SDL_SetTextureBlendMode(mTexture, blending);
+    // Premultiplied textures blend with ONE instead of SRC_ALPHA
+    if( mPremultiplied && blending == SDL_BLENDMODE_BLEND )
+    {
+        blending = getPremultipliedBlendMode();
+    }
+    if( SDL_SetTextureBlendMode(mTexture, blending) != 0 )
+    {
+        printf("Unable to set blend mode! SDL_Error: %s\n", SDL_GetError());
+    }
 }
 
 // Set Alpha
 void LTexture::setAlpha(Uint8 alpha)
 {
-    SDL_SetTextureAlphaMod(mTexture, alpha);
+    mAlpha = alpha;
+    applyModulation();
+}
+void LTexture::applyModulation()
+{
+    // Premultiplied color has to fade along with alpha
+    if( mPremultiplied )
+    {
+        SDL_SetTextureColorMod(mTexture, mulDiv255(mRed, mAlpha),
+                               mulDiv255(mGreen, mAlpha), mulDiv255(mBlue, mAlpha));
+    }
+    else
+    {
+        SDL_SetTextureColorMod(mTexture, mRed, mGreen, mBlue);
+    }
+    SDL_SetTextureAlphaMod(mTexture, mAlpha);
 }
 
 void LTexture::render(int x, int y,
@@ -618,6 +966,11 @@ void Dot::render(SDL_Rect& camera)
 UIBar::UIBar(SDL_Rect& camera, SDL_Color color, int width, int height, int offsetX, int offsetY):
             color(color), offsetX(offsetX), offsetY(offsetY)
 {
+    // Premultiply once so render can use the cheaper blend equation
+    premultipliedColor.r = mulDiv255(color.r, color.a);
+    premultipliedColor.g = mulDiv255(color.g, color.a);
+    premultipliedColor.b = mulDiv255(color.b, color.a);
+    premultipliedColor.a = color.a;
     
     bar.x = camera.x + offsetX;
     bar.y = camera.y + offsetY;
@@ -628,7 +981,16 @@ UIBar::UIBar(SDL_Rect& camera, SDL_Color color, int width, int height, int offse
 // Show UIBar
 void UIBar::render()
 {
-    SDL_SetRenderDrawColor(gRenderer, color.r, color.g, color.b, color.a);
+    // Renderers without custom blend modes get the straight color instead
+    if( SDL_SetRenderDrawBlendMode(gRenderer, getPremultipliedBlendMode()) == 0 )
+    {
+        SDL_SetRenderDrawColor(gRenderer, premultipliedColor.r, premultipliedColor.g, premultipliedColor.b, premultipliedColor.a);
+    }
+    else
+    {
+        SDL_SetRenderDrawBlendMode(gRenderer, SDL_BLENDMODE_BLEND);
+        SDL_SetRenderDrawColor(gRenderer, color.r, color.g, color.b, color.a);
+    }
     SDL_RenderFillRect(gRenderer, &bar);
 }
 
@@ -645,118 +1007,916 @@ void UIBar::updateWidth(int value)
 /***************************************************************************/
 
 /***************************************************************************
- Function Definitions
+ LBitmapFont Method Definitions
  ***************************************************************************/
+LBitmapFont::LBitmapFont()
+{
+    // Init variables
+    mNewLine = 0;
+    mSpace = 0;
+}
 
-bool init()
+bool LBitmapFont::buildFont(std::string path)
 {
-    //Initialization flag
     bool success = true;
     
-    //Initialize SDL
-    if( SDL_Init( SDL_INIT_VIDEO ) < 0 )
+    // Scan a 32 bit copy of the sheet
+    SDL_Surface* loadedSurface = IMG_Load(path.c_str());
+    SDL_Surface* formattedSurface = nullptr;
+    if(loadedSurface != nullptr)
     {
-        printf( "SDL could not initialize! SDL Error: %s\n", SDL_GetError() );
-        success = false;
+        formattedSurface = SDL_ConvertSurfaceFormat(loadedSurface, SDL_PIXELFORMAT_RGBA8888, 0);
+        SDL_FreeSurface(loadedSurface);
     }
-    else
+    if(formattedSurface == nullptr)
     {
-        //Set texture filtering to linear
-        if( !SDL_SetHint( SDL_HINT_RENDER_SCALE_QUALITY, "1" ) )
-        {
-            printf( "Warning: Linear texture filtering not enabled!" );
-        }
-        
-        //Create window
-        gWindow = SDL_CreateWindow( "SDL Tutorial", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_SHOWN );
-        if( gWindow == NULL )
-        {
-            printf( "Window could not be created! SDL Error: %s\n", SDL_GetError() );
-            success = false;
-        }
-        else
+        std::cout << "Unable to load bitmap font " << path << "! SDL Error: " << SDL_GetError() << std::endl;
+        return false;
+    }
+    SDL_LockSurface(formattedSurface);
+    
+    // Set the background color
+    Uint32 bgColor = getPixel32(formattedSurface, 0, 0);
+    
+    // Set the cell dimensions
+    int cellW = formattedSurface->w / 16;
+    int cellH = formattedSurface->h / 16;
+    
+    // New line variables
+    int top = cellH;
+    int baseA = cellH;
+    
+    // The current character we're setting
+    int currentChar = 0;
+    
+    // Go through the cell rows
+    for(auto rows = 0; rows < 16; ++rows)
+    {
+        // Go through the cell columns
+        for(auto cols = 0; cols < 16; ++cols)
         {
-            //Create renderer for window
-            gRenderer = SDL_CreateRenderer( gWindow, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC );
-            if( gRenderer == NULL )
+            // Set the character offset
+            mChars[currentChar].x = cellW * cols;
+            mChars[currentChar].y = cellH * rows;
+            
+            // Set the dimensions of the character
+            mChars[currentChar].w = cellW;
+            mChars[currentChar].h = cellH;
+            
+            // Find left side
+            for(auto pCol = 0; pCol < cellW; ++pCol)
             {
-                printf( "Renderer could not be created! SDL Error: %s\n", SDL_GetError() );
-                success = false;
+                for(auto pRow = 0; pRow < cellH; ++pRow)
+                {
+                    int pX = (cellW * cols) + pCol;
+                    int pY = (cellH * rows) + pRow;
+                    
+                    // If a non colorkey pixel is found
+                    if(getPixel32(formattedSurface, pX, pY) != bgColor)
+                    {
+                        mChars[currentChar].x = pX;
+                        
+                        // Break the loops
+                        pCol = cellW;
+                        pRow = cellH;
+                    }
+                }
             }
-            else
+            
+            // Find the right side
+            for(auto pColW = cellW - 1; pColW >= 0; --pColW)
             {
-                //Initialize renderer color
-                SDL_SetRenderDrawColor( gRenderer, 0xFF, 0xFF, 0xFF, 0xFF );
-                
-                //Initialize PNG loading
-                int imgFlags = IMG_INIT_PNG;
-                if( !( IMG_Init( imgFlags ) & imgFlags ) )
+                for(auto pRowW = 0; pRowW < cellH; ++pRowW)
                 {
-                    printf( "SDL_image could not initialize! SDL_image Error: %s\n", IMG_GetError() );
-                    success = false;
+                    int pX = (cellW * cols) + pColW;
+                    int pY = (cellH * rows) + pRowW;
+                    
+                    if(getPixel32(formattedSurface, pX, pY) != bgColor)
+                    {
+                        mChars[currentChar].w = (pX - mChars[currentChar].x) + 1;
+                        
+                        // Break the loops
+                        pColW = -1;
+                        pRowW = cellH;
+                    }
                 }
-#ifdef _SDL_TTF_H
-                // Initialize SDL_ttf
-                if( TTF_Init() == -1 )
+            }
+            
+            // Find the top
+            for(auto pRow = 0; pRow < cellH; ++pRow)
+            {
+                for(auto pCol = 0; pCol < cellW; ++pCol)
                 {
-                    std::cout << "SDL_ttf could not initialize! SDL_ttf Error: " << SDL_GetError() ;
-                    success = false;
+                    int pX = (cellW * cols) + pCol;
+                    int pY = (cellH * rows) + pRow;
+                    
+                    if(getPixel32(formattedSurface, pX, pY) != bgColor)
+                    {
+                        if(pRow < top)
+                        {
+                            top = pRow;
+                        }
+                        
+                        // Break the loops
+                        pCol = cellW;
+                        pRow = cellH;
+                    }
+                }
+            }
+            
+            // Find Bottom of A
+            if(currentChar == 'A')
+            {
+                for(auto pRow = cellH - 1; pRow >= 0; --pRow)
+                {
+                    for(auto pCol = 0; pCol < cellW; ++pCol)
+                    {
+                        int pX = (cellW * cols) + pCol;
+                        int pY = (cellH * rows) + pRow;
+                        
+                        if(getPixel32(formattedSurface, pX, pY) != bgColor)
+                        {
+                            baseA = pRow;
+                            
+                            // Break the loops
+                            pCol = cellW;
+                            pRow = -1;
+                        }
+                    }
                 }
-#endif
             }
+            // Go to the next character
+            ++currentChar;
         }
     }
-    SDL_SetWindowFullscreen(gWindow, SDL_WINDOW_FULLSCREEN);
-    return success;
-}
-
-bool loadMedia(Tile* tiles[])
-{
-    // Loading success flag
-    bool success = true;
-
+    // Calculate space
+    mSpace = cellW / 2;
     
-    if(!gDotTexture.loadFromFile("39_tiling/dot.bmp"))
-    {
-        std::cout << "Failed to load dot texture." << std::endl;
-        success = false;
-    }
+    // Calculate new line
+    mNewLine = baseA - top;
     
-    if(!gEnemyTexture.loadFromFile("39_tiling/enemy.png"))
+    // Lop off excess top pixels
+    for(auto i = 0; i < 256; ++i)
     {
-        std::cout << "Failed to load dot texture." << std::endl;
-        success = false;
+        mChars[i].y += top;
+        mChars[i].h -= top;
     }
     
-    if(!gTileTexture.loadFromFile("39_tiling/tiles.png"))
-    {
-        std::cout << "Failed to load dot texture." << std::endl;
-        success = false;
-    }
+    SDL_UnlockSurface(formattedSurface);
+    SDL_FreeSurface(formattedSurface);
     
-    // Load tile map
-    if(!setTiles(tiles))
+    // Color keyed texture to draw from
+    if(!mBitmap.loadFromFile(path))
     {
-        std::cout << "Failed to load tile set!" << std::endl;
         success = false;
     }
     return success;
 }
 
+void LBitmapFont::free()
+{
+    mBitmap.free();
+}
 
-bool setTiles(Tile* tiles[])
+void LBitmapFont::renderText(int x, int y, std::string text)
 {
-    // Success flag
-    bool tilesLoaded = true;
-    
-    // the tile offsets
-    int x = 0, y = 0;
+    // Temp offsets
+    int curX = x, curY = y;
     
-    // Open the map
-    std::ifstream map("39_tiling/lazy.map");
-    if(!map.is_open())
+    // go through the text
+    for(size_t i = 0; i < text.length(); ++i)
     {
-        std::cout << "Unable to load map file!" << std::endl;
+        // If the current character is a space
+        if(text[i] == ' ')
+        {
+            curX += mSpace;
+        }
+        // If the current character is a new line
+        else if(text[i] == '\n')
+        {
+            curY += mNewLine;
+            curX = x;
+        }
+        else
+        {
+            // Show the charater
+            int ascii = (unsigned char)text[i];
+            mBitmap.render(curX, curY, &mChars[ascii]);
+            
+            // Move over the width of the character with one pixel of padding
+            curX += mChars[ascii].w + 1;
+        }
+    }
+}
+
+Uint32 LBitmapFont::getPixel32(SDL_Surface* surface, int x, int y)
+{
+    Uint32* pixels = (Uint32*)surface->pixels;
+    return pixels[y * (surface->pitch / 4) + x];
+}
+/**************************************************************************/
+
+/***************************************************************************
+ LProfiler Method Definitions
+ ***************************************************************************/
+LProfiler::LProfiler()
+{
+    mFrameCount = 0;
+    mDepth = 0;
+    mFrequency = SDL_GetPerformanceFrequency();
+    mOverlay = false;
+    mFrames[0].zoneCount = 0;
+}
+
+void LProfiler::beginFrame()
+{
+    // Reuse the oldest slot in the ring
+    Frame& frame = mFrames[mFrameCount % PROFILER_HISTORY];
+    frame.zoneCount = 0;
+    frame.start = SDL_GetPerformanceCounter();
+    frame.end = frame.start;
+    mDepth = 0;
+}
+
+void LProfiler::endFrame()
+{
+    mFrames[mFrameCount % PROFILER_HISTORY].end = SDL_GetPerformanceCounter();
+    ++mFrameCount;
+    
+    // Text only changes every few frames so the overlay stays cheap
+    if(mOverlay && mFrameCount % PROFILER_OVERLAY_REFRESH == 0)
+    {
+        buildOverlayText();
+    }
+}
+
+int LProfiler::beginZone(const char* name)
+{
+    Frame& frame = mFrames[mFrameCount % PROFILER_HISTORY];
+    if(frame.zoneCount >= PROFILER_MAX_ZONES)
+    {
+        return -1;
+    }
+    
+    int slot = frame.zoneCount++;
+    Zone& zone = frame.zones[slot];
+    zone.name = name;
+    zone.depth = mDepth++;
+    zone.start = SDL_GetPerformanceCounter();
+    zone.end = zone.start;
+    return slot;
+}
+
+void LProfiler::endZone(int zone)
+{
+    // A zone that didn't fit never took a depth level
+    if(zone >= 0)
+    {
+        --mDepth;
+        mFrames[mFrameCount % PROFILER_HISTORY].zones[zone].end = SDL_GetPerformanceCounter();
+    }
+}
+
+bool LProfiler::exportTrace(std::string path)
+{
+    std::ofstream file(path.c_str());
+    if(!file)
+    {
+        std::cout << "Unable to write trace " << path << "!" << std::endl;
+        return false;
+    }
+    
+    // Completed frames, oldest first
+    int count = mFrameCount < PROFILER_HISTORY ? mFrameCount : PROFILER_HISTORY;
+    int first = mFrameCount - count;
+    Uint64 origin = count > 0 ? mFrames[first % PROFILER_HISTORY].start : 0;
+    
+    file << "{\"traceEvents\":[";
+    bool firstEvent = true;
+    char line[256];
+    for(int i = first; i < mFrameCount; ++i)
+    {
+        const Frame& frame = mFrames[i % PROFILER_HISTORY];
+        
+        // The frame itself is the outermost complete event
+        for(int z = -1; z < frame.zoneCount; ++z)
+        {
+            const char* name = z < 0 ? "frame" : frame.zones[z].name;
+            Uint64 start = z < 0 ? frame.start : frame.zones[z].start;
+            Uint64 end = z < 0 ? frame.end : frame.zones[z].end;
+            
+            snprintf(line, sizeof(line), "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}",
+                     firstEvent ? "" : ",", name,
+                     (start - origin) * 1000000.0 / mFrequency, (end - start) * 1000000.0 / mFrequency);
+            file << line;
+            firstEvent = false;
+        }
+    }
+    file << "\n]}\n";
+    
+    std::cout << "Wrote " << count << " frames to " << path << std::endl;
+    return true;
+}
+
+void LProfiler::renderOverlay(LBitmapFont& font, int x, int y)
+{
+    if(mOverlay)
+    {
+        font.renderText(x, y, mOverlayText);
+    }
+}
+
+void LProfiler::toggleOverlay()
+{
+    mOverlay = !mOverlay;
+    if(mOverlay)
+    {
+        buildOverlayText();
+    }
+}
+
+void LProfiler::buildOverlayText()
+{
+    // Zone rows in the order they show up in the latest frame
+    const char* names[PROFILER_MAX_ZONES];
+    int depths[PROFILER_MAX_ZONES];
+    Uint64 totals[PROFILER_MAX_ZONES];
+    Uint64 peaks[PROFILER_MAX_ZONES];
+    int rows = 0;
+    
+    Uint64 frameTotal = 0;
+    Uint64 framePeak = 0;
+    
+    int count = mFrameCount < PROFILER_HISTORY ? mFrameCount : PROFILER_HISTORY;
+    for(int i = mFrameCount - 1; i >= mFrameCount - count; --i)
+    {
+        const Frame& frame = mFrames[i % PROFILER_HISTORY];
+        Uint64 frameTime = frame.end - frame.start;
+        frameTotal += frameTime;
+        framePeak = frameTime > framePeak ? frameTime : framePeak;
+        
+        for(int z = 0; z < frame.zoneCount; ++z)
+        {
+            const Zone& zone = frame.zones[z];
+            
+            // Find the row for this zone
+            int row = 0;
+            while(row < rows && (depths[row] != zone.depth || strcmp(names[row], zone.name) != 0))
+            {
+                ++row;
+            }
+            if(row == rows)
+            {
+                if(rows == PROFILER_MAX_ZONES)
+                {
+                    continue;
+                }
+                names[row] = zone.name;
+                depths[row] = zone.depth;
+                totals[row] = 0;
+                peaks[row] = 0;
+                ++rows;
+            }
+            
+            Uint64 zoneTime = zone.end - zone.start;
+            totals[row] += zoneTime;
+            peaks[row] = zoneTime > peaks[row] ? zoneTime : peaks[row];
+        }
+    }
+    
+    // Average and worst case in milliseconds
+    double toMs = 1000.0 / mFrequency;
+    int frames = count > 0 ? count : 1;
+    char line[128];
+    snprintf(line, sizeof(line), "frame %.2fms max %.2f\n", frameTotal * toMs / frames, framePeak * toMs);
+    mOverlayText = line;
+    for(int row = 0; row < rows; ++row)
+    {
+        snprintf(line, sizeof(line), "%*s%s %.2fms max %.2f\n", (depths[row] + 1) * 2, "",
+                 names[row], totals[row] * toMs / frames, peaks[row] * toMs);
+        mOverlayText += line;
+    }
+}
+/**************************************************************************/
+
+/***************************************************************************
+ LProfileScope Method Definitions
+ ***************************************************************************/
+LProfileScope::LProfileScope(LProfiler& profiler, const char* name): mProfiler(profiler), mZone(profiler.beginZone(name))
+{
+}
+
+LProfileScope::~LProfileScope()
+{
+    mProfiler.endZone(mZone);
+}
+/**************************************************************************/
+
+
+
+/*********************************************************************
+ LFramePacer Method Declarations
+ *********************************************************************/
+LFramePacer::LFramePacer()
+{
+    mFrequency = SDL_GetPerformanceFrequency();
+    mFps = 60;
+    mStart = 0;
+    mFrame = 0;
+    mMinSpinCounts = mFrequency * PACER_SPIN_MICROSECONDS / 1000000;
+    mSpinCounts = mMinSpinCounts;
+    mLateFrames = 0;
+    mResyncs = 0;
+}
+
+void LFramePacer::start(int fps)
+{
+    mFrequency = SDL_GetPerformanceFrequency();
+    mMinSpinCounts = mFrequency * PACER_SPIN_MICROSECONDS / 1000000;
+    mSpinCounts = mMinSpinCounts;
+    mFps = fps > 0 ? fps : 1;
+    mStart = SDL_GetPerformanceCounter();
+    mFrame = 0;
+}
+
+void LFramePacer::wait()
+{
+    // Deadlines come from the start time so rounding never builds up
+    ++mFrame;
+    Uint64 deadline = getDeadline(mFrame);
+    Uint64 now = SDL_GetPerformanceCounter();
+    
+    if(now < deadline)
+    {
+        // Sleep through the bulk of the wait, the scheduler may oversleep
+        if(deadline - now > mSpinCounts)
+        {
+            Uint64 sleepCounts = deadline - now - mSpinCounts;
+            Uint32 sleepMs = (Uint32)(sleepCounts * 1000 / mFrequency);
+            if(sleepMs > 0)
+            {
+                SDL_Delay(sleepMs);
+                
+                // Keep the spin margin above the worst recent oversleep
+                Uint64 slept = SDL_GetPerformanceCounter() - now;
+                Uint64 asked = sleepMs * mFrequency / 1000;
+                Uint64 overshoot = slept > asked ? slept - asked : 0;
+                mSpinCounts -= (mSpinCounts - mMinSpinCounts) / 64;
+                if(overshoot + mMinSpinCounts / 2 > mSpinCounts)
+                {
+                    mSpinCounts = overshoot + mMinSpinCounts / 2;
+                }
+            }
+        }
+        
+        // Spin out the rest on the performance counter
+        do
+        {
+            now = SDL_GetPerformanceCounter();
+        } while(now < deadline);
+    }
+    else
+    {
+        ++mLateFrames;
+        
+        // Too far behind to catch up smoothly, start a new schedule from here
+        if(now - deadline > getDeadline(PACER_MAX_LAG_FRAMES) - mStart)
+        {
+            mStart = now;
+            mFrame = 0;
+            ++mResyncs;
+        }
+    }
+}
+
+int LFramePacer::getLateFrames()
+{
+    return mLateFrames;
+}
+
+int LFramePacer::getResyncs()
+{
+    return mResyncs;
+}
+
+Uint64 LFramePacer::getDeadline(Uint64 frame)
+{
+    return mStart + frame * mFrequency / mFps;
+}
+/**************************************************************************/
+
+
+/*********************************************************************
+ LPresentPolicy Method Declarations
+ *********************************************************************/
+LPresentPolicy::LPresentPolicy()
+{
+    mRenderer = NULL;
+    mMode = PRESENT_VSYNC;
+    mVSync = true;
+    mRefreshRate = PRESENT_DEFAULT_REFRESH;
+    mCappedFps = 0;
+    mFrequency = SDL_GetPerformanceFrequency();
+    mRefreshCounts = mFrequency / PRESENT_DEFAULT_REFRESH;
+    mFrameStart = 0;
+    mGoodFrames = 0;
+    mInputPending = false;
+    mInputCounts = 0;
+    for(int i = 0; i < PRESENT_MODE_TOTAL; ++i)
+    {
+        mLatencyTotal[i] = 0;
+        mLatencyMax[i] = 0;
+        mLatencySamples[i] = 0;
+    }
+    mVSyncDrops = 0;
+}
+
+bool LPresentPolicy::setModeByName(std::string name)
+{
+    for(int i = 0; i < PRESENT_MODE_TOTAL; ++i)
+    {
+        if(name == getModeName((PresentMode)i))
+        {
+            setMode((PresentMode)i);
+            return true;
+        }
+    }
+    return false;
+}
+
+void LPresentPolicy::setMode(PresentMode mode)
+{
+    mMode = mode;
+    mGoodFrames = 0;
+    
+    // Input from before the switch belongs to the old mode
+    mInputPending = false;
+    
+    setVSync(mode == PRESENT_VSYNC || mode == PRESENT_ADAPTIVE);
+    if(mRenderer != NULL)
+    {
+        printf( "Present mode: %s\n", getModeName(mode) );
+        
+        // Capped frames pace from the switch, before attaching the rate isn't known yet
+        if(mode == PRESENT_CAPPED)
+        {
+            mPacer.start(mCappedFps);
+        }
+    }
+}
+
+PresentMode LPresentPolicy::getMode()
+{
+    return mMode;
+}
+
+const char* LPresentPolicy::getModeName(PresentMode mode)
+{
+    switch(mode)
+    {
+        case PRESENT_VSYNC: return "vsync";
+        case PRESENT_UNCAPPED: return "uncapped";
+        case PRESENT_CAPPED: return "capped";
+        case PRESENT_ADAPTIVE: return "adaptive";
+        default: return "unknown";
+    }
+}
+
+Uint32 LPresentPolicy::getRendererFlags()
+{
+    Uint32 flags = SDL_RENDERER_ACCELERATED;
+    if(mMode == PRESENT_VSYNC || mMode == PRESENT_ADAPTIVE)
+    {
+        flags |= SDL_RENDERER_PRESENTVSYNC;
+    }
+    return flags;
+}
+
+void LPresentPolicy::attach(SDL_Window* window, SDL_Renderer* renderer)
+{
+    // The renderer was created with getRendererFlags
+    mRenderer = renderer;
+    mVSync = (mMode == PRESENT_VSYNC || mMode == PRESENT_ADAPTIVE);
+    
+    SDL_DisplayMode displayMode;
+    int refresh = PRESENT_DEFAULT_REFRESH;
+    if(SDL_GetWindowDisplayMode(window, &displayMode) == 0 && displayMode.refresh_rate > 0)
+    {
+        refresh = displayMode.refresh_rate;
+    }
+    mRefreshRate = refresh;
+    mRefreshCounts = mFrequency / refresh;
+    
+    // Capped mode follows the display unless told otherwise
+    if(mCappedFps == 0)
+    {
+        mCappedFps = refresh;
+    }
+    
+    mFrameStart = SDL_GetPerformanceCounter();
+    if(mMode == PRESENT_CAPPED)
+    {
+        mPacer.start(mCappedFps);
+    }
+}
+
+void LPresentPolicy::setCappedFps(int fps)
+{
+    if(fps > 0)
+    {
+        mCappedFps = fps;
+        if(mRenderer != NULL && mMode == PRESENT_CAPPED)
+        {
+            mPacer.start(mCappedFps);
+        }
+    }
+}
+
+void LPresentPolicy::handleEvent(SDL_Event& e)
+{
+    switch(e.type)
+    {
+        case SDL_KEYDOWN:
+        case SDL_KEYUP:
+        case SDL_MOUSEMOTION:
+        case SDL_MOUSEBUTTONDOWN:
+        case SDL_MOUSEBUTTONUP:
+            // Stamped on the performance counter so modes less than a millisecond apart still differ,
+            // then moved back by the time the event waited in the queue, which SDL only has in milliseconds
+            if(!mInputPending)
+            {
+                Uint32 queued = SDL_GetTicks() - e.common.timestamp;
+                mInputPending = true;
+                mInputCounts = SDL_GetPerformanceCounter() - (Uint64)queued * mFrequency / 1000;
+            }
+            break;
+    }
+}
+
+void LPresentPolicy::present()
+{
+    Uint64 work = SDL_GetPerformanceCounter() - mFrameStart;
+    
+    if(mMode == PRESENT_CAPPED)
+    {
+        mPacer.wait();
+    }
+    else if(mMode == PRESENT_ADAPTIVE)
+    {
+        if(mVSync && work > mRefreshCounts)
+        {
+            // Missed the refresh, tear instead of waiting a whole extra one
+            setVSync(false);
+            mGoodFrames = 0;
+            mPacer.start(mRefreshRate);
+            ++mVSyncDrops;
+        }
+        else if(!mVSync)
+        {
+            mGoodFrames = work < mRefreshCounts * PRESENT_RECOVER_RATIO ? mGoodFrames + 1 : 0;
+            if(mGoodFrames >= PRESENT_RECOVER_FRAMES)
+            {
+                setVSync(true);
+            }
+            else
+            {
+                // Keep to the refresh rate while vsync is off
+                mPacer.wait();
+            }
+        }
+    }
+    
+    SDL_RenderPresent( mRenderer );
+    mFrameStart = SDL_GetPerformanceCounter();
+    
+    // Present returning is as close to the display as the renderer lets us see
+    if(mInputPending)
+    {
+        Uint64 latency = (SDL_GetPerformanceCounter() - mInputCounts) * 1000000 / mFrequency;
+        mLatencyTotal[mMode] += latency;
+        if(latency > mLatencyMax[mMode])
+        {
+            mLatencyMax[mMode] = latency;
+        }
+        ++mLatencySamples[mMode];
+        mInputPending = false;
+    }
+}
+
+void LPresentPolicy::printReport()
+{
+    printf( "Input to present latency:\n" );
+    for(int i = 0; i < PRESENT_MODE_TOTAL; ++i)
+    {
+        if(mLatencySamples[i] > 0)
+        {
+            printf( "  %-8s %5d frames  avg %.2f ms  max %.2f ms\n", getModeName((PresentMode)i), mLatencySamples[i],
+                    (double)mLatencyTotal[i] / mLatencySamples[i] / 1000.0, mLatencyMax[i] / 1000.0 );
+        }
+    }
+    if(mVSyncDrops > 0)
+    {
+        printf( "  adaptive dropped vsync %d times\n", mVSyncDrops );
+    }
+    if(mPacer.getLateFrames() > 0)
+    {
+        printf( "  paced frames late %d times, resynced %d times\n", mPacer.getLateFrames(), mPacer.getResyncs() );
+    }
+}
+
+void LPresentPolicy::setVSync(bool enabled)
+{
+    if(mRenderer == NULL)
+    {
+        mVSync = enabled;
+        return;
+    }
+    if(enabled == mVSync)
+    {
+        return;
+    }
+    
+    if(SDL_RenderSetVSync(mRenderer, enabled ? 1 : 0) != 0)
+    {
+        printf( "Unable to change vsync! SDL Error: %s\n", SDL_GetError() );
+    }
+    else
+    {
+        mVSync = enabled;
+    }
+}
+/**************************************************************************/
+
+/***************************************************************************
+ Function Definitions
+ ***************************************************************************/
+
+SDL_BlendMode getPremultipliedBlendMode()
+{
+    // dst = src + dst * (1 - srcA), for color and alpha alike
+    return SDL_ComposeCustomBlendMode(SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA,
+                                      SDL_BLENDOPERATION_ADD,
+                                      SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA,
+                                      SDL_BLENDOPERATION_ADD);
+}
+
+Uint8 mulDiv255(Uint8 a, Uint8 b)
+{
+    // Rounded a * b / 255
+    Uint32 t = (Uint32)a * b + 128;
+    return (Uint8)((t + (t >> 8)) >> 8);
+}
+
+SDL_Surface* premultiplySurface(SDL_Surface* surface)
+{
+    // Converting turns the color key into zero alpha
+    SDL_Surface* formattedSurface = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_ARGB8888, 0);
+    if( formattedSurface == nullptr )
+    {
+        return nullptr;
+    }
+
+    SDL_LockSurface(formattedSurface);
+    for( int y = 0; y < formattedSurface->h; ++y )
+    {
+        Uint32* row = (Uint32*)((Uint8*)formattedSurface->pixels + y * formattedSurface->pitch);
+        for( int x = 0; x < formattedSurface->w; ++x )
+        {
+            Uint32 pixel = row[x];
+            Uint8 a = pixel >> 24;
+            if( a == 0xff )
+            {
+                continue;
+            }
+            Uint8 r = mulDiv255((pixel >> 16) & 0xff, a);
+            Uint8 g = mulDiv255((pixel >> 8) & 0xff, a);
+            Uint8 b = mulDiv255(pixel & 0xff, a);
+            row[x] = ((Uint32)a << 24) | ((Uint32)r << 16) | ((Uint32)g << 8) | b;
+        }
+    }
+    SDL_UnlockSurface(formattedSurface);
+
+    return formattedSurface;
+}
+
+bool init()
+{
+    //Initialization flag
+    bool success = true;
+    
+    //Initialize SDL
+    if( SDL_Init( SDL_INIT_VIDEO ) < 0 )
+    {
+        printf( "SDL could not initialize! SDL Error: %s\n", SDL_GetError() );
+        success = false;
+    }
+    else
+    {
+        //Set texture filtering to linear
+        if( !SDL_SetHint( SDL_HINT_RENDER_SCALE_QUALITY, "1" ) )
+        {
+            printf( "Warning: Linear texture filtering not enabled!" );
+        }
+        
+        //Create window
+        gWindow = SDL_CreateWindow( "SDL Tutorial", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_SHOWN );
+        if( gWindow == NULL )
+        {
+            printf( "Window could not be created! SDL Error: %s\n", SDL_GetError() );
+            success = false;
+        }
+        else
+        {
+            //Create renderer for window
+            gRenderer = SDL_CreateRenderer( gWindow, -1, gPresentPolicy.getRendererFlags() );
+            if( gRenderer == NULL )
+            {
+                printf( "Renderer could not be created! SDL Error: %s\n", SDL_GetError() );
+                success = false;
+            }
+            else
+            {
+                // Presenting goes through the policy from here on
+                gPresentPolicy.attach(gWindow, gRenderer);
+                
+                //Initialize renderer color
+                SDL_SetRenderDrawColor( gRenderer, 0xFF, 0xFF, 0xFF, 0xFF );
+                
+                //Initialize PNG loading
+                int imgFlags = IMG_INIT_PNG;
+                if( !( IMG_Init( imgFlags ) & imgFlags ) )
+                {
+                    printf( "SDL_image could not initialize! SDL_image Error: %s\n", IMG_GetError() );
+                    success = false;
+                }
+#ifdef _SDL_TTF_H
+                // Initialize SDL_ttf
+                if( TTF_Init() == -1 )
+                {
+                    std::cout << "SDL_ttf could not initialize! SDL_ttf Error: " << SDL_GetError() ;
+                    success = false;
+                }
+#endif
+            }
+        }
+    }
+    SDL_SetWindowFullscreen(gWindow, SDL_WINDOW_FULLSCREEN);
+    return success;
+}
+
+bool loadMedia(Tile* tiles[])
+{
+    // Loading success flag
+    bool success = true;
+
+    
+    if(!gDotTexture.loadFromFile("39_tiling/dot.bmp", true))
+    {
+        std::cout << "Failed to load dot texture." << std::endl;
+        success = false;
+    }
+    
+    if(!gEnemyTexture.loadFromFile("39_tiling/enemy.png", true))
+    {
+        std::cout << "Failed to load dot texture." << std::endl;
+        success = false;
+    }
+    
+    if(!gTileTexture.loadFromFile("39_tiling/tiles.png", true))
+    {
+        std::cout << "Failed to load dot texture." << std::endl;
+        success = false;
+    }
+    
+    if(!gOverlayFont.buildFont("39_tiling/lazyfont.png"))
+    {
+        std::cout << "Failed to load overlay font." << std::endl;
+        success = false;
+    }
+    
+    // Load tile map
+    if(!setTiles(tiles))
+    {
+        std::cout << "Failed to load tile set!" << std::endl;
+        success = false;
+    }
+    return success;
+}
+
+
+bool setTiles(Tile* tiles[])
+{
+    // Success flag
+    bool tilesLoaded = true;
+    
+    // the tile offsets
+    int x = 0, y = 0;
+    
+    // Open the map
+    std::ifstream map("39_tiling/lazy.map");
+    if(!map.is_open())
+    {
+        std::cout << "Unable to load map file!" << std::endl;
         tilesLoaded = false;
     }
     else
@@ -955,6 +2115,7 @@ void close( Tile* tiles[] )
     //Free loaded images
     gDotTexture.free();
     gTileTexture.free();
+    gOverlayFont.free();
     
     //Destroy window
     SDL_DestroyRenderer( gRenderer );
@@ -977,6 +2138,12 @@ int main( int argc, char* args[] )
     
     bool gameover = false;
     
+    // Vsync unless a present mode is given on the command line
+    if( argc > 1 && !gPresentPolicy.setModeByName(args[1]) )
+    {
+        printf( "Unknown present mode %s, using %s\n", args[1], gPresentPolicy.getModeName(gPresentPolicy.getMode()) );
+    }
+    
     //Start up SDL and create window
     if( !init() )
     {
@@ -1025,35 +2192,65 @@ int main( int argc, char* args[] )
             //While application is running
             while( !quit && !gameover )
             {
+                gProfiler.beginFrame();
+                
                 healthBar.updatePosition(camera);
                 
                 backgroundBar.updatePosition(camera);
                 
-                //Handle events on queue
-                while( SDL_PollEvent( &e ) != 0 )
                 {
-                    //User requests quit
-                    if( e.type == SDL_QUIT )
+                    LProfileScope zone(gProfiler, "events");
+                    
+                    //Handle events on queue
+                    while( SDL_PollEvent( &e ) != 0 )
                     {
-                        quit = true;
+                        //User requests quit
+                        if( e.type == SDL_QUIT )
+                        {
+                            quit = true;
+                        }
+                        // Profiler overlay and trace export
+                        else if( e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_p )
+                        {
+                            gProfiler.toggleOverlay();
+                        }
+                        else if( e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_t )
+                        {
+                            gProfiler.exportTrace("frame_trace.json");
+                        }
+                        // Number keys switch present mode
+                        else if( e.type == SDL_KEYDOWN && e.key.keysym.sym >= SDLK_1 && e.key.keysym.sym < SDLK_1 + PRESENT_MODE_TOTAL )
+                        {
+                            gPresentPolicy.setMode((PresentMode)(e.key.keysym.sym - SDLK_1));
+                        }
+                        gPresentPolicy.handleEvent(e);
+                        
+                        // Handle input for the dot
+                        dot.handleEvent(e);
                     }
-                    // Handle input for the dot
-                    dot.handleEvent(e);
                 }
                 
-                // Move the dot anc check Collision
-                dot.move(tileSet);
-                
-                for(auto i = 0; i < TOTAL_ENEMIES; ++i)
                 {
-                    enemies[i]->move(tileSet);
-                    if(checkCollision(dot.getBox(), enemies[i]->getBox()))
+                    LProfileScope zone(gProfiler, "update");
+                    
+                    // Move the dot anc check Collision
                     {
-                        dot.updateHealth(1);
-                        healthBar.updateWidth(1);
-                        if(dot.getHealth() <= 0)
+                        LProfileScope dotZone(gProfiler, "dot");
+                        dot.move(tileSet);
+                    }
+                    
+                    LProfileScope enemyZone(gProfiler, "enemies");
+                    for(auto i = 0; i < TOTAL_ENEMIES; ++i)
+                    {
+                        enemies[i]->move(tileSet);
+                        if(checkCollision(dot.getBox(), enemies[i]->getBox()))
                         {
-                            gameover = true;
+                            dot.updateHealth(1);
+                            healthBar.updateWidth(1);
+                            if(dot.getHealth() <= 0)
+                            {
+                                gameover = true;
+                            }
                         }
                     }
                 }
@@ -1061,32 +2258,50 @@ int main( int argc, char* args[] )
                 
                 dot.setCamera(camera);
                 
-                
-                //Clear screen
-                SDL_SetRenderDrawColor( gRenderer, 0xff, 0xff, 0xff, 0xff );
-                SDL_RenderClear( gRenderer );
-                SDL_SetRenderDrawBlendMode(gRenderer, SDL_BLENDMODE_BLEND);
-                // render level
-                for(auto i = 0; i < TOTAL_TILES; ++i)
                 {
-                    tileSet[i]->render(camera);
+                    LProfileScope zone(gProfiler, "render");
+                    
+                    //Clear screen
+                    SDL_SetRenderDrawColor( gRenderer, 0xff, 0xff, 0xff, 0xff );
+                    SDL_RenderClear( gRenderer );
+                    SDL_SetRenderDrawBlendMode(gRenderer, SDL_BLENDMODE_BLEND);
+                    // render level
+                    {
+                        LProfileScope tileZone(gProfiler, "tiles");
+                        for(auto i = 0; i < TOTAL_TILES; ++i)
+                        {
+                            tileSet[i]->render(camera);
+                        }
+                    }
+                    
+                    // Render objects
+                    {
+                        LProfileScope objectZone(gProfiler, "objects");
+                        dot.render(camera);
+                        for(auto i = 0; i < TOTAL_ENEMIES; ++i)
+                        {
+                            enemies[i]->render(camera);
+                        }
+                    }
+                    
+                    
+                    backgroundBar.render();
+                    healthBar.render();
+                    
+                    {
+                        LProfileScope overlayZone(gProfiler, "overlay");
+                        gProfiler.renderOverlay(gOverlayFont, 10, 50);
+                    }
                 }
                 
-                // Render objects
-                dot.render(camera);
-                for(auto i = 0; i < TOTAL_ENEMIES; ++i)
                 {
-                    enemies[i]->render(camera);
+                    LProfileScope zone(gProfiler, "present");
+                    
+                    //Update screen
+                    gPresentPolicy.present();
                 }
                 
-                
-                backgroundBar.render();
-                healthBar.render();
-                
-                //Update screen
-                SDL_RenderPresent( gRenderer );
-                
-                
+                gProfiler.endFrame();
             }
             for(auto i = 0; i < TOTAL_ENEMIES; ++i)
             {
@@ -1100,6 +2315,8 @@ int main( int argc, char* args[] )
         std::cout << "Game Over." << std::endl;
     }
     
+    gPresentPolicy.printReport();
+    
     close(tileSet);
     
     return 0;
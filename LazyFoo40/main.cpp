@@ -10,9 +10,22 @@
 #include <cstdlib>
 #include <cstring>
 #include <memory>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
 #include <SDL.h>
 #include <SDL_image.h>
 
+// Pick the widest pixel kernels the compiler was told it can use
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define PIXEL_KERNELS_AVX2
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PIXEL_KERNELS_SSE2
+#endif
+
 
 
 /**********************************************************************
@@ -22,6 +35,23 @@ const int SCREEN_WIDTH = 640;
 const int SCREEN_HEIGHT = 480;
 const int TOTAL_PARTICLES = 20;
 
+// Preprocessed texture cache file layout, magic is "LTXC"
+const Uint32 TEXTURE_CACHE_MAGIC = 0x4358544c;
+const int TEXTURE_CACHE_HEADER_SIZE = 64;
+
+// Bump when the way cached pixels are produced changes
+const int TEXTURE_CACHE_VERSION = 1;
+
+// Color made transparent by the manual color key
+const Uint8 COLOR_KEY_RED = 0x00;
+const Uint8 COLOR_KEY_GREEN = 0xff;
+const Uint8 COLOR_KEY_BLUE = 0xff;
+
+// Pixel kernel self test buffer, a 4K frame with padded rows
+const int KERNEL_TEST_WIDTH = 3840;
+const int KERNEL_TEST_HEIGHT = 2160;
+const int KERNEL_TEST_PADDING = 16;
+
 /*********************************************************************/
 
 
@@ -75,6 +105,12 @@ public:
     int getPitch();
 
 private:
+    // Loads final pixels saved by an earlier run, if the source hasn't changed since
+    bool loadFromCache(std::string path, Uint32 format, Uint32 processing);
+
+    // Saves the locked pixels so later runs can skip decoding and processing
+    void saveToCache(std::string path, Uint32 format, Uint32 processing);
+
     // The actual hardware texture
     SDL_Texture* mTexture;
     void* mPixels;
@@ -86,6 +122,37 @@ private:
 
 /*********************************************************************/
 
+/**************************************************************************
+ Pixel Kernel Self Test
+ **************************************************************************/
+enum PixelKernel
+{
+    KERNEL_COLOR_KEY,
+    KERNEL_TINT,
+    KERNEL_PREMULTIPLY,
+    KERNEL_SWIZZLE
+};
+
+// One self test case and the arguments its kernel gets
+struct KernelTest
+{
+    const char* name;
+    PixelKernel kernel;
+
+    // Color key, tint or alpha shift
+    Uint32 value;
+
+    // Color keyed pixels become this
+    Uint32 transparent;
+
+    // Swizzle formats
+    Uint32 srcFormat;
+    Uint32 dstFormat;
+};
+
+/*********************************************************************/
+
+
 /**********************************************************************
  Globals
  **********************************************************************/
@@ -113,6 +180,21 @@ bool loadMedia();
 
 void close();
 
+// Pixel kernels, these work on locked 32 bit pixels a row at a time using the pitch
+void colorKeyPixels(void* pixels, int pitch, int width, int height, Uint32 colorKey, Uint32 transparent);
+
+// Describes the processing baked into cached pixels so a change invalidates old caches
+Uint32 getCacheProcessing(bool colorKeyed);
+
+void tintPixels(void* pixels, int pitch, int width, int height, Uint32 tint);
+
+void premultiplyPixels(void* pixels, int pitch, int width, int height, int alphaShift);
+
+bool swizzlePixels(void* pixels, int pitch, int width, int height, Uint32 srcFormat, Uint32 dstFormat);
+
+// Checks every kernel against a per pixel reference and prints timings, true if they all match
+bool runKernelSelftest();
+
 /************************************************************************/
 
 
@@ -140,6 +222,12 @@ bool LTexture::loadFromFile(std::string path)
     // Get rid of pre-existing texture
     free();
 
+    // Warm start from the already converted pixels
+    if(loadFromCache(path, SDL_GetWindowPixelFormat(gWindow), getCacheProcessing(false)))
+    {
+        return true;
+    }
+
     //The final texture
     SDL_Texture* newTexture = nullptr;
 
@@ -175,13 +263,16 @@ bool LTexture::loadFromFile(std::string path)
                 // Copy loaded/formatted surface pixels
                 memcpy(mPixels, formattedSurface->pixels, formattedSurface->pitch * formattedSurface->h);
 
-                // Unlock texture to update
-                SDL_UnlockTexture(newTexture);
-                mPixels = NULL;
-
                 // Get image dimensions
                 mWidth = formattedSurface->w;
                 mHeight = formattedSurface->h;
+
+                // Save the converted pixels for next time
+                saveToCache(path, SDL_GetWindowPixelFormat(gWindow), getCacheProcessing(false));
+
+                // Unlock texture to update
+                SDL_UnlockTexture(newTexture);
+                mPixels = NULL;
             }
 
             // Get rid of old formatted surface
@@ -195,6 +286,113 @@ bool LTexture::loadFromFile(std::string path)
     return mTexture != NULL;
 }
 
+bool LTexture::loadFromCache(std::string path, Uint32 format, Uint32 processing)
+{
+    // Cache is only good for the exact version of the source on disk
+    struct stat sourceInfo;
+    if(stat(path.c_str(), &sourceInfo) != 0)
+    {
+        return false;
+    }
+
+    SDL_RWops* file = SDL_RWFromFile((path + ".cache").c_str(), "rb");
+    if(file == nullptr)
+    {
+        return false;
+    }
+
+    // Check the header matches the source and processing
+    bool success = false;
+    Uint32 magic = SDL_ReadLE32(file);
+    Sint64 modified = (Sint64)SDL_ReadLE64(file);
+    Uint32 cachedFormat = SDL_ReadLE32(file);
+    Uint32 cachedProcessing = SDL_ReadLE32(file);
+    int width = SDL_ReadLE32(file);
+    int height = SDL_ReadLE32(file);
+    int bytesPerPixel = SDL_BYTESPERPIXEL(format);
+
+    if(magic == TEXTURE_CACHE_MAGIC && modified == (Sint64)sourceInfo.st_mtime &&
+       cachedFormat == format && cachedProcessing == processing && width > 0 && height > 0 &&
+       SDL_RWsize(file) == TEXTURE_CACHE_HEADER_SIZE + (Sint64)width * height * bytesPerPixel)
+    {
+        // Create blank streamable texture
+        SDL_Texture* newTexture = SDL_CreateTexture(gRenderer, format, SDL_TEXTUREACCESS_STREAMING, width, height);
+        if(newTexture != nullptr && SDL_LockTexture(newTexture, NULL, &mPixels, &mPitch) == 0)
+        {
+            // Read the rows straight into the texture
+            SDL_RWseek(file, TEXTURE_CACHE_HEADER_SIZE, RW_SEEK_SET);
+
+            success = true;
+            for(int row = 0; row < height && success; ++row)
+            {
+                success = SDL_RWread(file, (Uint8*)mPixels + row * mPitch, width * bytesPerPixel, 1) == 1;
+            }
+
+            SDL_UnlockTexture(newTexture);
+            mPixels = NULL;
+
+            if(success)
+            {
+                mTexture = newTexture;
+                mWidth = width;
+                mHeight = height;
+            }
+            else
+            {
+                SDL_DestroyTexture(newTexture);
+            }
+        }
+        else if(newTexture != nullptr)
+        {
+            std::cout << "Unable to lock cached texture! SDL Error: " << SDL_GetError() << std::endl;
+            SDL_DestroyTexture(newTexture);
+        }
+    }
+
+    SDL_RWclose(file);
+    return success;
+}
+
+void LTexture::saveToCache(std::string path, Uint32 format, Uint32 processing)
+{
+    struct stat sourceInfo;
+    if(stat(path.c_str(), &sourceInfo) != 0 || mPixels == NULL)
+    {
+        return;
+    }
+
+    SDL_RWops* file = SDL_RWFromFile((path + ".cache").c_str(), "wb");
+    if(file == nullptr)
+    {
+        std::cout << "Unable to write texture cache for " << path << "! SDL Error: " << SDL_GetError() << std::endl;
+        return;
+    }
+
+    // Header
+    SDL_WriteLE32(file, TEXTURE_CACHE_MAGIC);
+    SDL_WriteLE64(file, (Uint64)sourceInfo.st_mtime);
+    SDL_WriteLE32(file, format);
+    SDL_WriteLE32(file, processing);
+    SDL_WriteLE32(file, mWidth);
+    SDL_WriteLE32(file, mHeight);
+
+    // Pad the header so the pixels start aligned and can be mapped as is
+    while(SDL_RWseek(file, 0, RW_SEEK_CUR) < TEXTURE_CACHE_HEADER_SIZE)
+    {
+        Uint8 zero = 0;
+        SDL_RWwrite(file, &zero, 1, 1);
+    }
+
+    // Tightly packed rows of final pixels
+    int bytesPerPixel = SDL_BYTESPERPIXEL(format);
+    for(int row = 0; row < mHeight; ++row)
+    {
+        SDL_RWwrite(file, (Uint8*)mPixels + row * mPitch, mWidth * bytesPerPixel, 1);
+    }
+
+    SDL_RWclose(file);
+}
+
 void LTexture::free()
 {
     // Free texture if it exists
@@ -340,6 +538,432 @@ int LTexture::getPitch()
 }
 /**************************************************************************/
 
+/***************************************************************************
+ Pixel Kernels
+***************************************************************************/
+
+// Multiplies two bytes as if they were 0 to 1, rounding like the SIMD versions
+inline Uint32 mulDiv255(Uint32 a, Uint32 b)
+{
+    Uint32 x = a * b + 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+// Multiplies each byte of a pixel by the matching byte of the factor
+inline Uint32 mulPixel(Uint32 pixel, Uint32 factor)
+{
+    Uint32 result = 0;
+    for(int shift = 0; shift < 32; shift += 8)
+    {
+        result |= mulDiv255((pixel >> shift) & 0xff, (factor >> shift) & 0xff) << shift;
+    }
+    return result;
+}
+
+// Spreads the alpha byte over the color bytes, leaving the alpha factor at 0xff
+inline Uint32 alphaFactor(Uint32 pixel, int alphaShift)
+{
+    Uint32 alpha = (pixel >> alphaShift) & 0xff;
+    return (alpha * 0x01010101) | (0xffu << alphaShift);
+}
+
+#ifdef PIXEL_KERNELS_SSE2
+inline __m128i mulDiv255SSE2(__m128i a, __m128i b)
+{
+    __m128i x = _mm_add_epi16(_mm_mullo_epi16(a, b), _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+// Four pixels at a time
+inline __m128i mulPixelsSSE2(__m128i pixels, __m128i factors)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i low = mulDiv255SSE2(_mm_unpacklo_epi8(pixels, zero), _mm_unpacklo_epi8(factors, zero));
+    __m128i high = mulDiv255SSE2(_mm_unpackhi_epi8(pixels, zero), _mm_unpackhi_epi8(factors, zero));
+    return _mm_packus_epi16(low, high);
+}
+
+inline __m128i alphaFactorsSSE2(__m128i pixels, int alphaShift)
+{
+    __m128i alpha = _mm_and_si128(_mm_srl_epi32(pixels, _mm_cvtsi32_si128(alphaShift)), _mm_set1_epi32(0xff));
+    __m128i spread = _mm_or_si128(_mm_or_si128(alpha, _mm_slli_epi32(alpha, 8)),
+                                  _mm_or_si128(_mm_slli_epi32(alpha, 16), _mm_slli_epi32(alpha, 24)));
+    return _mm_or_si128(spread, _mm_set1_epi32((int)(0xffu << alphaShift)));
+}
+#endif
+
+#ifdef PIXEL_KERNELS_AVX2
+inline __m256i mulDiv255AVX2(__m256i a, __m256i b)
+{
+    __m256i x = _mm256_add_epi16(_mm256_mullo_epi16(a, b), _mm256_set1_epi16(128));
+    return _mm256_srli_epi16(_mm256_add_epi16(x, _mm256_srli_epi16(x, 8)), 8);
+}
+
+// Eight pixels at a time, the unpacks and pack stay within 128 bit lanes so order is kept
+inline __m256i mulPixelsAVX2(__m256i pixels, __m256i factors)
+{
+    __m256i zero = _mm256_setzero_si256();
+    __m256i low = mulDiv255AVX2(_mm256_unpacklo_epi8(pixels, zero), _mm256_unpacklo_epi8(factors, zero));
+    __m256i high = mulDiv255AVX2(_mm256_unpackhi_epi8(pixels, zero), _mm256_unpackhi_epi8(factors, zero));
+    return _mm256_packus_epi16(low, high);
+}
+
+inline __m256i alphaFactorsAVX2(__m256i pixels, int alphaShift)
+{
+    __m256i alpha = _mm256_and_si256(_mm256_srl_epi32(pixels, _mm_cvtsi32_si128(alphaShift)), _mm256_set1_epi32(0xff));
+    __m256i spread = _mm256_or_si256(_mm256_or_si256(alpha, _mm256_slli_epi32(alpha, 8)),
+                                     _mm256_or_si256(_mm256_slli_epi32(alpha, 16), _mm256_slli_epi32(alpha, 24)));
+    return _mm256_or_si256(spread, _mm256_set1_epi32((int)(0xffu << alphaShift)));
+}
+#endif
+
+Uint32 getCacheProcessing(bool colorKeyed)
+{
+    // Version in the top bits, then whether the key was applied and its color
+    Uint32 processing = (Uint32)TEXTURE_CACHE_VERSION << 25;
+    if(colorKeyed)
+    {
+        processing |= 1u << 24 | (Uint32)COLOR_KEY_RED << 16 | (Uint32)COLOR_KEY_GREEN << 8 | COLOR_KEY_BLUE;
+    }
+    return processing;
+}
+
+void colorKeyPixels(void* pixels, int pitch, int width, int height, Uint32 colorKey, Uint32 transparent)
+{
+    // Go through the rows
+    for(int y = 0; y < height; ++y)
+    {
+        Uint32* row = (Uint32*)((Uint8*)pixels + y * pitch);
+        int x = 0;
+
+#ifdef PIXEL_KERNELS_AVX2
+        __m256i key8 = _mm256_set1_epi32((int)colorKey);
+        __m256i transparent8 = _mm256_set1_epi32((int)transparent);
+        for(; x + 8 <= width; x += 8)
+        {
+            __m256i block = _mm256_loadu_si256((__m256i*)(row + x));
+            __m256i mask = _mm256_cmpeq_epi32(block, key8);
+            _mm256_storeu_si256((__m256i*)(row + x), _mm256_blendv_epi8(block, transparent8, mask));
+        }
+#endif
+#ifdef PIXEL_KERNELS_SSE2
+        __m128i key4 = _mm_set1_epi32((int)colorKey);
+        __m128i transparent4 = _mm_set1_epi32((int)transparent);
+        for(; x + 4 <= width; x += 4)
+        {
+            __m128i block = _mm_loadu_si128((__m128i*)(row + x));
+            __m128i mask = _mm_cmpeq_epi32(block, key4);
+            _mm_storeu_si128((__m128i*)(row + x), _mm_or_si128(_mm_and_si128(mask, transparent4), _mm_andnot_si128(mask, block)));
+        }
+#endif
+        // Leftover pixels
+        for(; x < width; ++x)
+        {
+            if(row[x] == colorKey)
+            {
+                row[x] = transparent;
+            }
+        }
+    }
+}
+
+void tintPixels(void* pixels, int pitch, int width, int height, Uint32 tint)
+{
+    // Go through the rows
+    for(int y = 0; y < height; ++y)
+    {
+        Uint32* row = (Uint32*)((Uint8*)pixels + y * pitch);
+        int x = 0;
+
+#ifdef PIXEL_KERNELS_AVX2
+        __m256i tint8 = _mm256_set1_epi32((int)tint);
+        for(; x + 8 <= width; x += 8)
+        {
+            __m256i block = _mm256_loadu_si256((__m256i*)(row + x));
+            _mm256_storeu_si256((__m256i*)(row + x), mulPixelsAVX2(block, tint8));
+        }
+#endif
+#ifdef PIXEL_KERNELS_SSE2
+        __m128i tint4 = _mm_set1_epi32((int)tint);
+        for(; x + 4 <= width; x += 4)
+        {
+            __m128i block = _mm_loadu_si128((__m128i*)(row + x));
+            _mm_storeu_si128((__m128i*)(row + x), mulPixelsSSE2(block, tint4));
+        }
+#endif
+        // Leftover pixels
+        for(; x < width; ++x)
+        {
+            row[x] = mulPixel(row[x], tint);
+        }
+    }
+}
+
+void premultiplyPixels(void* pixels, int pitch, int width, int height, int alphaShift)
+{
+    // Go through the rows
+    for(int y = 0; y < height; ++y)
+    {
+        Uint32* row = (Uint32*)((Uint8*)pixels + y * pitch);
+        int x = 0;
+
+#ifdef PIXEL_KERNELS_AVX2
+        for(; x + 8 <= width; x += 8)
+        {
+            __m256i block = _mm256_loadu_si256((__m256i*)(row + x));
+            _mm256_storeu_si256((__m256i*)(row + x), mulPixelsAVX2(block, alphaFactorsAVX2(block, alphaShift)));
+        }
+#endif
+#ifdef PIXEL_KERNELS_SSE2
+        for(; x + 4 <= width; x += 4)
+        {
+            __m128i block = _mm_loadu_si128((__m128i*)(row + x));
+            _mm_storeu_si128((__m128i*)(row + x), mulPixelsSSE2(block, alphaFactorsSSE2(block, alphaShift)));
+        }
+#endif
+        // Leftover pixels
+        for(; x < width; ++x)
+        {
+            row[x] = mulPixel(row[x], alphaFactor(row[x], alphaShift));
+        }
+    }
+}
+
+bool swizzlePixels(void* pixels, int pitch, int width, int height, Uint32 srcFormat, Uint32 dstFormat)
+{
+    // How far to rotate each pixel right, or -1 to reverse the bytes
+    int rotate = 0;
+    if((srcFormat == SDL_PIXELFORMAT_RGBA8888 && dstFormat == SDL_PIXELFORMAT_ARGB8888) ||
+       (srcFormat == SDL_PIXELFORMAT_BGRA8888 && dstFormat == SDL_PIXELFORMAT_ABGR8888))
+    {
+        rotate = 8;
+    }
+    else if((srcFormat == SDL_PIXELFORMAT_ARGB8888 && dstFormat == SDL_PIXELFORMAT_RGBA8888) ||
+            (srcFormat == SDL_PIXELFORMAT_ABGR8888 && dstFormat == SDL_PIXELFORMAT_BGRA8888))
+    {
+        rotate = 24;
+    }
+    else if((srcFormat == SDL_PIXELFORMAT_RGBA8888 && dstFormat == SDL_PIXELFORMAT_ABGR8888) ||
+            (srcFormat == SDL_PIXELFORMAT_ABGR8888 && dstFormat == SDL_PIXELFORMAT_RGBA8888) ||
+            (srcFormat == SDL_PIXELFORMAT_ARGB8888 && dstFormat == SDL_PIXELFORMAT_BGRA8888) ||
+            (srcFormat == SDL_PIXELFORMAT_BGRA8888 && dstFormat == SDL_PIXELFORMAT_ARGB8888))
+    {
+        rotate = -1;
+    }
+    else if(srcFormat != dstFormat)
+    {
+        std::cout << "Unsupported pixel swizzle!" << std::endl;
+        return false;
+    }
+    else
+    {
+        // Nothing to do
+        return true;
+    }
+
+    // Go through the rows
+    for(int y = 0; y < height; ++y)
+    {
+        Uint32* row = (Uint32*)((Uint8*)pixels + y * pitch);
+        int x = 0;
+
+#ifdef PIXEL_KERNELS_AVX2
+        __m256i middle8 = _mm256_set1_epi32(0x00ff0000);
+        __m256i inner8 = _mm256_set1_epi32(0x0000ff00);
+        __m128i right8 = _mm_cvtsi32_si128(rotate);
+        __m128i left8 = _mm_cvtsi32_si128(32 - rotate);
+        for(; x + 8 <= width; x += 8)
+        {
+            __m256i block = _mm256_loadu_si256((__m256i*)(row + x));
+            if(rotate < 0)
+            {
+                block = _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi32(block, 24), _mm256_srli_epi32(block, 24)),
+                                        _mm256_or_si256(_mm256_and_si256(_mm256_slli_epi32(block, 8), middle8),
+                                                        _mm256_and_si256(_mm256_srli_epi32(block, 8), inner8)));
+            }
+            else
+            {
+                block = _mm256_or_si256(_mm256_srl_epi32(block, right8), _mm256_sll_epi32(block, left8));
+            }
+            _mm256_storeu_si256((__m256i*)(row + x), block);
+        }
+#endif
+#ifdef PIXEL_KERNELS_SSE2
+        __m128i middle4 = _mm_set1_epi32(0x00ff0000);
+        __m128i inner4 = _mm_set1_epi32(0x0000ff00);
+        __m128i right4 = _mm_cvtsi32_si128(rotate);
+        __m128i left4 = _mm_cvtsi32_si128(32 - rotate);
+        for(; x + 4 <= width; x += 4)
+        {
+            __m128i block = _mm_loadu_si128((__m128i*)(row + x));
+            if(rotate < 0)
+            {
+                block = _mm_or_si128(_mm_or_si128(_mm_slli_epi32(block, 24), _mm_srli_epi32(block, 24)),
+                                     _mm_or_si128(_mm_and_si128(_mm_slli_epi32(block, 8), middle4),
+                                                  _mm_and_si128(_mm_srli_epi32(block, 8), inner4)));
+            }
+            else
+            {
+                block = _mm_or_si128(_mm_srl_epi32(block, right4), _mm_sll_epi32(block, left4));
+            }
+            _mm_storeu_si128((__m128i*)(row + x), block);
+        }
+#endif
+        // Leftover pixels
+        for(; x < width; ++x)
+        {
+            Uint32 pixel = row[x];
+            if(rotate < 0)
+            {
+                row[x] = (pixel << 24) | ((pixel << 8) & 0x00ff0000) | ((pixel >> 8) & 0x0000ff00) | (pixel >> 24);
+            }
+            else
+            {
+                row[x] = (pixel >> rotate) | (pixel << (32 - rotate));
+            }
+        }
+    }
+    return true;
+}
+
+// Where each channel sits in a 32 bit format, red, green, blue then alpha
+void getChannelShifts(Uint32 format, int shifts[4])
+{
+    switch(format)
+    {
+        case SDL_PIXELFORMAT_RGBA8888: shifts[0] = 24; shifts[1] = 16; shifts[2] = 8; shifts[3] = 0; break;
+        case SDL_PIXELFORMAT_ARGB8888: shifts[0] = 16; shifts[1] = 8; shifts[2] = 0; shifts[3] = 24; break;
+        case SDL_PIXELFORMAT_ABGR8888: shifts[0] = 0; shifts[1] = 8; shifts[2] = 16; shifts[3] = 24; break;
+        default: shifts[0] = 8; shifts[1] = 16; shifts[2] = 24; shifts[3] = 0; break;
+    }
+}
+
+// Per pixel reference result, written out plainly so it shares no code with the kernels
+Uint32 referencePixel(const KernelTest& test, Uint32 pixel)
+{
+    Uint32 result = 0;
+    switch(test.kernel)
+    {
+        case KERNEL_COLOR_KEY:
+            result = pixel == test.value ? test.transparent : pixel;
+            break;
+
+        case KERNEL_TINT:
+            for(int c = 0; c < 32; c += 8)
+            {
+                result |= ((((pixel >> c) & 0xff) * ((test.value >> c) & 0xff) + 127) / 255) << c;
+            }
+            break;
+
+        case KERNEL_PREMULTIPLY:
+            for(int c = 0; c < 32; c += 8)
+            {
+                Uint32 byte = (pixel >> c) & 0xff;
+                result |= ((Uint32)c == test.value ? byte : (byte * ((pixel >> test.value) & 0xff) + 127) / 255) << c;
+            }
+            break;
+
+        case KERNEL_SWIZZLE:
+        {
+            int srcShifts[4];
+            int dstShifts[4];
+            getChannelShifts(test.srcFormat, srcShifts);
+            getChannelShifts(test.dstFormat, dstShifts);
+            for(int c = 0; c < 4; ++c)
+            {
+                result |= ((pixel >> srcShifts[c]) & 0xff) << dstShifts[c];
+            }
+            break;
+        }
+    }
+    return result;
+}
+
+void runKernel(const KernelTest& test, Uint32* pixels, int pitch, int width, int height)
+{
+    switch(test.kernel)
+    {
+        case KERNEL_COLOR_KEY: colorKeyPixels(pixels, pitch, width, height, test.value, test.transparent); break;
+        case KERNEL_TINT: tintPixels(pixels, pitch, width, height, test.value); break;
+        case KERNEL_PREMULTIPLY: premultiplyPixels(pixels, pitch, width, height, test.value); break;
+        case KERNEL_SWIZZLE: swizzlePixels(pixels, pitch, width, height, test.srcFormat, test.dstFormat); break;
+    }
+}
+
+bool runKernelSelftest()
+{
+#if defined(PIXEL_KERNELS_AVX2)
+    const char* path = "AVX2";
+#elif defined(PIXEL_KERNELS_SSE2)
+    const char* path = "SSE2";
+#else
+    const char* path = "scalar";
+#endif
+    std::cout << "Pixel kernel self test, " << path << " path, " << KERNEL_TEST_WIDTH << "x" << KERNEL_TEST_HEIGHT
+              << " with " << KERNEL_TEST_PADDING << " pixels of row padding" << std::endl;
+
+    // Random pixels with some color key hits, the padding gets a marker that must survive
+    int stride = KERNEL_TEST_WIDTH + KERNEL_TEST_PADDING;
+    int pitch = stride * 4;
+    std::vector<Uint32> source(stride * KERNEL_TEST_HEIGHT);
+    Uint32 seed = 12345;
+    for(std::size_t i = 0; i < source.size(); ++i)
+    {
+        seed = seed * 1664525 + 1013904223;
+        if((int)(i % stride) >= KERNEL_TEST_WIDTH)
+        {
+            source[i] = 0xdeadbeef;
+        }
+        else
+        {
+            source[i] = (seed >> 28) == 0 ? 0x00ffffff : seed;
+        }
+    }
+
+    const KernelTest tests[] =
+    {
+        { "color key", KERNEL_COLOR_KEY, 0x00ffffff, 0, 0, 0 },
+        { "tint", KERNEL_TINT, 0x80ff40c0, 0, 0, 0 },
+        { "premultiply", KERNEL_PREMULTIPLY, 24, 0, 0, 0 },
+        { "swizzle RGBA to ARGB", KERNEL_SWIZZLE, 0, 0, SDL_PIXELFORMAT_RGBA8888, SDL_PIXELFORMAT_ARGB8888 },
+        { "swizzle ARGB to RGBA", KERNEL_SWIZZLE, 0, 0, SDL_PIXELFORMAT_ARGB8888, SDL_PIXELFORMAT_RGBA8888 },
+        { "swizzle RGBA to ABGR", KERNEL_SWIZZLE, 0, 0, SDL_PIXELFORMAT_RGBA8888, SDL_PIXELFORMAT_ABGR8888 }
+    };
+
+    double frequency = (double)SDL_GetPerformanceFrequency();
+    bool passed = true;
+    std::vector<Uint32> kernelPixels;
+    std::vector<Uint32> referencePixels;
+    for(std::size_t t = 0; t < sizeof(tests) / sizeof(tests[0]); ++t)
+    {
+        const KernelTest& test = tests[t];
+        kernelPixels = source;
+        referencePixels = source;
+
+        Uint64 start = SDL_GetPerformanceCounter();
+        runKernel(test, &kernelPixels[0], pitch, KERNEL_TEST_WIDTH, KERNEL_TEST_HEIGHT);
+        Uint64 middle = SDL_GetPerformanceCounter();
+        for(int y = 0; y < KERNEL_TEST_HEIGHT; ++y)
+        {
+            Uint32* row = &referencePixels[y * stride];
+            for(int x = 0; x < KERNEL_TEST_WIDTH; ++x)
+            {
+                row[x] = referencePixel(test, row[x]);
+            }
+        }
+        Uint64 end = SDL_GetPerformanceCounter();
+
+        // Padding is compared too, so a kernel writing past the row width fails
+        bool match = kernelPixels == referencePixels;
+        passed = passed && match;
+        std::cout << test.name << ": " << (match ? "ok" : "MISMATCH")
+                  << ", kernel " << (middle - start) * 1000.0 / frequency << " ms"
+                  << ", reference " << (end - middle) * 1000.0 / frequency << " ms" << std::endl;
+    }
+    return passed;
+}
+/**************************************************************************/
+
 /***************************************************************************
  Function Definitions
  ***************************************************************************/
@@ -439,21 +1063,20 @@ bool loadMedia()
             Uint32 format = SDL_GetWindowPixelFormat(gWindow);
             SDL_PixelFormat* mappingFormat = SDL_AllocFormat(format);
 
-            // Get pixel data
-            Uint32* pixels = (Uint32*)gFooTexture.getPixels();
-            int pixelCount = (gFooTexture.getPitch() / 4) * gFooTexture.getHeight();
-
             // Map colors
-            Uint32 colorKey = SDL_MapRGB(mappingFormat, 0, 0xff, 0xff);
+            Uint32 colorKey = SDL_MapRGB(mappingFormat, COLOR_KEY_RED, COLOR_KEY_GREEN, COLOR_KEY_BLUE);
             Uint32 transparent = SDL_MapRGBA(mappingFormat, 0xff, 0xff,0xff, 0x00);
 
-            // Color key pixels
-            for(auto i = 0; i < pixelCount; ++i)
+            // Color key pixels, the kernels work on 32 bit pixels only
+            if(SDL_BYTESPERPIXEL(format) == 4)
             {
-                if(pixels[i] == colorKey)
-                {
-                    pixels[i] = transparent;
-                }
+                colorKeyPixels(gFooTexture.getPixels(), gFooTexture.getPitch(),
+                               gFooTexture.getWidth(), gFooTexture.getHeight(),
+                               colorKey, transparent);
+            }
+            else
+            {
+                std::cout << "Window pixel format isn't 32 bit, skipping color key!" << std::endl;
             }
 
             // Unlock texture
@@ -490,6 +1113,15 @@ void close()
  **************************************************************************/
 int main( int argc, char* args[] )
 {
+    // --kernel-selftest checks the pixel kernels without opening a window
+    for(int i = 1; i < argc; ++i)
+    {
+        if(strcmp(args[i], "--kernel-selftest") == 0)
+        {
+            return runKernelSelftest() ? 0 : 1;
+        }
+        printf( "Unknown option %s\n", args[i] );
+    }
 
     //Start up SDL and create window
     if( !init() )
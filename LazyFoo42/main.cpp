@@ -8,8 +8,12 @@
 
 #include <iostream>
 #include <cstdlib>
+#include <cstdio>
 #include <cstring>
+#include <string>
 #include <memory>
+#include <vector>
+#include <sys/stat.h>
 #include <SDL.h>
 #include <SDL_image.h>
 
@@ -22,6 +26,22 @@ const int SCREEN_WIDTH = 640;
 const int SCREEN_HEIGHT = 480;
 const int TOTAL_PARTICLES = 20;
 
+// Frames decoded ahead of the renderer
+const int FRAME_RING_SIZE = 8;
+
+// Playback rate of the stream, independent of the render rate
+const int STREAM_FPS = 15;
+
+// Tags the start of a packed frame file, "LFPK"
+const Uint32 FRAME_PACK_MAGIC = 0x4b50464c;
+
+// Bump when the pack layout changes so old packs get rebuilt
+const Uint32 FRAME_PACK_VERSION = 2;
+
+// Magic, version, frame count, width and height, then offset, size and source time for each frame
+const int FRAME_PACK_HEADER_SIZE = 20;
+const int FRAME_PACK_INDEX_ENTRY_SIZE = 16;
+
 /*********************************************************************/
 
 
@@ -74,7 +94,8 @@ public:
     // Pixel manipulators
     bool lockTexture();
     bool unlockTexture();
-    void copyPixels(void* pixels);
+    void copyPixels(void* pixels, int pitch);
+    bool updatePixels(void* pixels, int pitch, SDL_Rect* rect = nullptr);
     void* getPixels();
     int getPitch();
 
@@ -93,26 +114,106 @@ private:
 /*************************************************************************
  DataStream class
 *************************************************************************/
+// What to do when the decoder falls behind the clock, either way the frame on screen stays up until
+// a newer one is ready, duplicate decodes every frame in order while skip jumps to the one that is due
+enum LateFramePolicy
+{
+    LATE_FRAME_DUPLICATE,
+    LATE_FRAME_SKIP
+};
+
  class DataStream
  {
  public:
     // Initializes internals
     DataStream();
 
-    // Loads initial data
+    // Opens the packed frame file and starts the decoder thread
     bool loadMedia();
 
+    // Packs a numbered sequence of PNG files into a single frame file
+    static bool packFrames(const char* packPath, const char* framePattern, int frameCount);
+
+    // Opens a frame pack and reads its index, false if it's missing, broken or older than its frames
+    bool openPack(const char* packPath, const char* framePattern, int frameCount);
+
     // Deeallocator
     void free();
 
-    // Gets current frame data
-    void* getBuffer();
+    // Gets the latest frame that is due, or NULL if there's nothing to upload
+    // The dirty rect is set to the part that changed since the last frame handed out
+    void* getBuffer(SDL_Rect* dirty = NULL);
+
+    // Gets the row length of the frames in bytes
+    int getPitch();
+
+    // Sets what happens when the decoder falls behind
+    void setLatePolicy(LateFramePolicy policy);
+
+    // Gets microseconds since playback started from the performance counter
+    Uint64 getPlaybackTime();
+
+    // Gets playback statistics
+    int getDroppedFrames();
+    int getLateFrames();
+    int getSkippedFrames();
 
  private:
-    // Internal data
-    SDL_Surface* mImages[4];
-    int mCurrentImage;
-    int mDelayFrames;
+    // Decoder thread entry point
+    static int decodeThread(void* data);
+
+    // Fills free ring slots until told to quit
+    void decode();
+
+    // Reads a frame from the pack and decodes it into a ring slot
+    bool decodeFrame(int frame, SDL_Surface* target);
+
+    // Gets when a frame should be shown in microseconds
+    static Uint64 getFrameTime(int frame);
+
+    // Finds the bounding box of the pixels that differ between two frames
+    static SDL_Rect findDirtyRect(SDL_Surface* previous, SDL_Surface* next);
+
+    // Grows a rect to also cover another
+    static void unionRect(SDL_Rect* rect, const SDL_Rect& other);
+
+    // Packed frame file and where each frame sits in it
+    SDL_RWops* mPack;
+    std::vector<Uint32> mFrameOffsets;
+    std::vector<Uint32> mFrameSizes;
+    int mFrameCount;
+    int mWidth, mHeight;
+
+    // Compressed frame being decoded, reused so memory stays constant
+    std::vector<Uint8> mReadBuffer;
+
+    // Decoded frames, when they should show up and what changed in them
+    SDL_Surface* mFrames[FRAME_RING_SIZE];
+    Uint64 mFrameTimes[FRAME_RING_SIZE];
+    SDL_Rect mDirtyRects[FRAME_RING_SIZE];
+
+    // Frames published by the decoder and taken by the renderer
+    SDL_atomic_t mWriteCount;
+    SDL_atomic_t mReadCount;
+
+    // Slots the decoder is allowed to fill
+    SDL_sem* mFreeSlots;
+
+    // Decoder thread and its quit flag
+    SDL_Thread* mDecodeThread;
+    SDL_atomic_t mQuit;
+
+    // Playback state, the policy is read by the decoder thread
+    SDL_atomic_t mLatePolicy;
+    Uint64 mStartCounter;
+    int mDroppedFrames;
+    int mLateFrames;
+
+    // Stream frames the frame on screen has already been counted late for
+    int mLateCounted;
+
+    // Frames the decoder jumped over to catch up with the clock
+    SDL_atomic_t mSkippedFrames;
  };
 
 /*********************************************************************/
@@ -356,15 +457,48 @@ bool LTexture::lockTexture()
     return success;
 }
 
-void LTexture::copyPixels(void* pixels)
+void LTexture::copyPixels(void* pixels, int pitch)
 {
     // Texture is locked
     if(mPixels != NULL)
     {
-        // Copy to locked pixels
-        memcpy(mPixels, pixels, mPitch * mHeight);
+        // Copy to locked pixels a row at a time since the pitches can differ
+        for(int row = 0; row < mHeight; ++row)
+        {
+            memcpy((Uint8*)mPixels + row * mPitch, (Uint8*)pixels + row * pitch, mWidth * 4);
+        }
+    }
+
+}
+
+bool LTexture::updatePixels(void* pixels, int pitch, SDL_Rect* rect)
+{
+    bool success = true;
+
+    // Can't update while locked
+    if(mPixels != NULL)
+    {
+        std::cout << "Texture is locked!" << std::endl;
+        success = false;
     }
+    // Skip empty rects since nothing changed
+    else if(rect == NULL || (rect->w > 0 && rect->h > 0))
+    {
+        // Start the source at the top left of the rect
+        Uint8* source = (Uint8*)pixels;
+        if(rect != NULL)
+        {
+            source += rect->y * pitch + rect->x * 4;
+        }
 
+        // Upload straight to the texture without a lock and copy
+        if(SDL_UpdateTexture(mTexture, rect, source, pitch) != 0)
+        {
+            std::cout << "Unable to update texture! " << SDL_GetError() << std::endl;
+            success = false;
+        }
+    }
+    return success;
 }
 bool LTexture::unlockTexture()
 {
@@ -402,64 +536,589 @@ int LTexture::getPitch()
 ***************************************************************************/
 DataStream::DataStream()
 {
-	mImages[ 0 ] = NULL;
-	mImages[ 1 ] = NULL;
-	mImages[ 2 ] = NULL;
-	mImages[ 3 ] = NULL;
+	mPack = NULL;
+	mFrameCount = 0;
+	mWidth = 0;
+	mHeight = 0;
 
-	mCurrentImage = 0;
-	mDelayFrames = 4;
+	for( int i = 0; i < FRAME_RING_SIZE; ++i )
+	{
+		mFrames[ i ] = NULL;
+		mFrameTimes[ i ] = 0;
+		mDirtyRects[ i ].x = 0;
+		mDirtyRects[ i ].y = 0;
+		mDirtyRects[ i ].w = 0;
+		mDirtyRects[ i ].h = 0;
+	}
+
+	SDL_AtomicSet( &mWriteCount, 0 );
+	SDL_AtomicSet( &mReadCount, 0 );
+	SDL_AtomicSet( &mQuit, 0 );
+	mFreeSlots = NULL;
+	mDecodeThread = NULL;
+
+	SDL_AtomicSet( &mLatePolicy, LATE_FRAME_SKIP );
+	mStartCounter = 0;
+	mDroppedFrames = 0;
+	mLateFrames = 0;
+	mLateCounted = 0;
+	SDL_AtomicSet( &mSkippedFrames, 0 );
 }
 
 bool DataStream::loadMedia()
 {
 	bool success = true;
+	const char* packPath = "42_texture_streaming/foo_walk.pack";
+	const char* framePattern = "42_texture_streaming/foo_walk_%d.png";
+	const int frameCount = 4;
+
+	// Rebuild the pack from the loose frames when it's missing, broken or out of date
+	if( !openPack( packPath, framePattern, frameCount ) )
+	{
+		printf( "Building %s\n", packPath );
+		if( !packFrames( packPath, framePattern, frameCount ) )
+		{
+			printf( "Unable to pack frames into %s!\n", packPath );
+			success = false;
+		}
+		else if( !openPack( packPath, framePattern, frameCount ) )
+		{
+			printf( "Unable to open the rebuilt %s!\n", packPath );
+			success = false;
+		}
+	}
+
+	if( success )
+	{
+		// Allocate the ring slots up front so decoding never allocates
+		for( int i = 0; i < FRAME_RING_SIZE; ++i )
+		{
+			mFrames[ i ] = SDL_CreateRGBSurfaceWithFormat( 0, mWidth, mHeight, 32, SDL_PIXELFORMAT_RGBA8888 );
+			if( mFrames[ i ] == NULL )
+			{
+				printf( "Unable to create frame buffer! SDL Error: %s\n", SDL_GetError() );
+				success = false;
+			}
+		}
+	}
+
+	if( success )
+	{
+		// One slot is always held by the renderer
+		mFreeSlots = SDL_CreateSemaphore( FRAME_RING_SIZE - 1 );
+
+		// Start the clock before the decoder so it sees the start time
+		mStartCounter = SDL_GetPerformanceCounter();
+
+		mDecodeThread = SDL_CreateThread( decodeThread, "DataStreamDecoder", this );
+		if( mDecodeThread == NULL )
+		{
+			printf( "Unable to create decoder thread! SDL Error: %s\n", SDL_GetError() );
+			success = false;
+		}
+	}
+
+	return success;
+}
+
+bool DataStream::openPack( const char* packPath, const char* framePattern, int frameCount )
+{
+	bool success = true;
+
+	mPack = SDL_RWFromFile( packPath, "rb" );
+	if( mPack == NULL )
+	{
+		return false;
+	}
+
+	// Header
+	Sint64 packSize = SDL_RWsize( mPack );
+	Uint32 magic = SDL_ReadLE32( mPack );
+	Uint32 version = SDL_ReadLE32( mPack );
+	Uint32 packedCount = SDL_ReadLE32( mPack );
+	mWidth = SDL_ReadLE32( mPack );
+	mHeight = SDL_ReadLE32( mPack );
+
+	// The header and index have to fit in the file before anything is allocated
+	Sint64 indexEnd = FRAME_PACK_HEADER_SIZE + (Sint64)packedCount * FRAME_PACK_INDEX_ENTRY_SIZE;
+	if( magic != FRAME_PACK_MAGIC || version != FRAME_PACK_VERSION || packedCount != (Uint32)frameCount ||
+	    indexEnd > packSize || mWidth <= 0 || mHeight <= 0 )
+	{
+		printf( "%s has a bad or old header\n", packPath );
+		success = false;
+	}
+	else
+	{
+		// Only the index stays in memory, the frames are read as they're decoded
+		mFrameCount = frameCount;
+		mFrameOffsets.resize( mFrameCount );
+		mFrameSizes.resize( mFrameCount );
+		char path[ 256 ] = "";
+		for( int i = 0; i < mFrameCount && success; ++i )
+		{
+			mFrameOffsets[ i ] = SDL_ReadLE32( mPack );
+			mFrameSizes[ i ] = SDL_ReadLE32( mPack );
+			Sint64 modified = (Sint64)SDL_ReadLE64( mPack );
+
+			// Every frame has to lie inside the file after the index
+			if( mFrameSizes[ i ] == 0 || mFrameOffsets[ i ] < indexEnd ||
+			    (Sint64)mFrameOffsets[ i ] + mFrameSizes[ i ] > packSize )
+			{
+				printf( "%s has a bad index\n", packPath );
+				success = false;
+			}
+
+			// Frames are copied as is, so an edited source shows up as a new time or size
+			// A missing source can't be checked and the pack still holds the frame
+			struct stat sourceInfo;
+			sprintf( path, framePattern, i );
+			if( success && stat( path, &sourceInfo ) == 0 &&
+			    ( modified != (Sint64)sourceInfo.st_mtime || (Sint64)mFrameSizes[ i ] != (Sint64)sourceInfo.st_size ) )
+			{
+				printf( "%s is older than %s\n", packPath, path );
+				success = false;
+			}
+		}
+	}
+
+	if( !success )
+	{
+		SDL_RWclose( mPack );
+		mPack = NULL;
+		mFrameOffsets.clear();
+		mFrameSizes.clear();
+		mFrameCount = 0;
+	}
+	return success;
+}
+
+bool DataStream::packFrames( const char* packPath, const char* framePattern, int frameCount )
+{
+	bool success = true;
+
+	// Get the frame dimensions from the first frame
+	char path[ 256 ] = "";
+	sprintf( path, framePattern, 0 );
+	SDL_Surface* firstFrame = IMG_Load( path );
+	if( firstFrame == NULL )
+	{
+		printf( "Unable to load %s! SDL_image error: %s\n", path, IMG_GetError() );
+		return false;
+	}
+
+	// Write to a temporary file so a failed pack never looks like a finished one
+	std::string tempPath = std::string( packPath ) + ".tmp";
+	SDL_RWops* pack = SDL_RWFromFile( tempPath.c_str(), "wb" );
+	if( pack == NULL )
+	{
+		printf( "Unable to create %s! SDL Error: %s\n", tempPath.c_str(), SDL_GetError() );
+		SDL_FreeSurface( firstFrame );
+		return false;
+	}
+
+	// Header
+	SDL_WriteLE32( pack, FRAME_PACK_MAGIC );
+	SDL_WriteLE32( pack, FRAME_PACK_VERSION );
+	SDL_WriteLE32( pack, frameCount );
+	SDL_WriteLE32( pack, firstFrame->w );
+	SDL_WriteLE32( pack, firstFrame->h );
+	SDL_FreeSurface( firstFrame );
+
+	// Leave room for the index and fill it in once the offsets are known
+	Sint64 indexStart = SDL_RWseek( pack, 0, RW_SEEK_CUR );
+	for( int i = 0; i < frameCount * FRAME_PACK_INDEX_ENTRY_SIZE / 4; ++i )
+	{
+		SDL_WriteLE32( pack, 0 );
+	}
 
-	for( int i = 0; i < 4; ++i )
+	std::vector<Uint32> offsets( frameCount ), sizes( frameCount );
+	std::vector<Sint64> modified( frameCount );
+	std::vector<Uint8> data;
+	for( int i = 0; i < frameCount && success; ++i )
 	{
-		char path[ 64 ] = "";
-		sprintf( path, "42_texture_streaming/foo_walk_%d.png", i );
+		sprintf( path, framePattern, i );
 
-		SDL_Surface* loadedSurface = IMG_Load( path );
-		if( loadedSurface == NULL )
+		// Copy the compressed frame as is, remembering when it changed so edits rebuild the pack
+		struct stat sourceInfo;
+		SDL_RWops* frameFile = SDL_RWFromFile( path, "rb" );
+		if( frameFile == NULL || stat( path, &sourceInfo ) != 0 )
 		{
-			printf( "Unable to load %s! SDL_image error: %s\n", path, IMG_GetError() );
+			printf( "Unable to open %s! SDL Error: %s\n", path, SDL_GetError() );
+			if( frameFile != NULL )
+			{
+				SDL_RWclose( frameFile );
+			}
 			success = false;
 		}
 		else
 		{
-			mImages[ i ] = SDL_ConvertSurfaceFormat( loadedSurface, SDL_PIXELFORMAT_RGBA8888, NULL );
+			modified[ i ] = (Sint64)sourceInfo.st_mtime;
+			Sint64 frameSize = SDL_RWsize( frameFile );
+			data.resize( frameSize > 0 ? (size_t)frameSize : 0 );
+			if( data.empty() || SDL_RWread( frameFile, data.data(), 1, data.size() ) != data.size() )
+			{
+				printf( "Unable to read %s! SDL Error: %s\n", path, SDL_GetError() );
+				success = false;
+			}
+			SDL_RWclose( frameFile );
+
+			if( success )
+			{
+				offsets[ i ] = (Uint32)SDL_RWseek( pack, 0, RW_SEEK_CUR );
+				sizes[ i ] = data.size();
+				if( SDL_RWwrite( pack, data.data(), 1, data.size() ) != data.size() )
+				{
+					printf( "Unable to write %s! SDL Error: %s\n", tempPath.c_str(), SDL_GetError() );
+					success = false;
+				}
+			}
 		}
+	}
 
-		SDL_FreeSurface( loadedSurface );
+	// Fill in the index
+	if( success )
+	{
+		SDL_RWseek( pack, indexStart, RW_SEEK_SET );
+		for( int i = 0; i < frameCount; ++i )
+		{
+			SDL_WriteLE32( pack, offsets[ i ] );
+			SDL_WriteLE32( pack, sizes[ i ] );
+			SDL_WriteLE64( pack, (Uint64)modified[ i ] );
+		}
 	}
 
+	if( SDL_RWclose( pack ) != 0 )
+	{
+		printf( "Unable to finish %s! SDL Error: %s\n", tempPath.c_str(), SDL_GetError() );
+		success = false;
+	}
+
+	// Only a complete pack takes the real name
+	if( success )
+	{
+		std::remove( packPath );
+		if( std::rename( tempPath.c_str(), packPath ) != 0 )
+		{
+			printf( "Unable to rename %s to %s!\n", tempPath.c_str(), packPath );
+			success = false;
+		}
+	}
+	if( !success )
+	{
+		std::remove( tempPath.c_str() );
+	}
 	return success;
 }
 
 void DataStream::free()
 {
-	for( int i = 0; i < 4; ++i )
+	// Stop the decoder
+	if( mDecodeThread != NULL )
+	{
+		SDL_AtomicSet( &mQuit, 1 );
+		SDL_WaitThread( mDecodeThread, NULL );
+		mDecodeThread = NULL;
+	}
+
+	if( mFreeSlots != NULL )
+	{
+		SDL_DestroySemaphore( mFreeSlots );
+		mFreeSlots = NULL;
+	}
+
+	for( int i = 0; i < FRAME_RING_SIZE; ++i )
+	{
+		SDL_FreeSurface( mFrames[ i ] );
+		mFrames[ i ] = NULL;
+	}
+
+	if( mPack != NULL )
+	{
+		SDL_RWclose( mPack );
+		mPack = NULL;
+	}
+	mFrameOffsets.clear();
+	mFrameSizes.clear();
+	mFrameCount = 0;
+}
+
+void* DataStream::getBuffer( SDL_Rect* dirty )
+{
+	Uint64 now = getPlaybackTime();
+
+	int readCount = SDL_AtomicGet( &mReadCount );
+	int writeCount = SDL_AtomicGet( &mWriteCount );
+
+	// Don't read frames before the count that published them
+	SDL_MemoryBarrierAcquire();
+
+	// Find the latest decoded frame that is due
+	int latest = readCount;
+	while( latest < writeCount && mFrameTimes[ latest % FRAME_RING_SIZE ] <= now )
+	{
+		++latest;
+	}
+
+	// Got a new frame
+	if( latest > readCount )
+	{
+		// Frames we jumped over never got shown
+		mDroppedFrames += latest - readCount - 1;
+		mLateCounted = 0;
+
+		// Everything that changed since the last frame handed out
+		if( dirty != NULL )
+		{
+			if( readCount == 0 )
+			{
+				*dirty = mFrames[ 0 ]->clip_rect;
+			}
+			else
+			{
+				*dirty = mDirtyRects[ readCount % FRAME_RING_SIZE ];
+				for( int i = readCount + 1; i < latest; ++i )
+				{
+					unionRect( dirty, mDirtyRects[ i % FRAME_RING_SIZE ] );
+				}
+			}
+		}
+
+		// Hand the skipped slots and the previously held one back to the decoder once we're done reading them
+		SDL_MemoryBarrierRelease();
+		SDL_AtomicSet( &mReadCount, latest );
+		for( int i = ( readCount == 0 ? 1 : 0 ); i < latest - readCount; ++i )
+		{
+			SDL_SemPost( mFreeSlots );
+		}
+
+		return mFrames[ ( latest - 1 ) % FRAME_RING_SIZE ]->pixels;
+	}
+
+	// Nothing decoded yet
+	if( readCount == 0 )
+	{
+		return NULL;
+	}
+
+	// The next frame is due but the decoder hasn't gotten to it, the texture still holds the current
+	// frame so there's nothing to upload, just count each stream frame it misses once
+	Uint64 shown = mFrameTimes[ ( readCount - 1 ) % FRAME_RING_SIZE ];
+	if( writeCount == readCount && now >= shown + getFrameTime( 1 ) )
+	{
+		int missed = (int)( ( now - shown ) / getFrameTime( 1 ) );
+		if( missed > mLateCounted )
+		{
+			mLateFrames += missed - mLateCounted;
+			mLateCounted = missed;
+		}
+	}
+
+	// Current frame is still up
+	return NULL;
+}
+
+int DataStream::getPitch()
+{
+	return mFrames[ 0 ] != NULL ? mFrames[ 0 ]->pitch : 0;
+}
+
+void DataStream::setLatePolicy( LateFramePolicy policy )
+{
+	SDL_AtomicSet( &mLatePolicy, policy );
+}
+
+Uint64 DataStream::getPlaybackTime()
+{
+	Uint64 elapsed = SDL_GetPerformanceCounter() - mStartCounter;
+	Uint64 frequency = SDL_GetPerformanceFrequency();
+
+	// Split into whole seconds and the rest so the multiply can't overflow
+	return ( elapsed / frequency ) * 1000000 + ( elapsed % frequency ) * 1000000 / frequency;
+}
+
+int DataStream::getDroppedFrames()
+{
+	return mDroppedFrames;
+}
+
+int DataStream::getLateFrames()
+{
+	return mLateFrames;
+}
+
+bool DataStream::decodeFrame( int frame, SDL_Surface* target )
+{
+	bool success = true;
+
+	// Read the compressed frame
+	mReadBuffer.resize( mFrameSizes[ frame ] );
+	SDL_RWseek( mPack, mFrameOffsets[ frame ], RW_SEEK_SET );
+	if( SDL_RWread( mPack, mReadBuffer.data(), 1, mReadBuffer.size() ) != mReadBuffer.size() )
+	{
+		printf( "Unable to read frame %d! SDL Error: %s\n", frame, SDL_GetError() );
+		return false;
+	}
+
+	// Decode it
+	SDL_Surface* loadedSurface = IMG_Load_RW( SDL_RWFromConstMem( mReadBuffer.data(), mReadBuffer.size() ), 1 );
+	if( loadedSurface == NULL )
 	{
-		SDL_FreeSurface( mImages[ i ] );
+		printf( "Unable to decode frame %d! SDL_image error: %s\n", frame, IMG_GetError() );
+		success = false;
 	}
+	else
+	{
+		// Convert straight into the slot
+		SDL_SetSurfaceBlendMode( loadedSurface, SDL_BLENDMODE_NONE );
+		if( SDL_BlitSurface( loadedSurface, NULL, target, NULL ) != 0 )
+		{
+			printf( "Unable to convert frame %d! SDL Error: %s\n", frame, SDL_GetError() );
+			success = false;
+		}
+		SDL_FreeSurface( loadedSurface );
+	}
+	return success;
 }
 
-void* DataStream::getBuffer()
+SDL_Rect DataStream::findDirtyRect( SDL_Surface* previous, SDL_Surface* next )
 {
-	--mDelayFrames;
-	if( mDelayFrames == 0 )
+	SDL_Rect dirty = { 0, 0, 0, 0 };
+	int left = next->w, right = -1, top = next->h, bottom = -1;
+
+	// Go through the rows
+	for( int y = 0; y < next->h; ++y )
+	{
+		Uint32* previousRow = (Uint32*)( (Uint8*)previous->pixels + y * previous->pitch );
+		Uint32* nextRow = (Uint32*)( (Uint8*)next->pixels + y * next->pitch );
+
+		// Skip rows that didn't change
+		if( memcmp( previousRow, nextRow, next->w * 4 ) == 0 )
+		{
+			continue;
+		}
+
+		if( y < top )
+		{
+			top = y;
+		}
+		bottom = y;
+
+		// Find the changed columns in this row
+		for( int x = 0; x < next->w; ++x )
+		{
+			if( previousRow[ x ] != nextRow[ x ] )
+			{
+				if( x < left )
+				{
+					left = x;
+				}
+				if( x > right )
+				{
+					right = x;
+				}
+			}
+		}
+	}
+
+	// Something changed
+	if( bottom >= 0 )
 	{
-		++mCurrentImage;
-		mDelayFrames = 4;
+		dirty.x = left;
+		dirty.y = top;
+		dirty.w = right - left + 1;
+		dirty.h = bottom - top + 1;
 	}
+	return dirty;
+}
 
-	if( mCurrentImage == 4 )
+void DataStream::unionRect( SDL_Rect* rect, const SDL_Rect& other )
+{
+	// Empty rects don't add anything
+	if( other.w <= 0 || other.h <= 0 )
 	{
-		mCurrentImage = 0;
+		return;
 	}
+	if( rect->w <= 0 || rect->h <= 0 )
+	{
+		*rect = other;
+		return;
+	}
+
+	int right = rect->x + rect->w > other.x + other.w ? rect->x + rect->w : other.x + other.w;
+	int bottom = rect->y + rect->h > other.y + other.h ? rect->y + rect->h : other.y + other.h;
+	rect->x = rect->x < other.x ? rect->x : other.x;
+	rect->y = rect->y < other.y ? rect->y : other.y;
+	rect->w = right - rect->x;
+	rect->h = bottom - rect->y;
+}
 
-	return mImages[ mCurrentImage ]->pixels;
+int DataStream::getSkippedFrames()
+{
+	return SDL_AtomicGet( &mSkippedFrames );
+}
+
+Uint64 DataStream::getFrameTime( int frame )
+{
+	// Computed from the frame number each time so rounding never adds up
+	return (Uint64)frame * 1000000 / STREAM_FPS;
+}
+
+int DataStream::decodeThread( void* data )
+{
+	( (DataStream*)data )->decode();
+	return 0;
+}
+
+void DataStream::decode()
+{
+	// Position in the sequence and number of frames published
+	int frame = 0;
+	int written = 0;
+
+	while( SDL_AtomicGet( &mQuit ) == 0 )
+	{
+		// Wait for a free slot, checking every so often if we should quit
+		if( SDL_SemWaitTimeout( mFreeSlots, 10 ) != 0 )
+		{
+			continue;
+		}
+
+		// Skip ahead instead of decoding frames that are already over
+		int current = (int)( getPlaybackTime() * STREAM_FPS / 1000000 );
+		if( SDL_AtomicGet( &mLatePolicy ) == LATE_FRAME_SKIP && frame < current )
+		{
+			SDL_AtomicAdd( &mSkippedFrames, current - frame );
+			frame = current;
+		}
+
+		// Decode the next frame into its slot, looping the sequence
+		int slot = written % FRAME_RING_SIZE;
+		if( !decodeFrame( frame % mFrameCount, mFrames[ slot ] ) )
+		{
+			// Drop the frame and give the slot back rather than publish stale pixels
+			SDL_AtomicAdd( &mSkippedFrames, 1 );
+			++frame;
+			SDL_SemPost( mFreeSlots );
+			continue;
+		}
+		mFrameTimes[ slot ] = getFrameTime( frame );
+
+		// Work out what changed since the last published frame so the renderer only uploads that
+		if( written == 0 )
+		{
+			mDirtyRects[ slot ] = mFrames[ slot ]->clip_rect;
+		}
+		else
+		{
+			mDirtyRects[ slot ] = findDirtyRect( mFrames[ ( written - 1 ) % FRAME_RING_SIZE ], mFrames[ slot ] );
+		}
+
+		// Publish it once the pixels, time and dirty rect are all written
+		++frame;
+		++written;
+		SDL_MemoryBarrierRelease();
+		SDL_AtomicSet( &mWriteCount, written );
+	}
 }
 
 /**************************************************************************/
@@ -552,6 +1211,9 @@ bool loadMedia()
 void close()
 {
     // Free loaded images
+    std::cout << "Stream dropped frames: " << gDataStream.getDroppedFrames()
+              << " late frames: " << gDataStream.getLateFrames()
+              << " skipped frames: " << gDataStream.getSkippedFrames() << std::endl;
     gStreamingTexture.free();
     gDataStream.free();
 
@@ -621,10 +1283,13 @@ int main( int argc, char* args[] )
                 SDL_SetRenderDrawColor( gRenderer, 0xff, 0xff, 0xff, 0xff );
                 SDL_RenderClear( gRenderer );
 
-                // Copy frame from buffer
-                gStreamingTexture.lockTexture();
-                gStreamingTexture.copyPixels(gDataStream.getBuffer());
-                gStreamingTexture.unlockTexture();
+                // Upload only the part of the frame that changed
+                SDL_Rect dirty;
+                void* frame = gDataStream.getBuffer(&dirty);
+                if(frame != NULL)
+                {
+                    gStreamingTexture.updatePixels(frame, gDataStream.getPitch(), &dirty);
+                }
 
                 // Render frame
                 gStreamingTexture.render((SCREEN_WIDTH - gStreamingTexture.getWidth()) / 2,
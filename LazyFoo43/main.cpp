@@ -10,9 +10,16 @@
 #include <cstdlib>
 #include <cstring>
 #include <memory>
+#include <vector>
+#include <functional>
 #include <SDL.h>
 #include <SDL_image.h>
 
+// Pick the widest pixel kernels the compiler was told it can use
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PIXEL_KERNELS_SSE2
+#endif
 
 
 /**********************************************************************
@@ -21,6 +28,18 @@
 const int SCREEN_WIDTH = 640;
 const int SCREEN_HEIGHT = 480;
 
+// Frames a free pooled target survives before it is destroyed
+const int TARGET_POOL_EVICT_FRAMES = 300;
+
+// Rows per post processing tile handed to a worker
+const int POST_BAND_ROWS = 16;
+
+// Upper bound on post processing workers
+const int POST_MAX_THREADS = 16;
+
+// Largest blur radius the 16 bit column sums can hold
+const int POST_MAX_BLUR_RADIUS = 32;
+
 /*********************************************************************/
 
 
@@ -48,7 +67,8 @@ public:
     void free();
 
     // Create blank texture
-    bool createBlank(int width, int height, SDL_TextureAccess = SDL_TEXTUREACCESS_STREAMING);
+    bool createBlank(int width, int height, SDL_TextureAccess = SDL_TEXTUREACCESS_STREAMING,
+                     Uint32 format = SDL_PIXELFORMAT_RGBA8888);
 
     // Renders texture at a given point
     void render(int x, int y,
@@ -77,6 +97,7 @@ public:
     bool lockTexture();
     bool unlockTexture();
     void copyPixels(void* pixels);
+    bool updatePixels(void* pixels, int pitch);
     void* getPixels();
     int getPitch();
 
@@ -92,6 +113,228 @@ private:
 
 /*********************************************************************/
 
+/*************************************************************************
+ Render target pool class
+ *************************************************************************/
+class LRenderTargetPool
+{
+public:
+    // Constructor
+    LRenderTargetPool();
+
+    // Deallocates pooled textures
+    ~LRenderTargetPool();
+
+    // Hands out a target until released
+    LTexture* acquire(int width, int height, Uint32 format = SDL_PIXELFORMAT_RGBA8888);
+
+    // Hands out a target that returns to the pool at endFrame
+    LTexture* acquireFrame(int width, int height, Uint32 format = SDL_PIXELFORMAT_RGBA8888);
+
+    // Returns a target to the pool
+    void release(LTexture* texture);
+
+    // Recycles frame targets and evicts long unused ones
+    void endFrame();
+
+    // Deallocate all pooled textures
+    void free();
+
+    // Pool statistics
+    int getCreatedCount();
+    int getReusedCount();
+    int getPooledCount();
+
+private:
+    struct Entry
+    {
+        std::unique_ptr<LTexture> texture;
+        Uint64 key;
+        bool inUse;
+        bool frameScoped;
+        int lastUsedFrame;
+    };
+
+    // Packs size and format into a lookup key
+    static Uint64 makeKey(int width, int height, Uint32 format);
+
+    // Finds or creates a free target for key
+    LTexture* take(int width, int height, Uint32 format, bool frameScoped);
+
+    std::vector<Entry> mEntries;
+
+    int mFrame;
+    int mCreatedCount;
+    int mReusedCount;
+};
+
+/*********************************************************************/
+
+/*************************************************************************
+ Post processor class
+ *************************************************************************/
+class LPostProcessor
+{
+public:
+    // Constructor
+    LPostProcessor();
+
+    // Stops workers and deallocates buffers
+    ~LPostProcessor();
+
+    // Allocates frame buffers and starts workers, 0 threads picks from CPU count
+    bool init(int width, int height, int threadCount = 0);
+
+    // Stops workers and deallocates buffers
+    void free();
+
+    // Box blur radius in pixels, 0 disables
+    void setBlur(int radius);
+    int getBlur();
+
+    // Contrast around mid grey, saturation and a tint multiplied in
+    void setColorGrade(float contrast, float saturation, Uint8 red, Uint8 green, Uint8 blue);
+    void clearColorGrade();
+    bool hasColorGrade();
+
+    // How much darker every other row gets, 0 disables
+    void setScanlines(Uint8 strength);
+    Uint8 getScanlines();
+
+    // Any effect enabled
+    bool isActive();
+
+    // Runs the enabled effects over the frame buffer
+    void process();
+
+    // ARGB8888 frame buffer to fill before process
+    Uint32* getPixels();
+    int getPitch();
+
+    // Duration of the last process call
+    double getProcessMilliseconds();
+
+private:
+    enum Pass
+    {
+        PASS_BLUR_HORIZONTAL,
+        PASS_BLUR_VERTICAL,
+        PASS_FINISH
+    };
+
+    struct Worker
+    {
+        LPostProcessor* owner;
+        int index;
+    };
+
+    // Worker thread entry
+    static int workerThread(void* data);
+
+    // Runs a pass over all bands on the workers and this thread
+    void runPass(Pass pass);
+
+    // Takes bands until none are left
+    void processBands(int worker);
+
+    // Recomputes the per channel grading table
+    void buildGradeTable(float contrast, Uint8 red, Uint8 green, Uint8 blue);
+
+    // Frame and blur intermediate
+    std::vector<Uint32> mFrame;
+    std::vector<Uint32> mTemp;
+
+    // Per worker running column sums for the vertical blur
+    std::vector<std::vector<Uint16> > mColumnSums;
+
+    int mWidth;
+    int mHeight;
+    int mBandCount;
+
+    // Effect settings
+    int mBlurRadius;
+    bool mGrade;
+    int mSaturation;
+    Uint8 mGradeTable[3][256];
+    Uint8 mScanlines;
+
+    // Worker threads and hand off
+    std::vector<SDL_Thread*> mThreads;
+    std::vector<Worker> mWorkers;
+    SDL_sem* mStart;
+    SDL_sem* mDone;
+    SDL_atomic_t mNextBand;
+    SDL_atomic_t mQuit;
+    Pass mPass;
+
+    double mProcessMilliseconds;
+};
+
+/*********************************************************************/
+
+/*************************************************************************
+ Layer compositor class
+ *************************************************************************/
+class LLayerCompositor
+{
+public:
+    // Draws a layer's contents into the current render target
+    typedef std::function<void()> DrawFunc;
+
+    // Constructor
+    LLayerCompositor();
+
+    // Deallocates layers
+    ~LLayerCompositor();
+
+    // Creates a render target layer, returns its id or -1 on failure
+    int addLayer(int width, int height, DrawFunc draw, SDL_Color clearColor = {0, 0, 0, 0});
+
+    // Deallocate all layers
+    void free();
+
+    // Flags a layer to be re-rendered on the next compose
+    void markDirty(int layer);
+    void markAllDirty();
+
+    // Per layer composite state
+    void setPosition(int layer, int x, int y);
+    void setRotation(int layer, double angle, SDL_Point* center = nullptr);
+    void setAlpha(int layer, Uint8 alpha);
+    void setVisible(int layer, bool visible);
+
+    // Re-renders dirty layers then draws all visible layers to the screen
+    void compose();
+
+    // Number of layer redraws since creation
+    int getRedrawCount();
+
+private:
+    struct Layer
+    {
+        LTexture* target;
+        DrawFunc draw;
+        SDL_Color clearColor;
+        bool dirty;
+        bool visible;
+        int x;
+        int y;
+        double angle;
+        bool hasCenter;
+        SDL_Point center;
+    };
+
+    // Returns layer for id or NULL
+    Layer* getLayer(int layer);
+
+    // Layers in back to front order
+    std::vector<Layer> mLayers;
+
+    int mRedrawCount;
+};
+
+/*********************************************************************/
+
 /**********************************************************************
  Globals
  **********************************************************************/
@@ -106,7 +349,20 @@ SDL_Renderer* gRenderer = nullptr;
 TTF_Font* gFont = nullptr;
 #endif
 
-LTexture gTargetTexture;
+// Offscreen targets shared by layers and effects
+LRenderTargetPool gTargetPool;
+
+// Layers composited each frame
+LLayerCompositor gCompositor;
+
+// Static primitive scene layer
+int gSceneLayer = -1;
+
+// CPU effects applied to the composited frame
+LPostProcessor gPostProcessor;
+
+// Streams the processed frame back to the renderer
+LTexture gPostTexture;
 
 /*********************************************************************/
 
@@ -119,6 +375,17 @@ bool loadMedia();
 
 void close();
 
+void drawScene();
+
+// Post processing kernels over rows y0 to y1 of tightly packed ARGB8888 frames
+void blurRowsHorizontal(const Uint32* src, Uint32* dst, int width, int y0, int y1, int radius);
+
+void blurRowsVertical(const Uint32* src, Uint32* dst, int width, int height, int y0, int y1, int radius, Uint16* sums);
+
+void gradePixels(Uint32* pixels, int width, int y0, int y1, const Uint8 table[3][256], int saturation);
+
+void scanlinePixels(Uint32* pixels, int width, int y0, int y1, Uint8 strength);
+
 /************************************************************************/
 
 
@@ -131,6 +398,8 @@ LTexture::LTexture()
 {
     // Initialize
     mTexture = nullptr;
+    mPixels = nullptr;
+    mPitch = 0;
     mWidth = 0;
     mHeight = 0;
 }
@@ -213,10 +482,13 @@ void LTexture::free()
     }
 }
 
-bool LTexture::createBlank(int width, int height, SDL_TextureAccess access)
+bool LTexture::createBlank(int width, int height, SDL_TextureAccess access, Uint32 format)
 {
+    // Get rid of pre-existing texture
+    free();
+
     // Create uninitialized texture
-    mTexture = SDL_CreateTexture(gRenderer, SDL_PIXELFORMAT_RGBA8888, access, width, height);
+    mTexture = SDL_CreateTexture(gRenderer, format, access, width, height);
     if(mTexture == NULL)
     {
         std::cout << "Unable to create blank texture! SDL Error: " << SDL_GetError() << std::endl;
@@ -346,6 +618,25 @@ void LTexture::copyPixels(void* pixels)
     }
 
 }
+bool LTexture::updatePixels(void* pixels, int pitch)
+{
+    bool success = true;
+
+    // Can't update while locked
+    if(mPixels != NULL)
+    {
+        std::cout << "Texture is locked!" << std::endl;
+        success = false;
+    }
+    // Upload straight to the texture without a lock and copy
+    else if(SDL_UpdateTexture(mTexture, NULL, pixels, pitch) != 0)
+    {
+        std::cout << "Unable to update texture! " << SDL_GetError() << std::endl;
+        success = false;
+    }
+    return success;
+}
+
 bool LTexture::unlockTexture()
 {
     bool success = true;
@@ -379,136 +670,1053 @@ int LTexture::getPitch()
 
 
 
-/***************************************************************************
- Function Definitions
- ***************************************************************************/
+/*********************************************************************
+ LRenderTargetPool Method Declarations
+ *********************************************************************/
+LRenderTargetPool::LRenderTargetPool()
+{
+    mFrame = 0;
+    mCreatedCount = 0;
+    mReusedCount = 0;
+}
 
-bool init()
+LRenderTargetPool::~LRenderTargetPool()
 {
-    //Initialization flag
-    bool success = true;
+    free();
+}
 
-    //Initialize SDL
-    if( SDL_Init( SDL_INIT_VIDEO ) < 0 )
+LTexture* LRenderTargetPool::acquire(int width, int height, Uint32 format)
+{
+    return take(width, height, format, false);
+}
+
+LTexture* LRenderTargetPool::acquireFrame(int width, int height, Uint32 format)
+{
+    return take(width, height, format, true);
+}
+
+void LRenderTargetPool::release(LTexture* texture)
+{
+    for(auto& entry : mEntries)
     {
-        printf( "SDL could not initialize! SDL Error: %s\n", SDL_GetError() );
-        success = false;
+        if(entry.texture.get() == texture)
+        {
+            entry.inUse = false;
+            entry.frameScoped = false;
+            entry.lastUsedFrame = mFrame;
+            return;
+        }
     }
-    else
+}
+
+void LRenderTargetPool::endFrame()
+{
+    ++mFrame;
+
+    for(size_t i = 0; i < mEntries.size();)
     {
-        //Set texture filtering to linear
-        if( !SDL_SetHint( SDL_HINT_RENDER_SCALE_QUALITY, "1" ) )
+        Entry& entry = mEntries[i];
+
+        // Frame targets only live until the end of the frame
+        if(entry.inUse && entry.frameScoped)
         {
-            printf( "Warning: Linear texture filtering not enabled!" );
+            entry.inUse = false;
+            entry.frameScoped = false;
+            entry.lastUsedFrame = mFrame;
         }
 
-        //Create window
-        gWindow = SDL_CreateWindow( "SDL Tutorial", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_SHOWN );
-        if( gWindow == NULL )
+        // Drop targets nobody has asked for in a while
+        if(!entry.inUse && mFrame - entry.lastUsedFrame > TARGET_POOL_EVICT_FRAMES)
         {
-            printf( "Window could not be created! SDL Error: %s\n", SDL_GetError() );
-            success = false;
+            mEntries[i] = std::move(mEntries.back());
+            mEntries.pop_back();
         }
         else
         {
-            //Create renderer for window
-            gRenderer = SDL_CreateRenderer( gWindow, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC );
-            if( gRenderer == NULL )
-            {
-                printf( "Renderer could not be created! SDL Error: %s\n", SDL_GetError() );
-                success = false;
-            }
-            else
-            {
-                //Initialize renderer color
-                SDL_SetRenderDrawColor( gRenderer, 0xFF, 0xFF, 0xFF, 0xFF );
-
-                //Initialize PNG loading
-                int imgFlags = IMG_INIT_PNG;
-                if( !( IMG_Init( imgFlags ) & imgFlags ) )
-                {
-                    printf( "SDL_image could not initialize! SDL_image Error: %s\n", IMG_GetError() );
-                    success = false;
-                }
-#ifdef _SDL_TTF_H
-                // Initialize SDL_ttf
-                if( TTF_Init() == -1 )
-                {
-                    std::cout << "SDL_ttf could not initialize! SDL_ttf Error: " << SDL_GetError() ;
-                    success = false;
-                }
-#endif
-            }
+            ++i;
         }
     }
+}
 
-    return success;
+void LRenderTargetPool::free()
+{
+    mEntries.clear();
 }
 
-bool loadMedia()
+int LRenderTargetPool::getCreatedCount()
 {
-    bool success = true;
+    return mCreatedCount;
+}
 
-    if(!gTargetTexture.createBlank(SCREEN_WIDTH ,SCREEN_HEIGHT, SDL_TEXTUREACCESS_TARGET))
-    {
-        std::cout << "Failed to create target texture!" << std::endl;
-        success = false;
-    }
+int LRenderTargetPool::getReusedCount()
+{
+    return mReusedCount;
+}
 
-    return success;
+int LRenderTargetPool::getPooledCount()
+{
+    return (int)mEntries.size();
 }
 
-void close()
+Uint64 LRenderTargetPool::makeKey(int width, int height, Uint32 format)
+{
+    return ((Uint64)format << 32) | ((Uint64)(width & 0xffff) << 16) | (Uint64)(height & 0xffff);
+}
+
+LTexture* LRenderTargetPool::take(int width, int height, Uint32 format, bool frameScoped)
 {
-    // Free loaded images
-    gTargetTexture.free();
+    Uint64 key = makeKey(width, height, format);
 
+    // Reuse a free target of the same size and format
+    for(auto& entry : mEntries)
+    {
+        if(!entry.inUse && entry.key == key)
+        {
+            entry.inUse = true;
+            entry.frameScoped = frameScoped;
+            entry.lastUsedFrame = mFrame;
+            ++mReusedCount;
+
+            // Clear state left by the previous user
+            entry.texture->setBlendMode(SDL_BLENDMODE_NONE);
+            entry.texture->setColor(0xff, 0xff, 0xff);
+            entry.texture->setAlpha(0xff);
+            return entry.texture.get();
+        }
+    }
 
-#ifdef _SDL_TTF_H
-    // Free global font
-    TTF_CloseFont(gFont);
-    TTF_Quit();
-#endif
+    // Nothing free, create a new one
+    Entry entry;
+    entry.texture.reset(new LTexture());
+    if(!entry.texture->createBlank(width, height, SDL_TEXTUREACCESS_TARGET, format))
+    {
+        return nullptr;
+    }
+    entry.key = key;
+    entry.inUse = true;
+    entry.frameScoped = frameScoped;
+    entry.lastUsedFrame = mFrame;
+    ++mCreatedCount;
+
+    mEntries.push_back(std::move(entry));
+    return mEntries.back().texture.get();
+}
+/**************************************************************************/
 
-    // Destroy window
-    SDL_DestroyRenderer(gRenderer);
-    SDL_DestroyWindow(gWindow);
 
-    // Quit SDL subsystem
-    IMG_Quit();
-    SDL_Quit();
+
+/*********************************************************************
+ LPostProcessor Method Declarations
+ *********************************************************************/
+LPostProcessor::LPostProcessor()
+{
+    mWidth = 0;
+    mHeight = 0;
+    mBandCount = 0;
+    mBlurRadius = 0;
+    mGrade = false;
+    mSaturation = 256;
+    mScanlines = 0;
+    mStart = nullptr;
+    mDone = nullptr;
+    SDL_AtomicSet(&mNextBand, 0);
+    SDL_AtomicSet(&mQuit, 0);
+    mPass = PASS_FINISH;
+    mProcessMilliseconds = 0.0;
+    clearColorGrade();
 }
 
-/**************************************************************************
- Main
- **************************************************************************/
-int main( int argc, char* args[] )
+LPostProcessor::~LPostProcessor()
+{
+    free();
+}
+
+bool LPostProcessor::init(int width, int height, int threadCount)
 {
+    // Get rid of pre-existing workers
+    free();
 
-    //Start up SDL and create window
-    if( !init() )
+    mWidth = width;
+    mHeight = height;
+    mBandCount = (height + POST_BAND_ROWS - 1) / POST_BAND_ROWS;
+    mFrame.assign(width * height, 0);
+    mTemp.assign(width * height, 0);
+
+    // This thread works too, so leave one core for it
+    if(threadCount <= 0)
     {
-        printf( "Failed to initialize!\n" );
+        threadCount = SDL_GetCPUCount() - 1;
     }
-    else
+    if(threadCount > POST_MAX_THREADS)
     {
-        //Load media
-        if( !loadMedia() )
-        {
-            printf( "Failed to load media!\n" );
-        }
-        else
-        {
-            //Main loop flag
-            bool quit = false;
+        threadCount = POST_MAX_THREADS;
+    }
+    if(threadCount < 0)
+    {
+        threadCount = 0;
+    }
 
-            //Event handler
-            SDL_Event e;
+    mColumnSums.assign(threadCount + 1, std::vector<Uint16>(width * 4));
 
+    mStart = SDL_CreateSemaphore(0);
+    mDone = SDL_CreateSemaphore(0);
+    if(mStart == nullptr || mDone == nullptr)
+    {
+        std::cout << "Unable to create post processing semaphores! SDL Error: " << SDL_GetError() << std::endl;
+        return false;
+    }
 
-            // Rotation variable
-            double angle = 0;
-            SDL_Point screenCenter = {SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2};
+    SDL_AtomicSet(&mQuit, 0);
+
+    // Worker records must not move once threads hold them
+    mWorkers.resize(threadCount);
+    for(int i = 0; i < threadCount; ++i)
+    {
+        mWorkers[i].owner = this;
+        mWorkers[i].index = i + 1;
+        SDL_Thread* thread = SDL_CreateThread(workerThread, "PostWorker", &mWorkers[i]);
+        if(thread == nullptr)
+        {
+            // Fewer workers still works, this thread picks up the slack
+            std::cout << "Unable to create post processing worker! SDL Error: " << SDL_GetError() << std::endl;
+            break;
+        }
+        mThreads.push_back(thread);
+    }
+
+    return true;
+}
+
+void LPostProcessor::free()
+{
+    // Wake workers so they see the quit flag
+    SDL_AtomicSet(&mQuit, 1);
+    for(size_t i = 0; i < mThreads.size(); ++i)
+    {
+        SDL_SemPost(mStart);
+    }
+    for(auto thread : mThreads)
+    {
+        SDL_WaitThread(thread, NULL);
+    }
+    mThreads.clear();
+    mWorkers.clear();
+
+    if(mStart != nullptr)
+    {
+        SDL_DestroySemaphore(mStart);
+        mStart = nullptr;
+    }
+    if(mDone != nullptr)
+    {
+        SDL_DestroySemaphore(mDone);
+        mDone = nullptr;
+    }
+
+    mFrame.clear();
+    mTemp.clear();
+    mColumnSums.clear();
+    mWidth = 0;
+    mHeight = 0;
+    mBandCount = 0;
+}
+
+void LPostProcessor::setBlur(int radius)
+{
+    // Column sums are 16 bit
+    if(radius > POST_MAX_BLUR_RADIUS)
+    {
+        radius = POST_MAX_BLUR_RADIUS;
+    }
+    mBlurRadius = radius > 0 ? radius : 0;
+}
+
+int LPostProcessor::getBlur()
+{
+    return mBlurRadius;
+}
+
+void LPostProcessor::setColorGrade(float contrast, float saturation, Uint8 red, Uint8 green, Uint8 blue)
+{
+    buildGradeTable(contrast, red, green, blue);
+    mSaturation = (int)(saturation * 256.0f + 0.5f);
+    mGrade = true;
+}
+
+void LPostProcessor::clearColorGrade()
+{
+    buildGradeTable(1.0f, 0xff, 0xff, 0xff);
+    mSaturation = 256;
+    mGrade = false;
+}
+
+bool LPostProcessor::hasColorGrade()
+{
+    return mGrade;
+}
+
+void LPostProcessor::setScanlines(Uint8 strength)
+{
+    mScanlines = strength;
+}
+
+Uint8 LPostProcessor::getScanlines()
+{
+    return mScanlines;
+}
+
+bool LPostProcessor::isActive()
+{
+    return mBlurRadius > 0 || mGrade || mScanlines > 0;
+}
+
+void LPostProcessor::process()
+{
+    if(mWidth == 0 || !isActive())
+    {
+        return;
+    }
+
+    Uint64 start = SDL_GetPerformanceCounter();
+
+    // Separable blur goes frame -> temp -> frame
+    if(mBlurRadius > 0)
+    {
+        runPass(PASS_BLUR_HORIZONTAL);
+        runPass(PASS_BLUR_VERTICAL);
+    }
+
+    // Grade and scanlines are per pixel so they share a pass
+    if(mGrade || mScanlines > 0)
+    {
+        runPass(PASS_FINISH);
+    }
+
+    mProcessMilliseconds = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+}
+
+Uint32* LPostProcessor::getPixels()
+{
+    return mFrame.empty() ? nullptr : &mFrame[0];
+}
+
+int LPostProcessor::getPitch()
+{
+    return mWidth * 4;
+}
+
+double LPostProcessor::getProcessMilliseconds()
+{
+    return mProcessMilliseconds;
+}
+
+int LPostProcessor::workerThread(void* data)
+{
+    Worker* worker = (Worker*)data;
+    LPostProcessor* owner = worker->owner;
+
+    while(true)
+    {
+        SDL_SemWait(owner->mStart);
+        if(SDL_AtomicGet(&owner->mQuit))
+        {
+            break;
+        }
+        owner->processBands(worker->index);
+        SDL_SemPost(owner->mDone);
+    }
+    return 0;
+}
+
+void LPostProcessor::runPass(Pass pass)
+{
+    // Publish the pass before waking anyone
+    mPass = pass;
+    SDL_AtomicSet(&mNextBand, 0);
+    for(size_t i = 0; i < mThreads.size(); ++i)
+    {
+        SDL_SemPost(mStart);
+    }
+
+    processBands(0);
+
+    // Every band is done once every worker checked in
+    for(size_t i = 0; i < mThreads.size(); ++i)
+    {
+        SDL_SemWait(mDone);
+    }
+}
+
+void LPostProcessor::processBands(int worker)
+{
+    while(true)
+    {
+        int band = SDL_AtomicAdd(&mNextBand, 1);
+        if(band >= mBandCount)
+        {
+            break;
+        }
+
+        int y0 = band * POST_BAND_ROWS;
+        int y1 = y0 + POST_BAND_ROWS < mHeight ? y0 + POST_BAND_ROWS : mHeight;
+
+        switch(mPass)
+        {
+            case PASS_BLUR_HORIZONTAL:
+                blurRowsHorizontal(&mFrame[0], &mTemp[0], mWidth, y0, y1, mBlurRadius);
+                break;
+
+            case PASS_BLUR_VERTICAL:
+                blurRowsVertical(&mTemp[0], &mFrame[0], mWidth, mHeight, y0, y1, mBlurRadius, &mColumnSums[worker][0]);
+                break;
+
+            case PASS_FINISH:
+                if(mGrade)
+                {
+                    gradePixels(&mFrame[0], mWidth, y0, y1, mGradeTable, mSaturation);
+                }
+                if(mScanlines > 0)
+                {
+                    scanlinePixels(&mFrame[0], mWidth, y0, y1, mScanlines);
+                }
+                break;
+        }
+    }
+}
+
+void LPostProcessor::buildGradeTable(float contrast, Uint8 red, Uint8 green, Uint8 blue)
+{
+    Uint8 tint[3] = {red, green, blue};
+    for(int channel = 0; channel < 3; ++channel)
+    {
+        for(int value = 0; value < 256; ++value)
+        {
+            // Stretch around mid grey then apply the tint
+            float graded = ((value - 128.0f) * contrast + 128.0f) * tint[channel] / 255.0f;
+            if(graded < 0.0f)
+            {
+                graded = 0.0f;
+            }
+            else if(graded > 255.0f)
+            {
+                graded = 255.0f;
+            }
+            mGradeTable[channel][value] = (Uint8)(graded + 0.5f);
+        }
+    }
+}
+/**************************************************************************/
+
+
+
+/*********************************************************************
+ LLayerCompositor Method Declarations
+ *********************************************************************/
+LLayerCompositor::LLayerCompositor()
+{
+    mRedrawCount = 0;
+}
+
+LLayerCompositor::~LLayerCompositor()
+{
+    free();
+}
+
+int LLayerCompositor::addLayer(int width, int height, DrawFunc draw, SDL_Color clearColor)
+{
+    Layer layer;
+    layer.target = gTargetPool.acquire(width, height);
+    if(layer.target == nullptr)
+    {
+        std::cout << "Unable to create layer target!" << std::endl;
+        return -1;
+    }
+
+    // Transparent layers blend over the ones below
+    layer.target->setBlendMode(SDL_BLENDMODE_BLEND);
+
+    layer.draw = draw;
+    layer.clearColor = clearColor;
+    layer.dirty = true;
+    layer.visible = true;
+    layer.x = 0;
+    layer.y = 0;
+    layer.angle = 0.0;
+    layer.hasCenter = false;
+    layer.center = {0, 0};
+
+    mLayers.push_back(layer);
+    return (int)mLayers.size() - 1;
+}
+
+void LLayerCompositor::free()
+{
+    // Hand targets back to the pool
+    for(auto& l : mLayers)
+    {
+        gTargetPool.release(l.target);
+    }
+    mLayers.clear();
+}
+
+void LLayerCompositor::markDirty(int layer)
+{
+    Layer* l = getLayer(layer);
+    if(l != nullptr)
+    {
+        l->dirty = true;
+    }
+}
+
+void LLayerCompositor::markAllDirty()
+{
+    for(auto& l : mLayers)
+    {
+        l.dirty = true;
+    }
+}
+
+void LLayerCompositor::setPosition(int layer, int x, int y)
+{
+    Layer* l = getLayer(layer);
+    if(l != nullptr)
+    {
+        l->x = x;
+        l->y = y;
+    }
+}
+
+void LLayerCompositor::setRotation(int layer, double angle, SDL_Point* center)
+{
+    Layer* l = getLayer(layer);
+    if(l != nullptr)
+    {
+        l->angle = angle;
+        l->hasCenter = center != nullptr;
+        if(center != nullptr)
+        {
+            l->center = *center;
+        }
+    }
+}
+
+void LLayerCompositor::setAlpha(int layer, Uint8 alpha)
+{
+    Layer* l = getLayer(layer);
+    if(l != nullptr)
+    {
+        l->target->setAlpha(alpha);
+    }
+}
+
+void LLayerCompositor::setVisible(int layer, bool visible)
+{
+    Layer* l = getLayer(layer);
+    if(l != nullptr)
+    {
+        l->visible = visible;
+    }
+}
+
+void LLayerCompositor::compose()
+{
+    // Composite into whatever target was current
+    SDL_Texture* target = SDL_GetRenderTarget(gRenderer);
+
+    // Only dirty layers touch their render target
+    bool redrew = false;
+    for(auto& l : mLayers)
+    {
+        if(l.dirty)
+        {
+            l.target->setAsRenderTarget();
+            SDL_SetRenderDrawColor(gRenderer, l.clearColor.r, l.clearColor.g, l.clearColor.b, l.clearColor.a);
+            SDL_RenderClear(gRenderer);
+            if(l.draw)
+            {
+                l.draw();
+            }
+            l.dirty = false;
+            redrew = true;
+            ++mRedrawCount;
+        }
+    }
+
+    // Reset render target
+    if(redrew)
+    {
+        SDL_SetRenderTarget(gRenderer, target);
+    }
+
+    // Composite back to front with each layer's transform
+    for(auto& l : mLayers)
+    {
+        if(l.visible)
+        {
+            l.target->render(l.x, l.y, NULL, l.angle, l.hasCenter ? &l.center : nullptr);
+        }
+    }
+}
+
+int LLayerCompositor::getRedrawCount()
+{
+    return mRedrawCount;
+}
+
+LLayerCompositor::Layer* LLayerCompositor::getLayer(int layer)
+{
+    if(layer < 0 || layer >= (int)mLayers.size())
+    {
+        return nullptr;
+    }
+    return &mLayers[layer];
+}
+/**************************************************************************/
+
+
+
+/***************************************************************************
+ Pixel Kernels
+ ***************************************************************************/
+
+// Multiplies two bytes as if they were 0 to 1, rounding like the SIMD versions
+inline Uint32 mulDiv255(Uint32 a, Uint32 b)
+{
+    Uint32 x = a * b + 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+// Multiplies each byte of a pixel by the matching byte of the factor
+inline Uint32 mulPixel(Uint32 pixel, Uint32 factor)
+{
+    Uint32 result = 0;
+    for(int shift = 0; shift < 32; shift += 8)
+    {
+        result |= mulDiv255((pixel >> shift) & 0xff, (factor >> shift) & 0xff) << shift;
+    }
+    return result;
+}
+
+// Box sum divisor as a 16 bit multiply-high factor. The factor is rounded up so for some radii
+// (first at 8, e.g. 1009 for 32) a result can land one above the true average, never above 255,
+// for radii 1 to POST_MAX_BLUR_RADIUS and sums up to 255 per tap
+inline Uint32 boxReciprocal(int radius)
+{
+    return 65536 / (radius * 2 + 1) + 1;
+}
+
+inline int clampIndex(int i, int size)
+{
+    return i < 0 ? 0 : (i >= size ? size - 1 : i);
+}
+
+#ifdef PIXEL_KERNELS_SSE2
+inline __m128i mulDiv255SSE2(__m128i a, __m128i b)
+{
+    __m128i x = _mm_add_epi16(_mm_mullo_epi16(a, b), _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+// Four pixels at a time
+inline __m128i mulPixelsSSE2(__m128i pixels, __m128i factors)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i low = mulDiv255SSE2(_mm_unpacklo_epi8(pixels, zero), _mm_unpacklo_epi8(factors, zero));
+    __m128i high = mulDiv255SSE2(_mm_unpackhi_epi8(pixels, zero), _mm_unpackhi_epi8(factors, zero));
+    return _mm_packus_epi16(low, high);
+}
+
+// One pixel widened to four 16 bit channels
+inline __m128i widenPixelSSE2(Uint32 pixel)
+{
+    return _mm_unpacklo_epi8(_mm_cvtsi32_si128((int)pixel), _mm_setzero_si128());
+}
+#endif
+
+void blurRowsHorizontal(const Uint32* src, Uint32* dst, int width, int y0, int y1, int radius)
+{
+    Uint32 reciprocal = boxReciprocal(radius);
+
+    for(int y = y0; y < y1; ++y)
+    {
+        const Uint32* in = src + y * width;
+        Uint32* out = dst + y * width;
+
+        // Running sum slides along the row, one add and one subtract per pixel
+#ifdef PIXEL_KERNELS_SSE2
+        __m128i zero = _mm_setzero_si128();
+        __m128i reciprocal8 = _mm_set1_epi16((short)reciprocal);
+        __m128i sum = zero;
+        for(int k = -radius; k <= radius; ++k)
+        {
+            sum = _mm_add_epi16(sum, widenPixelSSE2(in[clampIndex(k, width)]));
+        }
+        for(int x = 0; x < width; ++x)
+        {
+            out[x] = (Uint32)_mm_cvtsi128_si32(_mm_packus_epi16(_mm_mulhi_epu16(sum, reciprocal8), zero));
+            sum = _mm_add_epi16(sum, widenPixelSSE2(in[clampIndex(x + radius + 1, width)]));
+            sum = _mm_sub_epi16(sum, widenPixelSSE2(in[clampIndex(x - radius, width)]));
+        }
+#else
+        Uint32 sum[4] = {0, 0, 0, 0};
+        for(int k = -radius; k <= radius; ++k)
+        {
+            Uint32 pixel = in[clampIndex(k, width)];
+            for(int c = 0; c < 4; ++c)
+            {
+                sum[c] += (pixel >> (c * 8)) & 0xff;
+            }
+        }
+        for(int x = 0; x < width; ++x)
+        {
+            Uint32 pixel = 0;
+            Uint32 incoming = in[clampIndex(x + radius + 1, width)];
+            Uint32 outgoing = in[clampIndex(x - radius, width)];
+            for(int c = 0; c < 4; ++c)
+            {
+                pixel |= ((sum[c] * reciprocal) >> 16) << (c * 8);
+                sum[c] += ((incoming >> (c * 8)) & 0xff) - ((outgoing >> (c * 8)) & 0xff);
+            }
+            out[x] = pixel;
+        }
+#endif
+    }
+}
+
+// Adds one row into the column sums and removes another, either may be NULL
+void accumulateRow(Uint16* sums, const Uint32* add, const Uint32* remove, int width)
+{
+    int x = 0;
+
+#ifdef PIXEL_KERNELS_SSE2
+    __m128i zero = _mm_setzero_si128();
+    for(; x + 4 <= width; x += 4)
+    {
+        __m128i low = _mm_loadu_si128((__m128i*)(sums + x * 4));
+        __m128i high = _mm_loadu_si128((__m128i*)(sums + x * 4 + 8));
+        if(add != NULL)
+        {
+            __m128i block = _mm_loadu_si128((__m128i*)(add + x));
+            low = _mm_add_epi16(low, _mm_unpacklo_epi8(block, zero));
+            high = _mm_add_epi16(high, _mm_unpackhi_epi8(block, zero));
+        }
+        if(remove != NULL)
+        {
+            __m128i block = _mm_loadu_si128((__m128i*)(remove + x));
+            low = _mm_sub_epi16(low, _mm_unpacklo_epi8(block, zero));
+            high = _mm_sub_epi16(high, _mm_unpackhi_epi8(block, zero));
+        }
+        _mm_storeu_si128((__m128i*)(sums + x * 4), low);
+        _mm_storeu_si128((__m128i*)(sums + x * 4 + 8), high);
+    }
+#endif
+    // Leftover pixels
+    for(; x < width; ++x)
+    {
+        for(int c = 0; c < 4; ++c)
+        {
+            if(add != NULL)
+            {
+                sums[x * 4 + c] += (add[x] >> (c * 8)) & 0xff;
+            }
+            if(remove != NULL)
+            {
+                sums[x * 4 + c] -= (remove[x] >> (c * 8)) & 0xff;
+            }
+        }
+    }
+}
+
+void blurRowsVertical(const Uint32* src, Uint32* dst, int width, int height, int y0, int y1, int radius, Uint16* sums)
+{
+    Uint32 reciprocal = boxReciprocal(radius);
+
+    // Prime the column sums with the window around the first row
+    memset(sums, 0, width * 4 * sizeof(Uint16));
+    for(int k = -radius; k <= radius; ++k)
+    {
+        accumulateRow(sums, src + clampIndex(y0 + k, height) * width, NULL, width);
+    }
+
+    for(int y = y0; y < y1; ++y)
+    {
+        Uint32* out = dst + y * width;
+        int x = 0;
+
+#ifdef PIXEL_KERNELS_SSE2
+        __m128i reciprocal8 = _mm_set1_epi16((short)reciprocal);
+        for(; x + 4 <= width; x += 4)
+        {
+            __m128i low = _mm_mulhi_epu16(_mm_loadu_si128((__m128i*)(sums + x * 4)), reciprocal8);
+            __m128i high = _mm_mulhi_epu16(_mm_loadu_si128((__m128i*)(sums + x * 4 + 8)), reciprocal8);
+            _mm_storeu_si128((__m128i*)(out + x), _mm_packus_epi16(low, high));
+        }
+#endif
+        // Leftover pixels
+        for(; x < width; ++x)
+        {
+            Uint32 pixel = 0;
+            for(int c = 0; c < 4; ++c)
+            {
+                pixel |= ((sums[x * 4 + c] * reciprocal) >> 16) << (c * 8);
+            }
+            out[x] = pixel;
+        }
+
+        // Slide the window down a row
+        if(y + 1 < y1)
+        {
+            accumulateRow(sums, src + clampIndex(y + radius + 1, height) * width,
+                          src + clampIndex(y - radius, height) * width, width);
+        }
+    }
+}
+
+void gradePixels(Uint32* pixels, int width, int y0, int y1, const Uint8 table[3][256], int saturation)
+{
+    // Table lookups have no SSE2 gather, so this one stays scalar
+    for(int y = y0; y < y1; ++y)
+    {
+        Uint32* row = pixels + y * width;
+        for(int x = 0; x < width; ++x)
+        {
+            Uint32 pixel = row[x];
+            int r = table[0][(pixel >> 16) & 0xff];
+            int g = table[1][(pixel >> 8) & 0xff];
+            int b = table[2][pixel & 0xff];
+
+            // Push channels toward or away from luma
+            if(saturation != 256)
+            {
+                int luma = (r * 77 + g * 150 + b * 29) >> 8;
+                r = luma + (r - luma) * saturation / 256;
+                g = luma + (g - luma) * saturation / 256;
+                b = luma + (b - luma) * saturation / 256;
+                r = r < 0 ? 0 : (r > 255 ? 255 : r);
+                g = g < 0 ? 0 : (g > 255 ? 255 : g);
+                b = b < 0 ? 0 : (b > 255 ? 255 : b);
+            }
+
+            row[x] = (pixel & 0xff000000) | (r << 16) | (g << 8) | b;
+        }
+    }
+}
+
+void scanlinePixels(Uint32* pixels, int width, int y0, int y1, Uint8 strength)
+{
+    // Darken color but keep alpha
+    Uint32 level = 0xff - strength;
+    Uint32 factor = 0xff000000 | (level * 0x010101);
+
+    // Only odd rows
+    for(int y = y0 | 1; y < y1; y += 2)
+    {
+        Uint32* row = pixels + y * width;
+        int x = 0;
+
+#ifdef PIXEL_KERNELS_SSE2
+        __m128i factor4 = _mm_set1_epi32((int)factor);
+        for(; x + 4 <= width; x += 4)
+        {
+            __m128i block = _mm_loadu_si128((__m128i*)(row + x));
+            _mm_storeu_si128((__m128i*)(row + x), mulPixelsSSE2(block, factor4));
+        }
+#endif
+        // Leftover pixels
+        for(; x < width; ++x)
+        {
+            row[x] = mulPixel(row[x], factor);
+        }
+    }
+}
+/**************************************************************************/
+
+
+
+/***************************************************************************
+ Function Definitions
+ ***************************************************************************/
+
+bool init()
+{
+    //Initialization flag
+    bool success = true;
+
+    //Initialize SDL
+    if( SDL_Init( SDL_INIT_VIDEO ) < 0 )
+    {
+        printf( "SDL could not initialize! SDL Error: %s\n", SDL_GetError() );
+        success = false;
+    }
+    else
+    {
+        //Set texture filtering to linear
+        if( !SDL_SetHint( SDL_HINT_RENDER_SCALE_QUALITY, "1" ) )
+        {
+            printf( "Warning: Linear texture filtering not enabled!" );
+        }
+
+        //Create window
+        gWindow = SDL_CreateWindow( "SDL Tutorial", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_SHOWN );
+        if( gWindow == NULL )
+        {
+            printf( "Window could not be created! SDL Error: %s\n", SDL_GetError() );
+            success = false;
+        }
+        else
+        {
+            //Create renderer for window
+            gRenderer = SDL_CreateRenderer( gWindow, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC );
+            if( gRenderer == NULL )
+            {
+                // No GPU, post processing runs on the CPU anyway
+                printf( "Accelerated renderer unavailable, using software! SDL Error: %s\n", SDL_GetError() );
+                gRenderer = SDL_CreateRenderer( gWindow, -1, SDL_RENDERER_SOFTWARE | SDL_RENDERER_TARGETTEXTURE );
+            }
+            if( gRenderer == NULL )
+            {
+                printf( "Renderer could not be created! SDL Error: %s\n", SDL_GetError() );
+                success = false;
+            }
+            else
+            {
+                //Initialize renderer color
+                SDL_SetRenderDrawColor( gRenderer, 0xFF, 0xFF, 0xFF, 0xFF );
+
+                //Initialize PNG loading
+                int imgFlags = IMG_INIT_PNG;
+                if( !( IMG_Init( imgFlags ) & imgFlags ) )
+                {
+                    printf( "SDL_image could not initialize! SDL_image Error: %s\n", IMG_GetError() );
+                    success = false;
+                }
+#ifdef _SDL_TTF_H
+                // Initialize SDL_ttf
+                if( TTF_Init() == -1 )
+                {
+                    std::cout << "SDL_ttf could not initialize! SDL_ttf Error: " << SDL_GetError() ;
+                    success = false;
+                }
+#endif
+            }
+        }
+    }
+
+    return success;
+}
+
+bool loadMedia()
+{
+    bool success = true;
+
+    // Scene only changes when marked dirty
+    gSceneLayer = gCompositor.addLayer(SCREEN_WIDTH, SCREEN_HEIGHT, drawScene, {0xff, 0xff, 0xff, 0xff});
+    if(gSceneLayer < 0)
+    {
+        std::cout << "Failed to create scene layer!" << std::endl;
+        success = false;
+    }
+
+    // Frame buffers and workers for the post effects
+    if(!gPostProcessor.init(SCREEN_WIDTH, SCREEN_HEIGHT) ||
+       !gPostTexture.createBlank(SCREEN_WIDTH, SCREEN_HEIGHT, SDL_TEXTUREACCESS_STREAMING, SDL_PIXELFORMAT_ARGB8888))
+    {
+        std::cout << "Failed to set up post processing!" << std::endl;
+        success = false;
+    }
+    else
+    {
+        gPostProcessor.setColorGrade(1.15f, 0.8f, 0xff, 0xf0, 0xe0);
+        gPostProcessor.setScanlines(0x40);
+    }
+
+    return success;
+}
+
+void close()
+{
+    // Stop post processing workers
+    std::cout << "Last post process took " << gPostProcessor.getProcessMilliseconds() << "ms" << std::endl;
+    gPostProcessor.free();
+    gPostTexture.free();
+
+    // Free layers
+    gCompositor.free();
+
+    std::cout << "Render targets created: " << gTargetPool.getCreatedCount()
+              << " reused: " << gTargetPool.getReusedCount() << std::endl;
+    gTargetPool.free();
+
+
+#ifdef _SDL_TTF_H
+    // Free global font
+    TTF_CloseFont(gFont);
+    TTF_Quit();
+#endif
+
+    // Destroy window
+    SDL_DestroyRenderer(gRenderer);
+    SDL_DestroyWindow(gWindow);
+
+    // Quit SDL subsystem
+    IMG_Quit();
+    SDL_Quit();
+}
+
+void drawScene()
+{
+    // Render red filled quad
+    SDL_SetRenderDrawColor(gRenderer, 0xff, 0x00, 0x00, 0xff);
+    SDL_Rect fillRect = {SCREEN_WIDTH/4, SCREEN_HEIGHT/4, SCREEN_WIDTH/2, SCREEN_HEIGHT/2};
+    SDL_RenderFillRect(gRenderer, &fillRect);
+
+    // Render green outlined quad
+    SDL_Rect outlineRect = {SCREEN_WIDTH/6, SCREEN_HEIGHT/6, SCREEN_WIDTH * 2 / 3, SCREEN_HEIGHT * 2 / 3};
+    SDL_SetRenderDrawColor(gRenderer, 0x00, 0xff, 0x00, 0xff);
+    SDL_RenderDrawRect(gRenderer, &outlineRect);
+
+    // Draw blue horizontal line
+    SDL_SetRenderDrawColor(gRenderer, 0x00, 0x00, 0xff, 0xff);
+    SDL_RenderDrawLine(gRenderer, 0, SCREEN_HEIGHT/2, SCREEN_WIDTH, SCREEN_HEIGHT /2 );
+
+    // Draw vertical line of yello dots
+    SDL_SetRenderDrawColor(gRenderer, 0xff, 0xff, 0x00, 0xff);
+    for(auto i = 0; i < SCREEN_HEIGHT; i += 4)
+    {
+        SDL_RenderDrawPoint(gRenderer, SCREEN_WIDTH / 2, i);
+    }
+}
+
+/**************************************************************************
+ Main
+ **************************************************************************/
+int main( int argc, char* args[] )
+{
+
+    //Start up SDL and create window
+    if( !init() )
+    {
+        printf( "Failed to initialize!\n" );
+    }
+    else
+    {
+        //Load media
+        if( !loadMedia() )
+        {
+            printf( "Failed to load media!\n" );
+        }
+        else
+        {
+            //Main loop flag
+            bool quit = false;
+
+            //Event handler
+            SDL_Event e;
+
+
+            // Rotation variable
+            double angle = 0;
+            SDL_Point screenCenter = {SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2};
 
 
             //While application is running
@@ -523,6 +1731,36 @@ int main( int argc, char* args[] )
                     {
                         quit = true;
                     }
+                    // Target contents are lost on device reset
+                    else if( e.type == SDL_RENDER_TARGETS_RESET || e.type == SDL_RENDER_DEVICE_RESET )
+                    {
+                        gCompositor.markAllDirty();
+                    }
+                    // Toggle post effects
+                    else if( e.type == SDL_KEYDOWN )
+                    {
+                        switch( e.key.keysym.sym )
+                        {
+                            case SDLK_b:
+                            gPostProcessor.setBlur(gPostProcessor.getBlur() > 0 ? 0 : 4);
+                            break;
+
+                            case SDLK_g:
+                            if(gPostProcessor.hasColorGrade())
+                            {
+                                gPostProcessor.clearColorGrade();
+                            }
+                            else
+                            {
+                                gPostProcessor.setColorGrade(1.15f, 0.8f, 0xff, 0xf0, 0xe0);
+                            }
+                            break;
+
+                            case SDLK_s:
+                            gPostProcessor.setScanlines(gPostProcessor.getScanlines() > 0 ? 0 : 0x40);
+                            break;
+                        }
+                    }
 
                 }
 
@@ -533,43 +1771,44 @@ int main( int argc, char* args[] )
                     angle -= 360;
                 }
 
-                // Set self as render target
-                gTargetTexture.setAsRenderTarget();
+                // Only the transform changes, scene stays cached
+                gCompositor.setRotation(gSceneLayer, angle, &screenCenter);
+
+                // Composite offscreen when effects need the pixels
+                LTexture* frameTarget = nullptr;
+                if(gPostProcessor.isActive())
+                {
+                    frameTarget = gTargetPool.acquireFrame(SCREEN_WIDTH, SCREEN_HEIGHT, SDL_PIXELFORMAT_ARGB8888);
+                }
+                if(frameTarget != nullptr)
+                {
+                    frameTarget->setAsRenderTarget();
+                }
 
                 //Clear screen
                 SDL_SetRenderDrawColor( gRenderer, 0xff, 0xff, 0xff, 0xff );
                 SDL_RenderClear( gRenderer );
 
-                // Render red filled quad
-                SDL_SetRenderDrawColor(gRenderer, 0xff, 0x00, 0x00, 0xff);
-                SDL_Rect fillRect = {SCREEN_WIDTH/4, SCREEN_HEIGHT/4, SCREEN_WIDTH/2, SCREEN_HEIGHT/2};
-                SDL_RenderFillRect(gRenderer, &fillRect);
-
-                // Render green outlined quad
-                SDL_Rect outlineRect = {SCREEN_WIDTH/6, SCREEN_HEIGHT/6, SCREEN_WIDTH * 2 / 3, SCREEN_HEIGHT * 2 / 3};
-                SDL_SetRenderDrawColor(gRenderer, 0x00, 0xff, 0x00, 0xff);
-                SDL_RenderDrawRect(gRenderer, &outlineRect);
-
-                // Draw blue horizontal line
-                SDL_SetRenderDrawColor(gRenderer, 0x00, 0x00, 0xff, 0xff);
-                SDL_RenderDrawLine(gRenderer, 0, SCREEN_HEIGHT/2, SCREEN_WIDTH, SCREEN_HEIGHT /2 );
+                gCompositor.compose();
 
-                // Draw vertical line of yello dots
-                SDL_SetRenderDrawColor(gRenderer, 0xff, 0xff, 0x00, 0xff);
-                for(auto i = 0; i < SCREEN_HEIGHT; i += 4)
+                if(frameTarget != nullptr)
                 {
-                    SDL_RenderDrawPoint(gRenderer, SCREEN_WIDTH / 2, i);
+                    // Read the frame back, run the effects and stream it to the screen
+                    SDL_RenderReadPixels(gRenderer, NULL, SDL_PIXELFORMAT_ARGB8888,
+                                         gPostProcessor.getPixels(), gPostProcessor.getPitch());
+                    SDL_SetRenderTarget(gRenderer, NULL);
+
+                    gPostProcessor.process();
+                    gPostTexture.updatePixels(gPostProcessor.getPixels(), gPostProcessor.getPitch());
+                    gPostTexture.render(0, 0);
                 }
 
-                // Reset render target
-                SDL_SetRenderTarget(gRenderer, NULL);
-
-                // Show rendered to texture
-                gTargetTexture.render(0,0,NULL, angle, &screenCenter);
-
                 //Update screen
                 SDL_RenderPresent( gRenderer );
 
+                // Recycle this frame's temporary targets
+                gTargetPool.endFrame();
+
 
             }
         }
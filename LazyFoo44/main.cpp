@@ -10,6 +10,8 @@
 #include <cstdlib>
 #include <string>
 #include <sstream>
+#include <fstream>
+#include <vector>
 #include <sdl.h>
 #include <SDL_image.h>
 
@@ -37,45 +39,145 @@ public:
     // Moves the dot
     void move(float timeStep);
 
-    // Shows the dot
-    void render();
+    // Shows the dot between its previous and current position
+    void render(float alpha = 1.0f);
+
+    // Position after the last move
+    float getPosX();
+    float getPosY();
 
 private:
     // The X and Y offsets of the dot
     float mPosX, mPosY;
 
+    // Offsets before the last move
+    float mPrevX, mPrevY;
+
     // The velocity of the dot
     float mVelX, mVelY;
 };
 /************************************************************************/
 
+/*************************************************************************
+ Clock classes
+ *************************************************************************/
+// Where timers read time from, so a run can use real or scripted time
+class LClock
+{
+public:
+    virtual ~LClock() {}
+
+    // Current time in counts
+    virtual Uint64 getCounts() = 0;
+
+    // Counts per second
+    virtual Uint64 getFrequency() = 0;
+
+    // Sleeps for about the given milliseconds
+    virtual void delay(Uint32 ms) = 0;
+
+    // Returns once the time has reached counts
+    virtual void waitUntil(Uint64 counts) = 0;
+
+    // Called by the main loop once per frame
+    virtual void endFrame() = 0;
+
+    // Current time in milliseconds
+    Uint64 getTicks();
+};
+
+// Wall clock time from the performance counter
+class LRealClock : public LClock
+{
+public:
+    // Constructor
+    LRealClock();
+
+    Uint64 getCounts();
+    Uint64 getFrequency();
+    void delay(Uint32 ms);
+    void waitUntil(Uint64 counts);
+    void endFrame();
+
+private:
+    Uint64 mFrequency;
+};
+
+// Time that only moves when told to, for runs that must repeat exactly
+class LVirtualClock : public LClock
+{
+public:
+    // Constructor
+    LVirtualClock();
+
+    // Counts are nanoseconds
+    Uint64 getCounts();
+    Uint64 getFrequency();
+
+    // Sleeping and waiting jump straight to the requested time
+    void delay(Uint32 ms);
+    void waitUntil(Uint64 counts);
+
+    // Moves on by the next scripted frame length, or the fixed step
+    void endFrame();
+
+    // Moves time forward
+    void advance(Uint64 nanoseconds);
+
+    // Sets the frame length used when there's no script
+    void setFrameStep(Uint64 nanoseconds);
+
+    // Loads frame lengths in milliseconds, one per line, played in order and repeated
+    bool loadScript(std::string path);
+
+private:
+    Uint64 mNow;
+    Uint64 mFrameStep;
+    std::vector<Uint64> mScript;
+    size_t mScriptPos;
+};
+/************************************************************************/
+
 /*************************************************************************
  Timer Class
  *************************************************************************/
 class LTimer
 {
 public:
-    // Constructor
-    LTimer();
+    // Constructor, times with gClock unless given another clock
+    LTimer(LClock* clock = NULL);
 
     void start();
     void stop();
     void pause();
     void unpause();
 
-    //Gets the timer's time
-    Uint32 getTicks();
+    //Gets the timer's time in milliseconds
+    Uint64 getTicks();
+
+    // Gets the timer's time at clock resolution
+    Uint64 getNanoseconds();
+    double getSeconds();
 
     // Checks the status of the timer
     bool isStarted();
     bool isPaused();
 
 private:
-    // The clock time when the timer started
-    Uint32 mStartTicks;
+    // Clock counts elapsed so far
+    Uint64 getCounts();
+
+    // Where the time comes from
+    LClock* mClock;
+
+    // The clock counts when the timer started
+    Uint64 mStartCounts;
 
-    // The ticks stored  when the timer was paused
-    Uint32 mPausedTicks;
+    // The elapsed counts stored when the timer was paused
+    Uint64 mPausedCounts;
+
+    // Clock counts per second
+    Uint64 mFrequency;
 
     // The timer status
     bool mPaused;
@@ -134,6 +236,178 @@ private:
 
 /*********************************************************************/
 
+/*************************************************************************
+ Fixed timestep loop class
+ *************************************************************************/
+class LGameLoop
+{
+public:
+    // Constructor
+    LGameLoop();
+
+    // Starts with an empty accumulator
+    void start();
+
+    // Adds the time since the last frame, clamped so a stall can't flood the simulation
+    void beginFrame(Uint64 elapsedNanoseconds);
+
+    // Consumes one simulation tick if enough time has built up
+    bool step();
+
+    // Fixed simulation tick in seconds
+    float getStepSeconds();
+
+    // How far between the previous and current simulation state to render
+    float getAlpha();
+
+    // Simulation ticks run so far
+    Uint64 getTick();
+
+    // Real time thrown away by the frame and catch-up clamps, in seconds
+    double getDroppedSeconds();
+
+private:
+    // Unsimulated real time
+    Uint64 mAccumulator;
+
+    // Length of a tick
+    Uint64 mStepNanoseconds;
+
+    // Ticks run this frame and overall
+    int mFrameSteps;
+    Uint64 mTick;
+
+    Uint64 mDropped;
+};
+
+/*********************************************************************/
+
+/*************************************************************************
+ Frame pacer class
+ *************************************************************************/
+// Holds frames to a fixed rate, sleeping for most of the wait and spinning the rest
+class LFramePacer
+{
+public:
+    // Constructor
+    LFramePacer();
+
+    // Starts a fresh schedule at the given rate
+    void start(int fps);
+
+    // Blocks until the next frame deadline
+    void wait();
+
+    // Frames that were already past their deadline and schedules restarted after falling behind
+    int getLateFrames();
+    int getResyncs();
+
+private:
+    // Deadline of a frame on the absolute schedule
+    Uint64 getDeadline(Uint64 frame);
+
+    Uint64 mFrequency;
+    int mFps;
+
+    // Absolute schedule
+    Uint64 mStart;
+    Uint64 mFrame;
+
+    // How long before a deadline to stop sleeping, learned from oversleeps
+    Uint64 mSpinCounts;
+    Uint64 mMinSpinCounts;
+
+    int mLateFrames;
+    int mResyncs;
+};
+
+/*********************************************************************/
+
+/*************************************************************************
+ Present policy class
+ *************************************************************************/
+// How frames are handed to the display
+enum PresentMode
+{
+    PRESENT_VSYNC,
+    PRESENT_UNCAPPED,
+    PRESENT_CAPPED,
+    PRESENT_ADAPTIVE,
+    PRESENT_MODE_TOTAL
+};
+
+class LPresentPolicy
+{
+public:
+    // Constructor
+    LPresentPolicy();
+
+    // Selects a mode by name, false if the name is unknown
+    bool setModeByName(std::string name);
+
+    // Switches mode, changing vsync on the attached renderer
+    void setMode(PresentMode mode);
+
+    PresentMode getMode();
+
+    const char* getModeName(PresentMode mode);
+
+    // Flags to create the renderer with for the current mode
+    Uint32 getRendererFlags();
+
+    // Reads the display refresh rate and takes over presenting
+    void attach(SDL_Window* window, SDL_Renderer* renderer);
+
+    // Sets the frame rate the capped mode paces to
+    void setCappedFps(int fps);
+
+    // Remembers when the first input of the frame was generated
+    void handleEvent(SDL_Event& e);
+
+    // Paces and presents the frame, then records input latency
+    void present();
+
+    // Prints the latency measured in each mode
+    void printReport();
+
+private:
+    // Turns vsync on or off, keeping the old state if the driver refuses
+    void setVSync(bool enabled);
+
+    SDL_Renderer* mRenderer;
+    PresentMode mMode;
+    bool mVSync;
+
+    // Display and capped frame rates, and a refresh in performance counter units
+    int mRefreshRate;
+    int mCappedFps;
+    Uint64 mFrequency;
+    Uint64 mRefreshCounts;
+
+    // Paces capped frames, and adaptive frames while vsync is off
+    LFramePacer mPacer;
+
+    // When the last present returned
+    Uint64 mFrameStart;
+
+    // Adaptive mode frames under budget since vsync was dropped
+    int mGoodFrames;
+
+    // Earliest input event since the last present, in performance counter units
+    bool mInputPending;
+    Uint64 mInputCounts;
+
+    // Input to present latency in microseconds per mode
+    Uint64 mLatencyTotal[PRESENT_MODE_TOTAL];
+    Uint64 mLatencyMax[PRESENT_MODE_TOTAL];
+    int mLatencySamples[PRESENT_MODE_TOTAL];
+
+    // Times adaptive mode gave up vsync
+    int mVSyncDrops;
+};
+
+/*********************************************************************/
+
 /**********************************************************************
  Constants
  **********************************************************************/
@@ -141,6 +415,139 @@ const int SCREEN_WIDTH = 800;
 const int SCREEN_HEIGHT = 600;
 const int SCREEN_FPS = 60;
 
+// Simulation ticks per second, independent of the render rate
+const int SIMULATION_HZ = 120;
+
+// Most real time one frame may feed the simulation
+const int SIMULATION_MAX_FRAME_MS = 250;
+
+// Most ticks run per frame before the loop stops catching up
+const int SIMULATION_MAX_STEPS = 10;
+
+// Refresh rate assumed when the display doesn't report one
+const int PRESENT_DEFAULT_REFRESH = 60;
+
+// Time before a frame deadline spent spinning instead of sleeping
+const int PACER_SPIN_MICROSECONDS = 2000;
+
+// Frames behind schedule before the pacer stops catching up and resyncs
+const int PACER_MAX_LAG_FRAMES = 3;
+
+// Adaptive mode restores vsync after this many frames well under a refresh
+const int PRESENT_RECOVER_FRAMES = 120;
+const double PRESENT_RECOVER_RATIO = 0.75;
+
+// Most named causes tracked per frame and hitch listeners
+const int TIME_SOURCE_MAX_CAUSES = 16;
+const int TIME_SOURCE_MAX_SUBSCRIBERS = 8;
+
+// Weight of the newest frame in the smoothed delta
+const double TIME_SOURCE_SMOOTHING = 0.1;
+
+// A frame is a hitch when it takes this many times the smoothed delta and at least the minimum
+const double TIME_SOURCE_HITCH_FACTOR = 3.0;
+const int TIME_SOURCE_HITCH_MIN_MS = 50;
+
+// Frame rate a virtual clock steps at when it has no script
+const int VIRTUAL_CLOCK_FPS = 60;
+/*********************************************************************/
+
+/*************************************************************************
+ Frame time source class
+ *************************************************************************/
+// A frame that took far longer than the ones before it
+struct LHitch
+{
+    // Frame number and how long it really took against what was expected
+    Uint64 frame;
+    Uint64 rawNanoseconds;
+    Uint64 expectedNanoseconds;
+
+    // Marked work that took the most time that frame, "unknown" if none
+    const char* cause;
+    Uint64 causeNanoseconds;
+};
+
+// Called on the main thread when a hitch is detected
+typedef void (*LHitchCallback)(const LHitch& hitch, void* param);
+
+class LTimeSource
+{
+public:
+    // Constructor
+    LTimeSource();
+
+    // Starts timing the first frame
+    void start();
+
+    // Measures the frame that just ended, returns the delta to simulate in nanoseconds
+    Uint64 tick();
+
+    // Registers a hitch listener, false if there's no room left
+    bool subscribe(LHitchCallback callback, void* param);
+
+    // Adds time spent on a named piece of work this frame
+    void addCause(const char* cause, Uint64 nanoseconds);
+
+    // Last measured delta before clamping and smoothing
+    Uint64 getRawNanoseconds();
+
+    // Current smoothed delta
+    Uint64 getSmoothedNanoseconds();
+
+    int getHitchCount();
+
+    // Real time thrown away by outlier clamping, in seconds
+    double getClampedSeconds();
+
+private:
+    struct Cause
+    {
+        const char* name;
+        Uint64 nanoseconds;
+    };
+
+    struct Subscriber
+    {
+        LHitchCallback callback;
+        void* param;
+    };
+
+    // Measures real time between ticks
+    LTimer mTimer;
+
+    Uint64 mFrame;
+    Uint64 mRaw;
+    double mSmoothed;
+
+    Cause mCauses[TIME_SOURCE_MAX_CAUSES];
+    int mCauseCount;
+
+    Subscriber mSubscribers[TIME_SOURCE_MAX_SUBSCRIBERS];
+    int mSubscriberCount;
+
+    int mHitches;
+    Uint64 mClamped;
+};
+
+/*************************************************************************
+ Hitch cause scope class
+ *************************************************************************/
+// Charges the time of the enclosing block to a cause
+class LHitchScope
+{
+public:
+    // Starts timing the work
+    LHitchScope(LTimeSource& source, const char* cause);
+
+    // Adds the elapsed time to the source
+    ~LHitchScope();
+
+private:
+    LTimeSource& mSource;
+    const char* mCause;
+    LTimer mTimer;
+};
 
 /*********************************************************************/
 
@@ -153,6 +560,11 @@ SDL_Window* gWindow = nullptr;
 // The window renderer
 SDL_Renderer* gRenderer = nullptr;
 
+// Clocks timers can read from, real unless a run asks for virtual time
+LRealClock gRealClock;
+LVirtualClock gVirtualClock;
+LClock* gClock = &gRealClock;
+
 #ifdef _SDL_TTF_H
 // Globally used font
 TTF_Font* gFont = nullptr;
@@ -161,6 +573,9 @@ TTF_Font* gFont = nullptr;
 //LTexture gTextTexture;
 LTexture gDotTexture;
 
+// Chooses how frames reach the display
+LPresentPolicy gPresentPolicy;
+
 /*********************************************************************/
 
 /**************************************************************************
@@ -168,15 +583,141 @@ LTexture gDotTexture;
  **************************************************************************/
 bool init();
 
+// Picks the clock from a command line argument, false if it isn't a clock option
+bool selectClock(std::string arg);
+
 bool loadMedia();
 
+// Logs a hitch and what caused it
+void logHitch(const LHitch& hitch, void* param);
+
 void close();
 /************************************************************************/
 
+/************************************************************************
+ LClock Method Declarations
+ *************************************************************************/
+Uint64 LClock::getTicks()
+{
+    // Split the conversion so counts * 1000 can't overflow
+    Uint64 counts = getCounts();
+    Uint64 frequency = getFrequency();
+    return counts / frequency * 1000 + counts % frequency * 1000 / frequency;
+}
+
+LRealClock::LRealClock()
+{
+    mFrequency = SDL_GetPerformanceFrequency();
+}
+
+Uint64 LRealClock::getCounts()
+{
+    return SDL_GetPerformanceCounter();
+}
+
+Uint64 LRealClock::getFrequency()
+{
+    return mFrequency;
+}
+
+void LRealClock::delay(Uint32 ms)
+{
+    SDL_Delay(ms);
+}
+
+void LRealClock::waitUntil(Uint64 counts)
+{
+    while(SDL_GetPerformanceCounter() < counts)
+    {
+    }
+}
+
+void LRealClock::endFrame()
+{
+}
+
+LVirtualClock::LVirtualClock()
+{
+    mNow = 0;
+    mFrameStep = 1000000000 / VIRTUAL_CLOCK_FPS;
+    mScriptPos = 0;
+}
+
+Uint64 LVirtualClock::getCounts()
+{
+    return mNow;
+}
+
+Uint64 LVirtualClock::getFrequency()
+{
+    return 1000000000;
+}
+
+void LVirtualClock::delay(Uint32 ms)
+{
+    mNow += (Uint64)ms * 1000000;
+}
+
+void LVirtualClock::waitUntil(Uint64 counts)
+{
+    if(counts > mNow)
+    {
+        mNow = counts;
+    }
+}
+
+void LVirtualClock::endFrame()
+{
+    if(mScript.empty())
+    {
+        mNow += mFrameStep;
+    }
+    else
+    {
+        mNow += mScript[mScriptPos];
+        mScriptPos = (mScriptPos + 1) % mScript.size();
+    }
+}
+
+void LVirtualClock::advance(Uint64 nanoseconds)
+{
+    mNow += nanoseconds;
+}
+
+void LVirtualClock::setFrameStep(Uint64 nanoseconds)
+{
+    mFrameStep = nanoseconds;
+}
+
+bool LVirtualClock::loadScript(std::string path)
+{
+    std::ifstream script(path.c_str());
+    if(!script)
+    {
+        return false;
+    }
+
+    std::vector<Uint64> steps;
+    double ms = 0;
+    while(script >> ms)
+    {
+        steps.push_back((Uint64)(ms * 1000000.0 + 0.5));
+    }
+    if(steps.empty())
+    {
+        return false;
+    }
+
+    mScript = steps;
+    mScriptPos = 0;
+    return true;
+}
+/**************************************************************************/
+
 /************************************************************************
  LTimer Method Declarations
  *************************************************************************/
-LTimer::LTimer(): mStartTicks(0), mPausedTicks(0), mPaused(false), mStarted(false)
+LTimer::LTimer(LClock* clock): mClock(clock != NULL ? clock : gClock), mStartCounts(0), mPausedCounts(0), mFrequency(mClock->getFrequency()), mPaused(false), mStarted(false)
 {
 }
 
@@ -189,8 +730,8 @@ void LTimer::start()
     mPaused = false;
 
     // Get the current clock time
-    mStartTicks = SDL_GetTicks();
-    mPausedTicks = 0;
+    mStartCounts = mClock->getCounts();
+    mPausedCounts = 0;
 }
 
 void LTimer::stop()
@@ -202,8 +743,8 @@ void LTimer::stop()
     mPaused = false;
 
     // Clear tick variables
-    mStartTicks = 0;
-    mPausedTicks = 0;
+    mStartCounts = 0;
+    mPausedCounts = 0;
 }
 
 void LTimer::pause()
@@ -213,9 +754,9 @@ void LTimer::pause()
     {
         mPaused = true;
 
-        // Calculate the paused tickes
-        mPausedTicks = SDL_GetTicks() - mStartTicks;
-        mStartTicks = 0;
+        // Calculate the paused counts
+        mPausedCounts = mClock->getCounts() - mStartCounts;
+        mStartCounts = 0;
     }
 }
 
@@ -227,18 +768,18 @@ void LTimer::unpause()
         // Unpause the timer
         mPaused = false;
 
-        // Reset the starting ticks
-        mStartTicks = SDL_GetTicks() - mPausedTicks;
+        // Reset the starting counts
+        mStartCounts = mClock->getCounts() - mPausedCounts;
 
-        // Reset the paused ticks
-        mPausedTicks = 0;
+        // Reset the paused counts
+        mPausedCounts = 0;
     }
 }
 
-Uint32 LTimer::getTicks()
+Uint64 LTimer::getCounts()
 {
     // The actual timer time
-    Uint32 time = 0;
+    Uint64 counts = 0;
 
     // If the timer is running
     if(mStarted)
@@ -246,14 +787,31 @@ Uint32 LTimer::getTicks()
         // If the timer is paused
         if(mPaused)
         {
-            time = mPausedTicks;
+            counts = mPausedCounts;
         }
         else
         {
-            time = SDL_GetTicks() - mStartTicks;
+            counts = mClock->getCounts() - mStartCounts;
         }
     }
-    return time;
+    return counts;
+}
+
+Uint64 LTimer::getTicks()
+{
+    return getNanoseconds() / 1000000;
+}
+
+Uint64 LTimer::getNanoseconds()
+{
+    // Split the conversion so counts * 1e9 can't overflow
+    Uint64 counts = getCounts();
+    return counts / mFrequency * 1000000000 + counts % mFrequency * 1000000000 / mFrequency;
+}
+
+double LTimer::getSeconds()
+{
+    return (double)getCounts() / mFrequency;
 }
 
 bool LTimer::isStarted()
@@ -422,7 +980,7 @@ int LTexture::getHeight()
 /*********************************************************************
  Dot Method Declarations
 *********************************************************************/
-Dot::Dot(): mPosX(0), mPosY(0), mVelX(0), mVelY(0){}
+Dot::Dot(): mPosX(0), mPosY(0), mPrevX(0), mPrevY(0), mVelX(0), mVelY(0){}
 
 void Dot::handleEvent(SDL_Event &e)
 {
@@ -454,6 +1012,10 @@ void Dot::handleEvent(SDL_Event &e)
 
 void Dot::move(float timeStep)
 {
+    // Remember where the dot was for interpolation
+    mPrevX = mPosX;
+    mPrevY = mPosY;
+
     // Move the dot left or right
     mPosX += mVelX * timeStep;
 
@@ -478,21 +1040,612 @@ void Dot::move(float timeStep)
     }
 }
 
-void Dot::render()
+void Dot::render(float alpha)
 {
+    // Blend the last two simulation states
+    float x = mPrevX + (mPosX - mPrevX) * alpha;
+    float y = mPrevY + (mPosY - mPrevY) * alpha;
+
     // Show the dot
-    gDotTexture.render((int)mPosX, (int)mPosY);
+    gDotTexture.render((int)x, (int)y);
 }
-/***************************************************************************
- Function Definitions
- ***************************************************************************/
-
-bool init()
+float Dot::getPosX()
 {
-    //Initialization flag
-    bool success = true;
+    return mPosX;
+}
 
-    //Initialize SDL
+float Dot::getPosY()
+{
+    return mPosY;
+}
+/*********************************************************************
+ LGameLoop Method Declarations
+ *********************************************************************/
+LGameLoop::LGameLoop()
+{
+    mAccumulator = 0;
+    mStepNanoseconds = 1000000000 / SIMULATION_HZ;
+    mFrameSteps = 0;
+    mTick = 0;
+    mDropped = 0;
+}
+
+void LGameLoop::start()
+{
+    mAccumulator = 0;
+    mFrameSteps = 0;
+    mTick = 0;
+    mDropped = 0;
+}
+
+void LGameLoop::beginFrame(Uint64 elapsedNanoseconds)
+{
+    Uint64 elapsed = elapsedNanoseconds;
+
+    // A long stall only counts as a bounded amount of simulation time
+    Uint64 maxElapsed = (Uint64)SIMULATION_MAX_FRAME_MS * 1000000;
+    if(elapsed > maxElapsed)
+    {
+        mDropped += elapsed - maxElapsed;
+        elapsed = maxElapsed;
+    }
+
+    mAccumulator += elapsed;
+    mFrameSteps = 0;
+}
+
+bool LGameLoop::step()
+{
+    if(mAccumulator < mStepNanoseconds)
+    {
+        return false;
+    }
+
+    // Give up on catching up rather than spiral as ticks get slower than real time
+    if(mFrameSteps == SIMULATION_MAX_STEPS)
+    {
+        Uint64 excess = mAccumulator - mAccumulator % mStepNanoseconds;
+        mDropped += excess;
+        mAccumulator -= excess;
+        return false;
+    }
+
+    mAccumulator -= mStepNanoseconds;
+    ++mFrameSteps;
+    ++mTick;
+    return true;
+}
+
+float LGameLoop::getStepSeconds()
+{
+    return (float)(mStepNanoseconds / 1000000000.0);
+}
+
+float LGameLoop::getAlpha()
+{
+    return (float)mAccumulator / mStepNanoseconds;
+}
+
+Uint64 LGameLoop::getTick()
+{
+    return mTick;
+}
+
+double LGameLoop::getDroppedSeconds()
+{
+    return mDropped / 1000000000.0;
+}
+/**************************************************************************/
+
+
+
+/*********************************************************************
+ LFramePacer Method Declarations
+ *********************************************************************/
+LFramePacer::LFramePacer()
+{
+    mFrequency = gClock->getFrequency();
+    mFps = 60;
+    mStart = 0;
+    mFrame = 0;
+    mMinSpinCounts = mFrequency * PACER_SPIN_MICROSECONDS / 1000000;
+    mSpinCounts = mMinSpinCounts;
+    mLateFrames = 0;
+    mResyncs = 0;
+}
+
+void LFramePacer::start(int fps)
+{
+    // Read the clock here so the one picked on the command line is used
+    mFrequency = gClock->getFrequency();
+    mMinSpinCounts = mFrequency * PACER_SPIN_MICROSECONDS / 1000000;
+    mSpinCounts = mMinSpinCounts;
+    mFps = fps > 0 ? fps : 1;
+    mStart = gClock->getCounts();
+    mFrame = 0;
+}
+
+void LFramePacer::wait()
+{
+    // Deadlines come from the start time so rounding never builds up
+    ++mFrame;
+    Uint64 deadline = getDeadline(mFrame);
+    Uint64 now = gClock->getCounts();
+
+    if(now < deadline)
+    {
+        // Sleep through the bulk of the wait, the scheduler may oversleep
+        if(deadline - now > mSpinCounts)
+        {
+            Uint64 sleepCounts = deadline - now - mSpinCounts;
+            Uint32 sleepMs = (Uint32)(sleepCounts * 1000 / mFrequency);
+            if(sleepMs > 0)
+            {
+                gClock->delay(sleepMs);
+
+                // Keep the spin margin above the worst recent oversleep
+                Uint64 slept = gClock->getCounts() - now;
+                Uint64 asked = sleepMs * mFrequency / 1000;
+                Uint64 overshoot = slept > asked ? slept - asked : 0;
+                mSpinCounts -= (mSpinCounts - mMinSpinCounts) / 64;
+                if(overshoot + mMinSpinCounts / 2 > mSpinCounts)
+                {
+                    mSpinCounts = overshoot + mMinSpinCounts / 2;
+                }
+            }
+        }
+
+        // Spin out the rest, a virtual clock just jumps ahead
+        gClock->waitUntil(deadline);
+        now = gClock->getCounts();
+    }
+    else
+    {
+        ++mLateFrames;
+
+        // Too far behind to catch up smoothly, start a new schedule from here
+        if(now - deadline > getDeadline(PACER_MAX_LAG_FRAMES) - mStart)
+        {
+            mStart = now;
+            mFrame = 0;
+            ++mResyncs;
+        }
+    }
+}
+
+int LFramePacer::getLateFrames()
+{
+    return mLateFrames;
+}
+
+int LFramePacer::getResyncs()
+{
+    return mResyncs;
+}
+
+Uint64 LFramePacer::getDeadline(Uint64 frame)
+{
+    return mStart + frame * mFrequency / mFps;
+}
+/**************************************************************************/
+
+
+/*********************************************************************
+ LPresentPolicy Method Declarations
+ *********************************************************************/
+LPresentPolicy::LPresentPolicy()
+{
+    mRenderer = NULL;
+    mMode = PRESENT_VSYNC;
+    mVSync = true;
+    mRefreshRate = PRESENT_DEFAULT_REFRESH;
+    mCappedFps = 0;
+    mFrequency = SDL_GetPerformanceFrequency();
+    mRefreshCounts = mFrequency / PRESENT_DEFAULT_REFRESH;
+    mFrameStart = 0;
+    mGoodFrames = 0;
+    mInputPending = false;
+    mInputCounts = 0;
+    for(int i = 0; i < PRESENT_MODE_TOTAL; ++i)
+    {
+        mLatencyTotal[i] = 0;
+        mLatencyMax[i] = 0;
+        mLatencySamples[i] = 0;
+    }
+    mVSyncDrops = 0;
+}
+
+bool LPresentPolicy::setModeByName(std::string name)
+{
+    for(int i = 0; i < PRESENT_MODE_TOTAL; ++i)
+    {
+        if(name == getModeName((PresentMode)i))
+        {
+            setMode((PresentMode)i);
+            return true;
+        }
+    }
+    return false;
+}
+
+void LPresentPolicy::setMode(PresentMode mode)
+{
+    mMode = mode;
+    mGoodFrames = 0;
+
+    // Input from before the switch belongs to the old mode
+    mInputPending = false;
+
+    setVSync(mode == PRESENT_VSYNC || mode == PRESENT_ADAPTIVE);
+    if(mRenderer != NULL)
+    {
+        printf( "Present mode: %s\n", getModeName(mode) );
+
+        // Capped frames pace from the switch, before attaching the rate isn't known yet
+        if(mode == PRESENT_CAPPED)
+        {
+            mPacer.start(mCappedFps);
+        }
+    }
+}
+
+PresentMode LPresentPolicy::getMode()
+{
+    return mMode;
+}
+
+const char* LPresentPolicy::getModeName(PresentMode mode)
+{
+    switch(mode)
+    {
+        case PRESENT_VSYNC: return "vsync";
+        case PRESENT_UNCAPPED: return "uncapped";
+        case PRESENT_CAPPED: return "capped";
+        case PRESENT_ADAPTIVE: return "adaptive";
+        default: return "unknown";
+    }
+}
+
+Uint32 LPresentPolicy::getRendererFlags()
+{
+    Uint32 flags = SDL_RENDERER_ACCELERATED;
+    if(mMode == PRESENT_VSYNC || mMode == PRESENT_ADAPTIVE)
+    {
+        flags |= SDL_RENDERER_PRESENTVSYNC;
+    }
+    return flags;
+}
+
+void LPresentPolicy::attach(SDL_Window* window, SDL_Renderer* renderer)
+{
+    // The renderer was created with getRendererFlags
+    mRenderer = renderer;
+    mVSync = (mMode == PRESENT_VSYNC || mMode == PRESENT_ADAPTIVE);
+
+    SDL_DisplayMode displayMode;
+    int refresh = PRESENT_DEFAULT_REFRESH;
+    if(SDL_GetWindowDisplayMode(window, &displayMode) == 0 && displayMode.refresh_rate > 0)
+    {
+        refresh = displayMode.refresh_rate;
+    }
+    mRefreshRate = refresh;
+    mRefreshCounts = mFrequency / refresh;
+
+    // Capped mode follows the display unless told otherwise
+    if(mCappedFps == 0)
+    {
+        mCappedFps = refresh;
+    }
+
+    mFrameStart = SDL_GetPerformanceCounter();
+    if(mMode == PRESENT_CAPPED)
+    {
+        mPacer.start(mCappedFps);
+    }
+}
+
+void LPresentPolicy::setCappedFps(int fps)
+{
+    if(fps > 0)
+    {
+        mCappedFps = fps;
+        if(mRenderer != NULL && mMode == PRESENT_CAPPED)
+        {
+            mPacer.start(mCappedFps);
+        }
+    }
+}
+
+void LPresentPolicy::handleEvent(SDL_Event& e)
+{
+    switch(e.type)
+    {
+        case SDL_KEYDOWN:
+        case SDL_KEYUP:
+        case SDL_MOUSEMOTION:
+        case SDL_MOUSEBUTTONDOWN:
+        case SDL_MOUSEBUTTONUP:
+            // Stamped on the performance counter so modes less than a millisecond apart still differ,
+            // then moved back by the time the event waited in the queue, which SDL only has in milliseconds
+            if(!mInputPending)
+            {
+                Uint32 queued = SDL_GetTicks() - e.common.timestamp;
+                mInputPending = true;
+                mInputCounts = SDL_GetPerformanceCounter() - (Uint64)queued * mFrequency / 1000;
+            }
+            break;
+    }
+}
+
+void LPresentPolicy::present()
+{
+    Uint64 work = SDL_GetPerformanceCounter() - mFrameStart;
+
+    if(mMode == PRESENT_CAPPED)
+    {
+        mPacer.wait();
+    }
+    else if(mMode == PRESENT_ADAPTIVE)
+    {
+        if(mVSync && work > mRefreshCounts)
+        {
+            // Missed the refresh, tear instead of waiting a whole extra one
+            setVSync(false);
+            mGoodFrames = 0;
+            mPacer.start(mRefreshRate);
+            ++mVSyncDrops;
+        }
+        else if(!mVSync)
+        {
+            mGoodFrames = work < mRefreshCounts * PRESENT_RECOVER_RATIO ? mGoodFrames + 1 : 0;
+            if(mGoodFrames >= PRESENT_RECOVER_FRAMES)
+            {
+                setVSync(true);
+            }
+            else
+            {
+                // Keep to the refresh rate while vsync is off
+                mPacer.wait();
+            }
+        }
+    }
+
+    SDL_RenderPresent( mRenderer );
+    mFrameStart = SDL_GetPerformanceCounter();
+
+    // Present returning is as close to the display as the renderer lets us see
+    if(mInputPending)
+    {
+        Uint64 latency = (SDL_GetPerformanceCounter() - mInputCounts) * 1000000 / mFrequency;
+        mLatencyTotal[mMode] += latency;
+        if(latency > mLatencyMax[mMode])
+        {
+            mLatencyMax[mMode] = latency;
+        }
+        ++mLatencySamples[mMode];
+        mInputPending = false;
+    }
+}
+
+void LPresentPolicy::printReport()
+{
+    printf( "Input to present latency:\n" );
+    for(int i = 0; i < PRESENT_MODE_TOTAL; ++i)
+    {
+        if(mLatencySamples[i] > 0)
+        {
+            printf( "  %-8s %5d frames  avg %.2f ms  max %.2f ms\n", getModeName((PresentMode)i), mLatencySamples[i],
+                    (double)mLatencyTotal[i] / mLatencySamples[i] / 1000.0, mLatencyMax[i] / 1000.0 );
+        }
+    }
+    if(mVSyncDrops > 0)
+    {
+        printf( "  adaptive dropped vsync %d times\n", mVSyncDrops );
+    }
+    if(mPacer.getLateFrames() > 0)
+    {
+        printf( "  paced frames late %d times, resynced %d times\n", mPacer.getLateFrames(), mPacer.getResyncs() );
+    }
+}
+
+void LPresentPolicy::setVSync(bool enabled)
+{
+    if(mRenderer == NULL)
+    {
+        mVSync = enabled;
+        return;
+    }
+    if(enabled == mVSync)
+    {
+        return;
+    }
+
+    if(SDL_RenderSetVSync(mRenderer, enabled ? 1 : 0) != 0)
+    {
+        printf( "Unable to change vsync! SDL Error: %s\n", SDL_GetError() );
+    }
+    else
+    {
+        mVSync = enabled;
+    }
+}
+/**************************************************************************/
+
+/*********************************************************************
+ LTimeSource Method Declarations
+ *********************************************************************/
+LTimeSource::LTimeSource()
+{
+    mFrame = 0;
+    mRaw = 0;
+    mSmoothed = 1000000000.0 / SCREEN_FPS;
+    mCauseCount = 0;
+    mSubscriberCount = 0;
+    mHitches = 0;
+    mClamped = 0;
+}
+
+void LTimeSource::start()
+{
+    mFrame = 0;
+    mRaw = 0;
+    mSmoothed = 1000000000.0 / SCREEN_FPS;
+    mCauseCount = 0;
+    mHitches = 0;
+    mClamped = 0;
+    mTimer.start();
+}
+
+Uint64 LTimeSource::tick()
+{
+    mRaw = mTimer.getNanoseconds();
+    mTimer.start();
+
+    Uint64 delta = mRaw;
+    Uint64 limit = (Uint64)(mSmoothed * TIME_SOURCE_HITCH_FACTOR);
+    if(mRaw > limit && mRaw > (Uint64)TIME_SOURCE_HITCH_MIN_MS * 1000000)
+    {
+        LHitch hitch;
+        hitch.frame = mFrame;
+        hitch.rawNanoseconds = mRaw;
+        hitch.expectedNanoseconds = (Uint64)mSmoothed;
+        hitch.cause = "unknown";
+        hitch.causeNanoseconds = 0;
+
+        // Blame whatever marked work took longest this frame
+        for(int i = 0; i < mCauseCount; ++i)
+        {
+            if(mCauses[i].nanoseconds > hitch.causeNanoseconds)
+            {
+                hitch.cause = mCauses[i].name;
+                hitch.causeNanoseconds = mCauses[i].nanoseconds;
+            }
+        }
+
+        for(int i = 0; i < mSubscriberCount; ++i)
+        {
+            mSubscribers[i].callback(hitch, mSubscribers[i].param);
+        }
+        ++mHitches;
+
+        // Play the stall as an ordinary frame
+        delta = (Uint64)mSmoothed;
+        mClamped += mRaw - delta;
+
+        // Only the clamped length reaches the average, so a one off stall barely moves it
+        // but a lasting drop in frame rate stops counting as hitches after a few frames
+        mSmoothed += (limit - mSmoothed) * TIME_SOURCE_SMOOTHING;
+    }
+    else
+    {
+        mSmoothed += (mRaw - mSmoothed) * TIME_SOURCE_SMOOTHING;
+        delta = (Uint64)mSmoothed;
+    }
+
+    // Causes only count toward the frame they happened in
+    mCauseCount = 0;
+    ++mFrame;
+    return delta;
+}
+
+bool LTimeSource::subscribe(LHitchCallback callback, void* param)
+{
+    if(mSubscriberCount == TIME_SOURCE_MAX_SUBSCRIBERS)
+    {
+        return false;
+    }
+    mSubscribers[mSubscriberCount].callback = callback;
+    mSubscribers[mSubscriberCount].param = param;
+    ++mSubscriberCount;
+    return true;
+}
+
+void LTimeSource::addCause(const char* cause, Uint64 nanoseconds)
+{
+    // Causes are string literals, so the same cause has the same pointer
+    for(int i = 0; i < mCauseCount; ++i)
+    {
+        if(mCauses[i].name == cause)
+        {
+            mCauses[i].nanoseconds += nanoseconds;
+            return;
+        }
+    }
+    if(mCauseCount < TIME_SOURCE_MAX_CAUSES)
+    {
+        mCauses[mCauseCount].name = cause;
+        mCauses[mCauseCount].nanoseconds = nanoseconds;
+        ++mCauseCount;
+    }
+}
+
+Uint64 LTimeSource::getRawNanoseconds()
+{
+    return mRaw;
+}
+
+Uint64 LTimeSource::getSmoothedNanoseconds()
+{
+    return (Uint64)mSmoothed;
+}
+
+int LTimeSource::getHitchCount()
+{
+    return mHitches;
+}
+
+double LTimeSource::getClampedSeconds()
+{
+    return mClamped / 1000000000.0;
+}
+/**************************************************************************/
+
+/*********************************************************************
+ LHitchScope Method Declarations
+ *********************************************************************/
+LHitchScope::LHitchScope(LTimeSource& source, const char* cause) : mSource(source), mCause(cause)
+{
+    mTimer.start();
+}
+
+LHitchScope::~LHitchScope()
+{
+    mSource.addCause(mCause, mTimer.getNanoseconds());
+}
+/**************************************************************************/
+
+/***************************************************************************
+ Function Definitions
+ ***************************************************************************/
+
+bool selectClock(std::string arg)
+{
+    if(arg == "--virtual")
+    {
+        gClock = &gVirtualClock;
+        return true;
+    }
+    if(arg.compare(0, 9, "--script=") == 0)
+    {
+        if(gVirtualClock.loadScript(arg.substr(9)))
+        {
+            gClock = &gVirtualClock;
+        }
+        else
+        {
+            printf( "Unable to load clock script %s!\n", arg.substr(9).c_str() );
+        }
+        return true;
+    }
+    return false;
+}
+
+bool init()
+{
+    //Initialization flag
+    bool success = true;
+
+    //Initialize SDL
     if( SDL_Init( SDL_INIT_VIDEO ) < 0 )
     {
         printf( "SDL could not initialize! SDL Error: %s\n", SDL_GetError() );
@@ -516,7 +1669,7 @@ bool init()
         else
         {
             //Create renderer for window
-            gRenderer = SDL_CreateRenderer( gWindow, -1, SDL_RENDERER_ACCELERATED /* | SDL_RENDERER_PRESENTVSYNC*/ );
+            gRenderer = SDL_CreateRenderer( gWindow, -1, gPresentPolicy.getRendererFlags() );
             if( gRenderer == NULL )
             {
                 printf( "Renderer could not be created! SDL Error: %s\n", SDL_GetError() );
@@ -524,6 +1677,10 @@ bool init()
             }
             else
             {
+                // Presenting goes through the policy from here on
+                gPresentPolicy.attach(gWindow, gRenderer);
+                gPresentPolicy.setCappedFps(SCREEN_FPS);
+
                 //Initialize renderer color
                 SDL_SetRenderDrawColor( gRenderer, 0xFF, 0xFF, 0xFF, 0xFF );
 
@@ -571,6 +1728,12 @@ bool loadMedia()
     return success;
 }
 
+void logHitch(const LHitch& hitch, void* /*param*/)
+{
+    printf( "Hitch on frame %llu: %.1f ms, expected %.1f ms, cause: %s (%.1f ms)\n", (unsigned long long)hitch.frame,
+            hitch.rawNanoseconds / 1000000.0, hitch.expectedNanoseconds / 1000000.0, hitch.cause, hitch.causeNanoseconds / 1000000.0 );
+}
+
 void close()
 {
     // Free loaded images
@@ -595,6 +1758,22 @@ void close()
  **************************************************************************/
 int main( int argc, char* args[] )
 {
+    // Uncapped on real time unless the command line picks a present mode or clock,
+    // --frames=N stops after N frames so runs can be compared
+    gPresentPolicy.setMode(PRESENT_UNCAPPED);
+    int frameLimit = 0;
+    for(int i = 1; i < argc; ++i)
+    {
+        std::string arg = args[i];
+        if(arg.compare(0, 9, "--frames=") == 0)
+        {
+            frameLimit = atoi(arg.substr(9).c_str());
+        }
+        else if(!selectClock(arg) && !gPresentPolicy.setModeByName(arg))
+        {
+            printf( "Unknown option %s\n", args[i] );
+        }
+    }
 
     //Start up SDL and create window
     if( !init() )
@@ -621,8 +1800,15 @@ int main( int argc, char* args[] )
             Dot dot;
 
 
-            // Keeps track of time between steps
-            LTimer stepTimer;
+            // Measures frames, smoothing deltas and reporting hitches
+            LTimeSource timeSource;
+            timeSource.subscribe(logHitch, NULL);
+            timeSource.start();
+
+            // Runs the simulation at a fixed tick
+            LGameLoop gameLoop;
+            gameLoop.start();
+            int frameCount = 0;
 
             //While application is running
             while( !quit )
@@ -636,36 +1822,67 @@ int main( int argc, char* args[] )
                     {
                         quit = true;
                     }
+                    // Number keys switch present mode
+                    else if( e.type == SDL_KEYDOWN && e.key.keysym.sym >= SDLK_1 && e.key.keysym.sym < SDLK_1 + PRESENT_MODE_TOTAL )
+                    {
+                        gPresentPolicy.setMode((PresentMode)(e.key.keysym.sym - SDLK_1));
+                    }
+                    // Reload the dot texture, a stall long enough shows up as a hitch
+                    else if( e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_r && e.key.repeat == 0 )
+                    {
+                        LHitchScope scope(timeSource, "texture reload");
+                        gDotTexture.free();
+                        gDotTexture.loadFromFile("44_frame_independent_movement/dot.bmp");
+                    }
+                    gPresentPolicy.handleEvent(e);
+
                     // Handle input for the dot
                     dot.handleEvent(e);
                 }
 
-                // Calculate time step
-                float timeStep = stepTimer.getTicks() / 1000.f;
-
-                // Move the dot
-                dot.move(timeStep);
-
-                // Restart step timer
-                stepTimer.start();
+                // Run as many fixed ticks as real time allows
+                gameLoop.beginFrame(timeSource.tick());
+                while(gameLoop.step())
+                {
+                    // Move the dot
+                    dot.move(gameLoop.getStepSeconds());
+                }
 
                 //Clear screen
                 SDL_SetRenderDrawColor( gRenderer, 0xff, 0xff, 0xff, 0xff );
                 SDL_RenderClear( gRenderer );
 
                // Render objects
-                dot.render();
+                dot.render(gameLoop.getAlpha());
 
 
 
                 //Update screen
-                SDL_RenderPresent( gRenderer );
+                gPresentPolicy.present();
+
+                // Let a virtual clock move on to the next frame
+                gClock->endFrame();
+
+                ++frameCount;
+                if( frameLimit > 0 && frameCount >= frameLimit )
+                {
+                    quit = true;
+                }
 
 
             }
+
+            // Exact end state, identical between runs on the same virtual clock script
+            if( frameLimit > 0 )
+            {
+                printf( "%d frames, %llu ticks, dot at %a, %a\n", frameCount, (unsigned long long)gameLoop.getTick(),
+                        dot.getPosX(), dot.getPosY() );
+            }
         }
     }
 
+    gPresentPolicy.printReport();
+
     //Free resources and close SDL
     close();
 
@@ -2,6 +2,7 @@
 #include <cstdlib>
 #include <string>
 #include <sstream>
+#include <vector>
 #include <SDL.h>
 #include <SDL_image.h>
 #include <SDL_ttf.h>
@@ -64,6 +65,150 @@ Constants
 const int SCREEN_WIDTH = 800;
 const int SCREEN_HEIGHT = 600;
 
+// Timer wheel resolution and layout, the root level covers 2.56 seconds
+// and each level above it 64 times the one below
+const int TIMER_WHEEL_TICK_MS = 10;
+const int TIMER_WHEEL_LEVELS = 4;
+const int TIMER_WHEEL_ROOT_BITS = 8;
+const int TIMER_WHEEL_LEVEL_BITS = 6;
+const int TIMER_WHEEL_ROOT_SLOTS = 1 << TIMER_WHEEL_ROOT_BITS;
+const int TIMER_WHEEL_LEVEL_SLOTS = 1 << TIMER_WHEEL_LEVEL_BITS;
+const int TIMER_WHEEL_SLOTS = TIMER_WHEEL_ROOT_SLOTS + (TIMER_WHEEL_LEVELS - 1) * TIMER_WHEEL_LEVEL_SLOTS;
+
+// Repeating timers scheduled to show the wheel under load
+const int TIMER_STRESS_COUNT = 5000;
+const Uint32 TIMER_STRESS_MAX_MS = 2000;
+const Uint32 TIMER_REPORT_MS = 5000;
+
+// Work items the dispatch queue holds, must be a power of two
+const int DISPATCH_QUEUE_CAPACITY = 1024;
+
+// Main thread time spent on posted work each frame
+const Uint32 DISPATCH_BUDGET_MICROSECONDS = 2000;
+
+/*********************************************************************/
+
+/*************************************************************************
+ Timer wheel class
+*************************************************************************/
+// Same shape as SDL_TimerCallback, return the next interval or 0 to stop
+typedef Uint32 (*LWheelCallback)(Uint32 interval, void* param);
+
+// Identifies a scheduled timer, 0 is never a valid timer
+typedef Uint64 LWheelTimerID;
+
+class LTimerWheel
+{
+public:
+    // Constructor
+    LTimerWheel();
+
+    // Sets the time the wheel counts ticks from
+    void start(Uint64 nowMs);
+
+    // Schedules a callback delayMs from now
+    LWheelTimerID schedule(Uint32 delayMs, LWheelCallback callback, void* param);
+
+    // Removes a pending timer, false if it already finished
+    bool cancel(LWheelTimerID id);
+
+    // Runs every tick up to nowMs on the calling thread
+    void advance(Uint64 nowMs);
+
+    // Timers waiting to fire
+    int getPending();
+
+    // Callbacks run so far
+    Uint64 getFired();
+
+private:
+    struct Node
+    {
+        LWheelCallback callback;
+        void* param;
+        Uint32 interval;
+        Uint64 expires;
+        Uint32 generation;
+
+        // Slot list links, slot is -1 while free or running
+        int slot;
+        int prev;
+        int next;
+        bool cancelled;
+    };
+
+    // Puts a node in the slot for its expiry tick
+    void insert(int node);
+
+    // Removes a node from its slot list
+    void unlink(int node);
+
+    // Moves every node of a slot to the expiring list
+    void detach(int slot);
+
+    // Redistributes a higher level slot into the lower levels
+    void cascade(int level);
+
+    // Returns a node to the free list
+    void release(int node);
+
+    // Nodes are recycled through a free list so ids carry a generation
+    std::vector<Node> mNodes;
+    int mFreeHead;
+
+    // Slot list heads for every level plus the expiring list at the end
+    int mSlots[TIMER_WHEEL_SLOTS + 1];
+
+    Uint64 mStartMs;
+    Uint64 mTick;
+    int mPending;
+    Uint64 mFired;
+};
+
+/*********************************************************************/
+
+/*************************************************************************
+ Dispatch queue class
+*************************************************************************/
+// Work posted from another thread to run on the main thread
+typedef void (*LDispatchFunc)(void* param);
+
+// Bounded lock-free queue, any thread may post and only the main loop drains
+class LDispatchQueue
+{
+public:
+    // Constructor
+    LDispatchQueue();
+
+    // Queues work from any thread, false if the queue is full
+    bool post(LDispatchFunc func, void* param);
+
+    // Runs queued work on the calling thread until empty or out of budget
+    int drain(Uint32 budgetMicroseconds);
+
+    // Work items lost to a full queue
+    int getDropped();
+
+private:
+    struct Cell
+    {
+        // Matches the position a producer or the consumer may use next
+        SDL_atomic_t sequence;
+        LDispatchFunc func;
+        void* param;
+    };
+
+    Cell mCells[DISPATCH_QUEUE_CAPACITY];
+
+    // Producers claim positions with a compare and swap
+    SDL_atomic_t mEnqueuePos;
+
+    // Only the draining thread touches this
+    Uint32 mDequeuePos;
+
+    SDL_atomic_t mDropped;
+};
+
 /*********************************************************************/
 
 /**********************************************************************
@@ -81,6 +226,12 @@ TTF_Font* gFont = nullptr;
 // Rendered Texture
 LTexture gSplashTexture;
 
+// Game timers, run from the main loop
+LTimerWheel gTimerWheel;
+
+// Work handed to the main thread by SDL's timer and other threads
+LDispatchQueue gDispatchQueue;
+
 /*********************************************************************/
 
 /**************************************************************************
@@ -88,9 +239,18 @@ Function Declarations
 **************************************************************************/
 bool init();
 
-// Test callback function
+// Test callback function, runs on SDL's timer thread
 Uint32 callback(Uint32 interval, void* param);
 
+// Shows the callback message, runs on the main thread
+void showMessage(void* param);
+
+// Counts a stress timer firing and keeps it repeating
+Uint32 stressCallback(Uint32 interval, void* param);
+
+// Prints how busy the timer wheel is
+Uint32 reportCallback(Uint32 interval, void* param);
+
 bool loadMedia();
 
 void close();
@@ -245,6 +405,353 @@ int LTexture::getHeight()
 }
 /**************************************************************************/
 
+/*********************************************************************
+LTimerWheel Method Declarations
+*********************************************************************/
+LTimerWheel::LTimerWheel()
+{
+    mFreeHead = -1;
+    for(int i = 0; i <= TIMER_WHEEL_SLOTS; ++i)
+    {
+        mSlots[i] = -1;
+    }
+    mStartMs = 0;
+    mTick = 0;
+    mPending = 0;
+    mFired = 0;
+}
+
+void LTimerWheel::start(Uint64 nowMs)
+{
+    mStartMs = nowMs - mTick * TIMER_WHEEL_TICK_MS;
+}
+
+LWheelTimerID LTimerWheel::schedule(Uint32 delayMs, LWheelCallback callback, void* param)
+{
+    // Reuse a free node if there is one
+    int node = mFreeHead;
+    if(node >= 0)
+    {
+        mFreeHead = mNodes[node].next;
+    }
+    else
+    {
+        node = (int)mNodes.size();
+        Node blank;
+        blank.generation = 0;
+        mNodes.push_back(blank);
+    }
+
+    // Round up so a timer never fires early, and always at least one tick out
+    Uint64 ticks = (delayMs + TIMER_WHEEL_TICK_MS - 1) / TIMER_WHEEL_TICK_MS;
+    Node& n = mNodes[node];
+    n.callback = callback;
+    n.param = param;
+    n.interval = delayMs;
+    n.expires = mTick + (ticks > 0 ? ticks : 1);
+    n.cancelled = false;
+    insert(node);
+    ++mPending;
+
+    return ((Uint64)n.generation << 32) | (Uint64)(node + 1);
+}
+
+bool LTimerWheel::cancel(LWheelTimerID id)
+{
+    int node = (int)(id & 0xffffffff) - 1;
+    if(node < 0 || node >= (int)mNodes.size() || mNodes[node].generation != (Uint32)(id >> 32))
+    {
+        return false;
+    }
+
+    Node& n = mNodes[node];
+    if(n.slot >= 0)
+    {
+        unlink(node);
+        release(node);
+        --mPending;
+        return true;
+    }
+
+    // Cancelled from inside its own callback, don't rearm it
+    if(!n.cancelled && n.callback != nullptr)
+    {
+        n.cancelled = true;
+        return true;
+    }
+    return false;
+}
+
+void LTimerWheel::advance(Uint64 nowMs)
+{
+    Uint64 target = (nowMs - mStartMs) / TIMER_WHEEL_TICK_MS;
+    while(mTick < target)
+    {
+        ++mTick;
+
+        // Pull the next block of each wrapped level down a level
+        if((mTick & (TIMER_WHEEL_ROOT_SLOTS - 1)) == 0)
+        {
+            cascade(1);
+        }
+
+        // Expire the whole slot as one batch
+        detach((int)(mTick & (TIMER_WHEEL_ROOT_SLOTS - 1)));
+        while(mSlots[TIMER_WHEEL_SLOTS] >= 0)
+        {
+            int node = mSlots[TIMER_WHEEL_SLOTS];
+            unlink(node);
+            --mPending;
+
+            Node& n = mNodes[node];
+            Uint32 next = n.callback(n.interval, n.param);
+            ++mFired;
+
+            // The vector may have grown inside the callback
+            Node& fired = mNodes[node];
+            if(next > 0 && !fired.cancelled)
+            {
+                Uint64 ticks = (next + TIMER_WHEEL_TICK_MS - 1) / TIMER_WHEEL_TICK_MS;
+                fired.interval = next;
+                fired.expires = mTick + (ticks > 0 ? ticks : 1);
+                insert(node);
+                ++mPending;
+            }
+            else
+            {
+                release(node);
+            }
+        }
+    }
+}
+
+int LTimerWheel::getPending()
+{
+    return mPending;
+}
+
+Uint64 LTimerWheel::getFired()
+{
+    return mFired;
+}
+
+void LTimerWheel::insert(int node)
+{
+    Node& n = mNodes[node];
+    Uint64 delta = n.expires - mTick;
+
+    // Pick the level whose span covers the delay
+    int slot = 0;
+    if(delta < TIMER_WHEEL_ROOT_SLOTS)
+    {
+        slot = (int)(n.expires & (TIMER_WHEEL_ROOT_SLOTS - 1));
+    }
+    else
+    {
+        int level = 1;
+        int shift = TIMER_WHEEL_ROOT_BITS;
+        while(level < TIMER_WHEEL_LEVELS - 1 && delta >= ((Uint64)1 << (shift + TIMER_WHEEL_LEVEL_BITS)))
+        {
+            ++level;
+            shift += TIMER_WHEEL_LEVEL_BITS;
+        }
+
+        // Past the top level, park in its furthest slot and cascade again later
+        Uint64 limit = (Uint64)1 << (shift + TIMER_WHEEL_LEVEL_BITS);
+        Uint64 expires = delta < limit ? n.expires : mTick + limit - 1;
+        slot = TIMER_WHEEL_ROOT_SLOTS + (level - 1) * TIMER_WHEEL_LEVEL_SLOTS +
+               (int)((expires >> shift) & (TIMER_WHEEL_LEVEL_SLOTS - 1));
+    }
+
+    // Push on the front of the slot list
+    n.slot = slot;
+    n.prev = -1;
+    n.next = mSlots[slot];
+    if(n.next >= 0)
+    {
+        mNodes[n.next].prev = node;
+    }
+    mSlots[slot] = node;
+}
+
+void LTimerWheel::unlink(int node)
+{
+    Node& n = mNodes[node];
+    if(n.prev >= 0)
+    {
+        mNodes[n.prev].next = n.next;
+    }
+    else
+    {
+        mSlots[n.slot] = n.next;
+    }
+    if(n.next >= 0)
+    {
+        mNodes[n.next].prev = n.prev;
+    }
+    n.slot = -1;
+    n.prev = -1;
+    n.next = -1;
+}
+
+void LTimerWheel::detach(int slot)
+{
+    // Splice the slot list onto the expiring list in one step
+    int head = mSlots[slot];
+    if(head < 0)
+    {
+        return;
+    }
+    int tail = head;
+    mNodes[tail].slot = TIMER_WHEEL_SLOTS;
+    while(mNodes[tail].next >= 0)
+    {
+        tail = mNodes[tail].next;
+        mNodes[tail].slot = TIMER_WHEEL_SLOTS;
+    }
+    mNodes[tail].next = mSlots[TIMER_WHEEL_SLOTS];
+    if(mSlots[TIMER_WHEEL_SLOTS] >= 0)
+    {
+        mNodes[mSlots[TIMER_WHEEL_SLOTS]].prev = tail;
+    }
+    mSlots[TIMER_WHEEL_SLOTS] = head;
+    mSlots[slot] = -1;
+}
+
+void LTimerWheel::cascade(int level)
+{
+    int shift = TIMER_WHEEL_ROOT_BITS + (level - 1) * TIMER_WHEEL_LEVEL_BITS;
+    int index = (int)((mTick >> shift) & (TIMER_WHEEL_LEVEL_SLOTS - 1));
+
+    // The level above wraps at the same time
+    if(index == 0 && level < TIMER_WHEEL_LEVELS - 1)
+    {
+        cascade(level + 1);
+    }
+
+    int slot = TIMER_WHEEL_ROOT_SLOTS + (level - 1) * TIMER_WHEEL_LEVEL_SLOTS + index;
+    int node = mSlots[slot];
+    mSlots[slot] = -1;
+    while(node >= 0)
+    {
+        int next = mNodes[node].next;
+        insert(node);
+        node = next;
+    }
+}
+
+void LTimerWheel::release(int node)
+{
+    Node& n = mNodes[node];
+
+    // Old ids for this node stop matching
+    ++n.generation;
+    n.callback = nullptr;
+    n.slot = -1;
+    n.prev = -1;
+    n.next = mFreeHead;
+    mFreeHead = node;
+}
+/**************************************************************************/
+
+/*********************************************************************
+LDispatchQueue Method Declarations
+*********************************************************************/
+LDispatchQueue::LDispatchQueue()
+{
+    for(int i = 0; i < DISPATCH_QUEUE_CAPACITY; ++i)
+    {
+        SDL_AtomicSet(&mCells[i].sequence, i);
+        mCells[i].func = nullptr;
+        mCells[i].param = nullptr;
+    }
+    SDL_AtomicSet(&mEnqueuePos, 0);
+    mDequeuePos = 0;
+    SDL_AtomicSet(&mDropped, 0);
+}
+
+bool LDispatchQueue::post(LDispatchFunc func, void* param)
+{
+    Uint32 pos = (Uint32)SDL_AtomicGet(&mEnqueuePos);
+    Cell* cell = nullptr;
+    while(true)
+    {
+        cell = &mCells[pos & (DISPATCH_QUEUE_CAPACITY - 1)];
+        int diff = (int)((Uint32)SDL_AtomicGet(&cell->sequence) - pos);
+        if(diff == 0)
+        {
+            // Cell is free for this position, try to claim it
+            if(SDL_AtomicCAS(&mEnqueuePos, (int)pos, (int)(pos + 1)))
+            {
+                break;
+            }
+            pos = (Uint32)SDL_AtomicGet(&mEnqueuePos);
+        }
+        else if(diff < 0)
+        {
+            // The consumer hasn't freed this cell yet
+            SDL_AtomicAdd(&mDropped, 1);
+            return false;
+        }
+        else
+        {
+            // Another producer got here first
+            pos = (Uint32)SDL_AtomicGet(&mEnqueuePos);
+        }
+    }
+
+    // Publish the item to the consumer, SDL_AtomicSet alone is only an acquire barrier
+    // so the release keeps the item writes from moving past the sequence
+    cell->func = func;
+    cell->param = param;
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&cell->sequence, (int)(pos + 1));
+    return true;
+}
+
+int LDispatchQueue::drain(Uint32 budgetMicroseconds)
+{
+    Uint64 start = SDL_GetPerformanceCounter();
+    Uint64 budget = (Uint64)budgetMicroseconds * SDL_GetPerformanceFrequency() / 1000000;
+
+    int count = 0;
+    while(true)
+    {
+        Cell* cell = &mCells[mDequeuePos & (DISPATCH_QUEUE_CAPACITY - 1)];
+        if((Uint32)SDL_AtomicGet(&cell->sequence) != mDequeuePos + 1)
+        {
+            // Empty, or the producer hasn't finished writing yet
+            break;
+        }
+
+        // Don't read the item before the sequence that published it
+        SDL_MemoryBarrierAcquire();
+
+        // Copy the item out, then hand the cell back to the producers once the reads are done
+        LDispatchFunc func = cell->func;
+        void* param = cell->param;
+        SDL_MemoryBarrierRelease();
+        SDL_AtomicSet(&cell->sequence, (int)(mDequeuePos + DISPATCH_QUEUE_CAPACITY));
+        ++mDequeuePos;
+
+        func(param);
+        ++count;
+
+        // Leave the rest for next frame once the budget is spent
+        if(SDL_GetPerformanceCounter() - start >= budget)
+        {
+            break;
+        }
+    }
+    return count;
+}
+
+int LDispatchQueue::getDropped()
+{
+    return SDL_AtomicGet(&mDropped);
+}
+/**************************************************************************/
+
 /***************************************************************************
 Function Definitions
 ***************************************************************************/
@@ -312,10 +819,30 @@ bool init()
 
 // Test callback function
 Uint32 callback(Uint32 interval, void* param)
+{
+    // Hand the message to the main thread, a full queue counts the drop for the main thread to report
+    gDispatchQueue.post(showMessage, param);
+    return 0;
+}
+
+void showMessage(void* param)
 {
     // Print callback message
     std::cout << "Callback called back with message: " << (char*)param << std::endl;
-    return 0;
+}
+
+Uint32 stressCallback(Uint32 interval, void* param)
+{
+    ++*(Uint64*)param;
+    return interval;
+}
+
+Uint32 reportCallback(Uint32 interval, void* param)
+{
+    std::cout << "Timer wheel: " << gTimerWheel.getPending() << " pending, "
+              << gTimerWheel.getFired() << " fired, "
+              << *(Uint64*)param << " stress callbacks" << std::endl;
+    return interval;
 }
 
 bool loadMedia()
@@ -380,8 +907,23 @@ int main( int argc, char* args[] )
             // Set the text color
             SDL_Color textColor = { 0, 0, 0, 255 };
             char* hello = "Hello";
+
+            // Timers fire on this thread when the loop advances the wheel
+            gTimerWheel.start(SDL_GetTicks());
+
+            // SDL's timer thread posts its result back through the dispatch queue
             SDL_TimerID timerID = SDL_AddTimer(3 * 1000, callback, hello);
 
+            // Thousands of staggered repeating timers
+            Uint64 stressCount = 0;
+            for(int i = 0; i < TIMER_STRESS_COUNT; ++i)
+            {
+                gTimerWheel.schedule(1 + rand() % TIMER_STRESS_MAX_MS, stressCallback, &stressCount);
+            }
+            gTimerWheel.schedule(TIMER_REPORT_MS, reportCallback, &stressCount);
+
+            // Drops already reported
+            int reportedDrops = 0;
 
 			//While application is running
 			while( !quit )
@@ -397,6 +939,19 @@ int main( int argc, char* args[] )
 
                 }
 
+                // Run every timer that came due since the last frame
+                gTimerWheel.advance(SDL_GetTicks());
+
+                // Apply work posted by other threads
+                gDispatchQueue.drain(DISPATCH_BUDGET_MICROSECONDS);
+
+                // Report posts the queue had no room for
+                int drops = gDispatchQueue.getDropped();
+                if(drops != reportedDrops)
+                {
+                    std::cout << "Dispatch queue full, " << drops - reportedDrops << " messages dropped!" << std::endl;
+                    reportedDrops = drops;
+                }
 
 				//Clear screen
 				SDL_SetRenderDrawColor( gRenderer, 0xff, 0xff, 0xff, 0xff );
@@ -412,6 +967,9 @@ int main( int argc, char* args[] )
 
 
 			}
+
+            // Stop the timer thread before the queue goes away
+            SDL_RemoveTimer(timerID);
 		}
 	}
 